@@ -18,10 +18,11 @@ namespace Comms{
   uint8_t sessionStreamInfoMode = SESS_DEFAULT_STREAM_INFO_MODE;
   uint8_t tknMode = SESS_TKN_DEFAULT_MODE;
 
-  /// \brief Refreshes the session configuration if the last update was more than 60 seconds ago
-  void sessionConfigCache(){
+  /// \brief Refreshes the session configuration if the last update was more than 60 seconds ago,
+  /// or right away if force is set.
+  void sessionConfigCache(bool force){
     static uint64_t lastUpdate = 0;
-    if (Util::bootSecs() > lastUpdate + 60){
+    if (force || Util::bootSecs() > lastUpdate + 60){
       DONTEVEN_MSG("Updating session config");
       JSON::Value tmpVal = Util::getGlobalConfig("sessionViewerMode");
       if (!tmpVal.isNull()){ sessionViewerMode = tmpVal.asInt(); }
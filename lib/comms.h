@@ -41,7 +41,7 @@ namespace Comms{
   extern uint8_t sessionUnspecifiedMode;
   extern uint8_t sessionStreamInfoMode;
   extern uint8_t tknMode;
-  void sessionConfigCache();
+  void sessionConfigCache(bool force = false);
 
   class Comms{
   public:
@@ -23,12 +23,17 @@
 #endif
 #include "procs.h"
 #include <dirent.h> //for getMyExec
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #include <errno.h>
 #include <fcntl.h>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
+#include <map>
 #include <pwd.h>
+#include <set>
 #include <signal.h>
 #include <string.h>
 #include <stdarg.h> // for va_list
@@ -40,6 +45,7 @@
 bool Util::Config::is_active = false;
 bool Util::Config::is_restarting = false;
 bool Util::Config::trafficConsumption = false;
+bool Util::Config::is_worker = false;
 static Socket::Server *serv_sock_pointer = 0;
 uint32_t Util::printDebugLevel = DEBUG;
 __thread char Util::streamName[256] = {0};
@@ -493,6 +499,286 @@ int Util::Config::forkServer(Socket::Server &server_socket, int (*callback)(Sock
   return 0;
 }
 
+/// Resets the per-connection process state to that of a worker without a current connection
+static void resetWorkerContext(){
+  Util::streamName[0] = 0;
+  Util::exitReason[0] = 0;
+  Util::mRExitReason = (char *)ER_UNKNOWN;
+}
+
+Util::WorkerClient::WorkerClient(){
+  streamName[0] = 0;
+  exitReason[0] = 0;
+  mRExitReason = (char *)ER_UNKNOWN;
+}
+
+/// Makes the per-connection process state of this client current. Call before handling it.
+void Util::WorkerClient::enter(){
+  memcpy(Util::streamName, streamName, sizeof(streamName));
+  memcpy(Util::exitReason, exitReason, sizeof(exitReason));
+  Util::mRExitReason = mRExitReason;
+}
+
+/// Stores the per-connection process state of this client and resets it. Call after handling it.
+void Util::WorkerClient::leave(){
+  memcpy(streamName, Util::streamName, sizeof(streamName));
+  memcpy(exitReason, Util::exitReason, sizeof(exitReason));
+  mRExitReason = Util::mRExitReason;
+  resetWorkerContext();
+}
+
+#ifdef __linux__
+/// Event loop state of a single client of a worker
+struct workerClientState{
+  uint32_t events; ///< Events watched on the client socket
+  int wakeFd;      ///< Wake-up file descriptor the client is waiting on, or -1
+  uint64_t lingerUntil; ///< If set, the client is done and only gets to send its queued output until then
+};
+
+/// Clients of a worker by socket, and by the wake-up file descriptor they wait on
+struct workerClients{
+  int epollFd;
+  std::map<Util::WorkerClient *, workerClientState> state;
+  std::map<int, Util::WorkerClient *> bySocket;
+  std::map<int, std::set<Util::WorkerClient *> > byWakeFd;
+};
+
+/// Registers a client as waiting on the given wake-up file descriptor (-1 for none), instead of
+/// the one it waited on before.
+static void workerWaitOn(workerClients &W, Util::WorkerClient *C, int wakeFd){
+  workerClientState &st = W.state[C];
+  if (wakeFd == st.wakeFd){return;}
+  if (st.wakeFd != -1){
+    std::set<Util::WorkerClient *> &waiting = W.byWakeFd[st.wakeFd];
+    waiting.erase(C);
+    if (waiting.empty()){
+      epoll_ctl(W.epollFd, EPOLL_CTL_DEL, st.wakeFd, 0);
+      W.byWakeFd.erase(st.wakeFd);
+    }
+  }
+  st.wakeFd = wakeFd;
+  if (wakeFd == -1){return;}
+  std::set<Util::WorkerClient *> &waiting = W.byWakeFd[wakeFd];
+  if (waiting.empty()){
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    if (epoll_ctl(W.epollFd, EPOLL_CTL_ADD, wakeFd, &ev) == -1){
+      WARN_MSG("Could not watch wake-up fd %d: %s", wakeFd, strerror(errno));
+    }
+  }
+  waiting.insert(C);
+}
+
+/// Makes the epoll registrations of a client match what it currently waits for.
+/// While it has output queued, that is only its socket becoming writable: it is not asked to
+/// read or produce more until the queue is empty. Otherwise, its socket becoming readable.
+/// Either way, also its wake-up fd, unless the client is done.
+static void workerWatch(workerClients &W, Util::WorkerClient *C){
+  workerClientState &st = W.state[C];
+  uint32_t events = C->queued() ? EPOLLOUT : (EPOLLIN | EPOLLRDHUP);
+  if (events != st.events){
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = C->getSocket();
+    epoll_ctl(W.epollFd, EPOLL_CTL_MOD, C->getSocket(), &ev);
+    st.events = events;
+  }
+  workerWaitOn(W, C, st.lingerUntil ? -1 : C->wakeFd());
+}
+
+/// Removes a client from the worker and deletes it, closing its connection.
+static void workerRemove(workerClients &W, Util::WorkerClient *C){
+  workerWaitOn(W, C, -1);
+  epoll_ctl(W.epollFd, EPOLL_CTL_DEL, C->getSocket(), 0);
+  W.bySocket.erase(C->getSocket());
+  W.state.erase(C);
+  C->enter();
+  delete C;
+  resetWorkerContext();
+}
+
+/// Event loop of a single worker process started by workerServer.
+/// Accepts connections on the shared server socket and calls onReady on the clients whenever
+/// their socket becomes readable, their wake-up fd fires, their queued output was sent or their
+/// wakeTime passes, until they report they are done.
+/// Output that does not fit in a socket is queued by the client and sent from here once the
+/// socket is writable, so a slow client never holds up the others. A client that is done gets
+/// up to WORKER_LINGER_MS to send what it still has queued before it is closed.
+static void workerLoop(Socket::Server &server_socket, Util::WorkerClient *(*spawn)(Socket::Connection &S)){
+  workerClients W;
+  W.epollFd = epoll_create(1);
+  if (W.epollFd == -1){
+    FAIL_MSG("Could not create epoll instance: %s", strerror(errno));
+    return;
+  }
+  server_socket.setBlocking(false);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+  // Only wake up one of the workers per new connection
+  ev.events |= EPOLLEXCLUSIVE;
+#endif
+  ev.data.fd = server_socket.getSocket();
+  epoll_ctl(W.epollFd, EPOLL_CTL_ADD, server_socket.getSocket(), &ev);
+
+  struct epoll_event events[64];
+  while (Util::Config::is_active && server_socket.connected()){
+    // Sleep until the first client wants to be woken up, or for at most a second
+    uint64_t now = Util::bootMS();
+    uint64_t nextWake = now + 1000;
+    for (std::map<Util::WorkerClient *, workerClientState>::iterator it = W.state.begin(); it != W.state.end(); ++it){
+      uint64_t wake = it->second.lingerUntil ? it->second.lingerUntil : it->first->wakeTime();
+      if (wake && wake < nextWake){nextWake = wake;}
+    }
+    int n = epoll_wait(W.epollFd, events, 64, nextWake > now ? nextWake - now : 0);
+    if (n < 0 && errno != EINTR){
+      FAIL_MSG("Error waiting for events: %s", strerror(errno));
+      break;
+    }
+    std::set<Util::WorkerClient *> ready;
+    std::set<Util::WorkerClient *> writable;
+    for (int i = 0; i < n; ++i){
+      int fd = events[i].data.fd;
+      if (W.bySocket.count(fd)){
+        Util::WorkerClient *C = W.bySocket[fd];
+        if (events[i].events & EPOLLOUT){writable.insert(C);}
+        if (events[i].events & ~EPOLLOUT){ready.insert(C);}
+        continue;
+      }
+      if (W.byWakeFd.count(fd)){
+        uint64_t count;
+        if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+          WARN_MSG("Could not reset wake-up fd %d: %s", fd, strerror(errno));
+        }
+        ready.insert(W.byWakeFd[fd].begin(), W.byWakeFd[fd].end());
+        continue;
+      }
+      if (fd != server_socket.getSocket()){continue;}
+      // New connection(s) on the server socket
+      while (true){
+        Socket::Connection S = server_socket.accept(true);
+        if (!S.connected()){break;}
+        Util::WorkerClient *C = spawn(S);
+        S.drop();
+        if (!Util::Config::is_active && server_socket.connected()){Util::Config::is_active = true;}
+        if (!C){
+          resetWorkerContext();
+          continue;
+        }
+        C->leave();
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = C->getSocket();
+        if (epoll_ctl(W.epollFd, EPOLL_CTL_ADD, C->getSocket(), &ev) == -1){
+          WARN_MSG("Could not watch socket %d: %s", C->getSocket(), strerror(errno));
+          C->enter();
+          delete C;
+          resetWorkerContext();
+          continue;
+        }
+        HIGH_MSG("Worker %d now serving socket %d", getpid(), C->getSocket());
+        workerClientState &st = W.state[C];
+        st.events = ev.events;
+        st.wakeFd = -1;
+        st.lingerUntil = 0;
+        W.bySocket[C->getSocket()] = C;
+        // The request may have arrived together with the connection
+        ready.insert(C);
+      }
+    }
+    now = Util::bootMS();
+    for (std::map<Util::WorkerClient *, workerClientState>::iterator it = W.state.begin(); it != W.state.end(); ++it){
+      uint64_t wake = it->second.lingerUntil ? it->second.lingerUntil : it->first->wakeTime();
+      if (wake && wake <= now){ready.insert(it->first);}
+    }
+    // Send queued output first; clients that emptied their queue get to produce more
+    for (std::set<Util::WorkerClient *>::iterator it = writable.begin(); it != writable.end(); ++it){
+      (*it)->enter();
+      (*it)->flush();
+      (*it)->leave();
+      if (!(*it)->queued()){ready.insert(*it);}
+    }
+    for (std::set<Util::WorkerClient *>::iterator it = ready.begin(); it != ready.end(); ++it){
+      if (!W.state.count(*it)){continue;}
+      Util::WorkerClient *C = *it;
+      workerClientState &st = W.state[C];
+      C->enter();
+      if (st.lingerUntil){
+        // Done: only send what is left, until that is all gone or the time is up
+        C->flush();
+        C->leave();
+        if (!C->queued() || now >= st.lingerUntil){
+          workerRemove(W, C);
+        }else{
+          workerWatch(W, C);
+        }
+      }else if (C->onReady()){
+        C->leave();
+        workerWatch(W, C);
+      }else{
+        C->flush();
+        C->leave();
+        if (C->queued()){
+          st.lingerUntil = now + WORKER_LINGER_MS;
+          workerWatch(W, C);
+        }else{
+          workerRemove(W, C);
+        }
+      }
+      // Outputs clear is_active to end their own connection; only a signal (which also closes
+      // the server socket) ends the worker.
+      if (!Util::Config::is_active && server_socket.connected()){Util::Config::is_active = true;}
+    }
+  }
+  while (W.state.size()){workerRemove(W, W.state.begin()->first);}
+  close(W.epollFd);
+}
+#endif
+
+/// Serves connections from a pool of long-lived worker processes, each multiplexing many
+/// connections over an event loop, instead of forking a new process for every connection.
+/// Restarts workers that exit, until the server socket closes or the config is deactivated.
+int Util::Config::workerServer(Socket::Server &server_socket, size_t workers,
+                               WorkerClient *(*spawn)(Socket::Connection &S)){
+#ifndef __linux__
+  FAIL_MSG("Worker mode requires epoll, which is not available on this platform");
+  return 1;
+#else
+  Util::Procs::socketList.insert(server_socket.getSocket());
+  std::deque<pid_t> pids(workers, 0);
+  while (is_active && server_socket.connected()){
+    for (std::deque<pid_t>::iterator it = pids.begin(); it != pids.end(); ++it){
+      if (*it && Util::Procs::isRunning(*it)){continue;}
+      pid_t myid = fork();
+      if (myid == 0){
+        is_worker = true;
+#ifdef SHM_ENABLED
+        // All connections of a worker share their mappings of the stream pages
+        IPC::sharePageMappings = true;
+#endif
+        workerLoop(server_socket, spawn);
+        server_socket.drop();
+        return 0;
+      }
+      if (myid == -1){
+        FAIL_MSG("Could not fork worker: %s", strerror(errno));
+        *it = 0;
+        continue;
+      }
+      HIGH_MSG("Started worker process %i for socket %i", (int)myid, server_socket.getSocket());
+      *it = myid;
+    }
+    Util::sleep(100);
+  }
+  for (std::deque<pid_t>::iterator it = pids.begin(); it != pids.end(); ++it){
+    if (*it){Util::Procs::Stop(*it);}
+  }
+  server_socket.drop();
+  Util::Procs::socketList.erase(server_socket.getSocket());
+  return 0;
+#endif
+}
+
 int Util::Config::serveThreadedSocket(int (*callback)(Socket::Connection &)){
   Socket::Server server_socket;
   if (Socket::checkTrueSocket(0)){
@@ -549,6 +835,34 @@ int Util::Config::serveForkedSocket(int (*callback)(Socket::Connection &S)){
   return r;
 }
 
+int Util::Config::serveWorkerSocket(size_t workers, WorkerClient *(*spawn)(Socket::Connection &S)){
+  Socket::Server server_socket;
+  if (Socket::checkTrueSocket(0)){
+    server_socket = Socket::Server(0);
+  }else if (vals.isMember("socket")){
+    server_socket = Socket::Server(Util::getTmpFolder() + getString("socket"));
+  }else if (vals.isMember("port") && vals.isMember("interface")){
+    server_socket = Socket::Server(getInteger("port"), getString("interface"), false);
+  }
+  if (!server_socket.connected()){
+    DEVEL_MSG("Failure to open socket");
+    return 1;
+  }
+  Socket::getSocketName(server_socket.getSocket(), Util::listenInterface, Util::listenPort);
+  serv_sock_pointer = &server_socket;
+  activate();
+  if (server_socket.getSocket()){
+    int oldSock = server_socket.getSocket();
+    if (!dup2(oldSock, 0)){
+      server_socket = Socket::Server(0);
+      close(oldSock);
+    }
+  }
+  int r = workerServer(server_socket, workers, spawn);
+  serv_sock_pointer = 0;
+  return r;
+}
+
 /// Activated the stored config. This will:
 /// - Drop permissions to the stored "username", if any.
 /// - Set is_active to true.
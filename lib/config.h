@@ -28,6 +28,35 @@ namespace Util{
     CONTROLLER
   };
 
+  /// A connection served from the event loop of Config::workerServer.
+  /// Deleting the object closes the connection.
+  /// The worker swaps the per-process state that belongs to a single connection (stream name and
+  /// exit reason) in and out around every call, so connections in the same worker don't see each
+  /// other's state.
+  class WorkerClient{
+  public:
+    WorkerClient();
+    virtual ~WorkerClient(){}
+    virtual int getSocket() = 0; ///< Socket to wait on for incoming data.
+    virtual bool onReady() = 0;  ///< Handles incoming data, returns false when done.
+    /// Util::bootMS() at which onReady should be called again even without new data, 0 if never.
+    virtual uint64_t wakeTime(){return 0;}
+    /// File descriptor that, once readable, should also have onReady called; -1 if none.
+    /// Several clients may return the same one. The worker resets it by reading it.
+    virtual int wakeFd(){return -1;}
+    /// Bytes of output waiting for the socket to become writable.
+    virtual size_t queued(){return 0;}
+    /// Sends as much of the queued output as the socket accepts without blocking.
+    virtual void flush(){}
+    void enter();
+    void leave();
+
+  private:
+    char streamName[256];
+    char exitReason[256];
+    char *mRExitReason;
+  };
+
   /// Deals with parsing configuration from commandline options.
   class Config{
   private:
@@ -40,6 +69,7 @@ namespace Util{
     static bool is_active;          ///< Set to true by activate(), set to false by the signal handler.
     static bool is_restarting;      ///< Set to true when restarting, set to false on boot.
     static bool trafficConsumption; ///< Set to true if env TRAFFIC_CONSUMPTION=ON, set to false on boot.
+    static bool is_worker;          ///< Set to true in the worker processes of workerServer.
     static binType binaryType;
     // functions
     Config();
@@ -58,6 +88,8 @@ namespace Util{
     int forkServer(Socket::Server &server_socket, int (*callback)(Socket::Connection &S));
     int serveThreadedSocket(int (*callback)(Socket::Connection &S));
     int serveForkedSocket(int (*callback)(Socket::Connection &S));
+    int workerServer(Socket::Server &server_socket, size_t workers, WorkerClient *(*spawn)(Socket::Connection &S));
+    int serveWorkerSocket(size_t workers, WorkerClient *(*spawn)(Socket::Connection &S));
     int servePlainSocket(int (*callback)(Socket::Connection &S));
     void addOptionsFromCapabilities(const JSON::Value &capabilities);
     void addBasicConnectorOptions(JSON::Value &capabilities);
@@ -165,12 +165,20 @@ static inline void show_stackframe(){}
 // Pages get marked for deletion after X seconds of no one watching
 #define DEFAULT_PAGE_TIMEOUT 2
 
+// Outputs waiting at the live edge block at most this long on a track before re-checking their state
+#define LIVE_DATA_WAIT_MS 50
+
+// Worker processes serving many connections at once
+#define WORKER_SEND_QUEUE (1024 * 1024) // Bytes an output queues for a slow client before it pauses
+#define WORKER_LINGER_MS 10000 // Max ms a finished connection is kept to send its queued output
+#define WORKER_DATA_WAIT_MS 1000 // Max ms an output waiting for live data sleeps between checks
+
 /// \TODO These values are hardcoded for now, but the dtsc_sizing_test binary can calculate them accurately.
-#define META_META_OFFSET 138
-#define META_META_RECORDSIZE 548
+#define META_META_OFFSET 148
+#define META_META_RECORDSIZE 556
 
-#define META_TRACK_OFFSET 148
-#define META_TRACK_RECORDSIZE 1893
+#define META_TRACK_OFFSET 158
+#define META_TRACK_RECORDSIZE 1913
 
 #define TRACK_TRACK_OFFSET 206
 #define TRACK_TRACK_RECORDSIZE 1049572
@@ -202,6 +210,22 @@ static inline void show_stackframe(){}
 #define SHM_TRACK_DATA "MstData%s@%zu_%" PRIu32 //%s stream name, %zu track ID, %PRIu32 page #
 // End new meta
 
+// Shared pre-muxed HLS TS segments
+#define SHM_HLS_SEGMENT "MstHSeg%s@%s_%zu" //%s stream name, %s track set, %zu fragment number
+#define SHM_HLS_SEGMENT_LEN (32 * 1024 * 1024) // Sparse; only the written part uses memory
+#define SEM_HLS_SEGMENT "/MstHSeg%s" //%s stream name
+#define HLS_SEGMENT_WAIT 5000 // Max ms to wait for another process to finish muxing a segment
+#define SHM_HLS_SEGMENT_INDEX "MstHSIdx%s" //%s stream name; fragment ranges with cached segments
+#define HLS_SEGMENT_INDEX_ENTRIES 64 // Track sets per stream that can have cached segments
+#define HLS_SEGMENT_KEY_LEN 112 // Max length of a track set key in the segment index, including the 0
+
+// Shared generated HLS playlists
+#define SHM_HLS_MANIFEST "MstHMan%s" //%s stream name
+#define HLS_MANIFEST_SLOTS 32 // Playlist variants cached per stream
+#define HLS_MANIFEST_SLOT_LEN (256 * 1024) // Max size of a cached playlist, including slot header
+#define HLS_MANIFEST_VARIANT_LEN 1024 // Max length of the variant key of a cached playlist
+#define HLS_MANIFEST_WAIT 100 // Max ms to wait for another process to finish generating a playlist
+
 #define INPUT_USER_INTERVAL 1000
 
 #define SHM_STREAM_STATE "MstSTATE%s" //%s stream name
@@ -303,10 +327,18 @@ static inline void show_stackframe(){}
 #define USER_INITSIZE 50 * 1024
 #define STREAM_LIST "MstStreamList"
 #define STREAM_INITSIZE 50 * 1024
-#define TRAFFIC_STATISTICS "MstTrafficStats"             // Shared pagename
 #define TRAFFIC_ORG_STAQU "MstTrafficStaqu"
 #define TRAFFIC_ORG_CLIENT "MstTrafficClient"
 #define SEMAPHORE_LOCK_WRITE_MODE "MstTrafficWriteLock"  // Semaphore lock pagename
+#define TRAFFIC_COUNTERS "MstTrafficCnt"                // Shared pagename of the lock-free traffic counters
+#define TRAFFIC_COUNTER_SLOTS 16384                      // Amount of stream/user slots in the traffic counters page
+#define TRAFFIC_NAME_LEN 128                             // Max length of stream and user names in traffic counter slots, including terminator
+#define TRAFFIC_BYTES_PER_MB (1024.0 * 1024.0)           // Traffic is stored in the database in megabytes
+#define TRAFFIC_SNAPSHOT "MstTrafficSnap"               // Shared pagename of the per-stream traffic snapshot, for viewer-facing processes
+#define TRAFFIC_SNAPSHOT_SIZE 16 * 1024 * 1024             // Size of the traffic snapshot page
+#define TRAFFIC_SNAPSHOT_BUCKETS 4096                      // Amount of hash buckets in the traffic snapshot page
+#define TRAFFIC_MINUTE_RETENTION 2 * 86400                 // Seconds to keep per-minute traffic rollups
+#define TRAFFIC_HOUR_RETENTION 90 * 86400                  // Seconds to keep per-hour traffic rollups
 #define IS_UPDATED "isUpdated"                           // use to check is shared page data added in DB or not
 #define TRAFFIC_STATISTICS_INITSIZE 200 * 1024 * 1024
 #define DEFAULT_ROW_CAPACITY 1024 * 10
@@ -12,6 +12,14 @@
 #include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <limits.h>
+#ifdef __linux__
+#include "lib/tinythread.h"
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace DTSC{
   char Magic_Header[] = "DTSC";
@@ -22,6 +30,12 @@ namespace DTSC{
   /// If non-zero, this variable will override any live jitter value calculations with the set value
   uint64_t veryUglyJitterOverride = 0;
 
+  /// Fields of the data page records, indexed by DTSC::pageField
+  const Util::RelAccXFieldDef pageFieldDefs[PAGE_FIELDS] ={
+      {"firstkey", RAX_32UINT, 0}, {"keycount", RAX_32UINT, 0}, {"parts", RAX_32UINT, 0},
+      {"size", RAX_32UINT, 0},     {"avail", RAX_32UINT, 0},    {"firsttime", RAX_64UINT, 0},
+      {"lastkeytime", RAX_64UINT, 0}};
+
   /// The mask that the current process will use to check if a track is valid
   uint8_t trackValidMask = TRACK_VALID_ALL;
   /// The mask that will be set by the current process for new tracks
@@ -886,6 +900,58 @@ namespace DTSC{
     }
   }
 
+  /// Converts a track type string to its integer form, TYPE_UNKNOWN if not known.
+  trackType typeFromString(const std::string &type){
+    if (type == "video"){return TYPE_VIDEO;}
+    if (type == "audio"){return TYPE_AUDIO;}
+    if (type == "meta"){return TYPE_META;}
+    return TYPE_UNKNOWN;
+  }
+
+  /// Converts a codec string to its integer form, CODEC_UNKNOWN if not known.
+  codecType codecFromString(const std::string &codec){
+    if (codec == "H264"){return CODEC_H264;}
+    if (codec == "HEVC"){return CODEC_HEVC;}
+    if (codec == "AV1"){return CODEC_AV1;}
+    if (codec == "VP8"){return CODEC_VP8;}
+    if (codec == "VP9"){return CODEC_VP9;}
+    if (codec == "VP6"){return CODEC_VP6;}
+    if (codec == "VP6Alpha"){return CODEC_VP6ALPHA;}
+    if (codec == "MPEG2"){return CODEC_MPEG2;}
+    if (codec == "H263"){return CODEC_H263;}
+    if (codec == "JPEG"){return CODEC_JPEG;}
+    if (codec == "theora"){return CODEC_THEORA;}
+    if (codec == "ScreenVideo1"){return CODEC_SCREENVIDEO1;}
+    if (codec == "ScreenVideo2"){return CODEC_SCREENVIDEO2;}
+    if (codec == "AAC"){return CODEC_AAC;}
+    if (codec == "MP3"){return CODEC_MP3;}
+    if (codec == "MP2"){return CODEC_MP2;}
+    if (codec == "AC3"){return CODEC_AC3;}
+    if (codec == "EAC3"){return CODEC_EAC3;}
+    if (codec == "DTS"){return CODEC_DTS;}
+    if (codec == "opus"){return CODEC_OPUS;}
+    if (codec == "vorbis"){return CODEC_VORBIS;}
+    if (codec == "PCM"){return CODEC_PCM;}
+    if (codec == "ALAW"){return CODEC_ALAW;}
+    if (codec == "ULAW"){return CODEC_ULAW;}
+    if (codec == "FLOAT"){return CODEC_FLOAT;}
+    if (codec == "ADPCM"){return CODEC_ADPCM;}
+    if (codec == "Nellymoser"){return CODEC_NELLYMOSER;}
+    if (codec == "Speex"){return CODEC_SPEEX;}
+    if (codec == "rawts"){return CODEC_RAWTS;}
+    if (codec == "JSON"){return CODEC_JSON;}
+    if (codec == "subtitle"){return CODEC_SUBTITLE;}
+    if (codec == "ID3"){return CODEC_ID3;}
+    return CODEC_UNKNOWN;
+  }
+
+  Track::Track() : pageFields(pageFieldDefs){
+    memset(typeCache, 0, TRACK_TYPECODEC_CACHE);
+    typeId = TYPE_UNKNOWN;
+    memset(codecCache, 0, TRACK_TYPECODEC_CACHE);
+    codecId = CODEC_UNKNOWN;
+  }
+
   /// Initialize metadata from referenced DTSC::Scan object in master mode.
   Meta::Meta(const std::string &_streamName, const DTSC::Scan &src){
     version = DTSH_VERSION;
@@ -1173,6 +1239,8 @@ namespace DTSC{
       stream.addField("bootmsoffset", RAX_64INT);
       stream.addField("utcoffset", RAX_64INT);
       stream.addField("minfragduration", RAX_64UINT);
+      // 8 bytes, so it always contains a 4-byte aligned word usable as futex
+      stream.addField("notify", RAX_RAW, 8);
       stream.setRCount(1);
       stream.setReady();
       stream.addRecords(1);
@@ -1193,6 +1261,8 @@ namespace DTSC{
       trackList.addField("playready", RAX_STRING, 1024);
       trackList.addField("millisyncms", RAX_64UINT);
       trackList.addField("firstrtpms", RAX_32UINT);
+      // Same as the stream notify field, but only bumped for packets on this track
+      trackList.addField("notify", RAX_RAW, 8);
 
       trackList.setRCount(trackCount);
       trackList.setReady();
@@ -1208,6 +1278,7 @@ namespace DTSC{
     streamBootMsOffsetField = stream.getFieldData("bootmsoffset");
     streamUTCOffsetField = stream.getFieldData("utcoffset");
     streamMinimumFragmentDurationField = stream.getFieldData("minfragduration");
+    streamNotifyField = stream.getFieldData("notify");
 
     trackValidField = trackList.getFieldData("valid");
     trackIdField = trackList.getFieldData("id");
@@ -1215,6 +1286,7 @@ namespace DTSC{
     trackCodecField = trackList.getFieldData("codec");
     trackPageField = trackList.getFieldData("page");
     trackLastUpdateField = trackList.getFieldData("lastupdate");
+    trackNotifyField = trackList.getFieldData("notify");
     trackPidField = trackList.getFieldData("pid");
     trackMinKeepAwayField = trackList.getFieldData("minkeepaway");
     trackSourceTidField = trackList.getFieldData("sourcetid");
@@ -1247,6 +1319,7 @@ namespace DTSC{
       t.keys = Util::RelAccX(t.track.getPointer("keys"), true);
       t.fragments = Util::RelAccX(t.track.getPointer("fragments"), true);
       t.pages = Util::RelAccX(t.track.getPointer("pages"), true);
+      t.pageFields.attach(t.pages);
 
       t.trackIdField = t.track.getFieldData("id");
       t.trackTypeField = t.track.getFieldData("type");
@@ -1342,6 +1415,7 @@ namespace DTSC{
         t.keys = Util::RelAccX(t.track.getPointer("keys"), true);
         t.fragments = Util::RelAccX(t.track.getPointer("fragments"), true);
         t.pages = Util::RelAccX(t.track.getPointer("pages"), true);
+        t.pageFields.attach(t.pages);
 
         t.trackIdField = t.track.getFieldData("id");
         t.trackTypeField = t.track.getFieldData("type");
@@ -1480,6 +1554,7 @@ namespace DTSC{
     t.keys = Util::RelAccX(t.track.getPointer("keys"), true);
     t.fragments = Util::RelAccX(t.track.getPointer("fragments"), true);
     t.pages = Util::RelAccX(t.track.getPointer("pages"), true);
+    t.pageFields.attach(t.pages);
 
     trackList.setString(trackPageField, pageName, tNumber);
     trackList.setInt(trackPidField, getpid(), tNumber);
@@ -1870,13 +1945,7 @@ namespace DTSC{
     t.fragmentSizeField = t.fragments.getFieldData("size");
 
     t.pages = Util::RelAccX(t.track.getPointer("pages"), false);
-    t.pages.addField("firstkey", RAX_32UINT);
-    t.pages.addField("keycount", RAX_32UINT);
-    t.pages.addField("parts", RAX_32UINT);
-    t.pages.addField("size", RAX_32UINT);
-    t.pages.addField("avail", RAX_32UINT);
-    t.pages.addField("firsttime", RAX_64UINT);
-    t.pages.addField("lastkeytime", RAX_64UINT);
+    t.pageFields.create(t.pages);
     t.pages.setRCount(pageCount);
     t.pages.setReady();
   }
@@ -1937,6 +2006,227 @@ namespace DTSC{
     return ret;
   }
 
+  /// Returns the 4-byte aligned word inside an 8-byte notify field, or null if there is no such field.
+  static volatile uint32_t *notifyFieldWord(const Util::RelAccX &rax, const Util::RelAccXFieldData &fd, size_t recordNo){
+    if (fd.size < 8){return 0;}
+    char *ptr = rax.getPointer(fd, recordNo);
+    if (!ptr){return 0;}
+    return (volatile uint32_t *)(((uintptr_t)ptr + 3) & ~(uintptr_t)3);
+  }
+
+  /// Bumps the generation in the given notify word, waking up all processes blocked on it.
+  /// The generation counts in steps of two; the lowest bit is set while there are waiters, so
+  /// the wake-up system call is skipped when nobody is waiting.
+  static void bumpNotifyWord(volatile uint32_t *word){
+    if (!word){return;}
+    if (__sync_add_and_fetch(word, 2) & 1){
+      __sync_fetch_and_and(word, ~1u);
+#ifdef __linux__
+      syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+#endif
+    }
+  }
+
+  /// Blocks until the generation in the given notify word differs from the given generation, or
+  /// maxWaitMs passed. Without a word (or futexes), polls every 10ms instead.
+  /// Returns true if the generation changed.
+  static bool waitNotifyWord(volatile uint32_t *word, uint32_t generation, uint64_t maxWaitMs){
+    uint64_t deadline = Util::bootMS() + maxWaitMs;
+    while (true){
+      uint32_t current = word ? *word : 0;
+      if (word && (current & ~1u) != generation){return true;}
+      uint64_t now = Util::bootMS();
+      if (now >= deadline){return false;}
+#ifdef __linux__
+      if (word){
+        // Announce ourselves as waiter, then sleep for as long as the word doesn't change
+        if (!(current & 1) && !__sync_bool_compare_and_swap(word, current, current | 1)){continue;}
+        struct timespec ts;
+        ts.tv_sec = (deadline - now) / 1000;
+        ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+        syscall(SYS_futex, word, FUTEX_WAIT, current | 1, &ts, 0, 0);
+        continue;
+      }
+#endif
+      Util::sleep(std::min(deadline - now, (uint64_t)10));
+    }
+  }
+
+  /// Returns the update generation word inside the "notify" field of the stream object.
+  /// Returns a null pointer if the stream object has no such field.
+  volatile uint32_t *Meta::notifyWord() const{return notifyFieldWord(stream, streamNotifyField, 0);}
+
+  /// Returns the update generation word inside the "notify" field of the given track.
+  /// Returns a null pointer if the track list has no such field.
+  volatile uint32_t *Meta::trackNotifyWord(size_t trackIdx) const{
+    return notifyFieldWord(trackList, trackNotifyField, trackIdx);
+  }
+
+  /// Bumps the update generations of the given track and of the stream as a whole, waking up all
+  /// processes blocked in waitForTrackUpdate() or waitForUpdate().
+  void Meta::notifyUpdate(size_t trackIdx){
+    bumpNotifyWord(trackNotifyWord(trackIdx));
+    bumpNotifyWord(notifyWord());
+  }
+
+  /// Returns the current update generation, which changes every time a packet is added to any
+  /// track. Pass it to waitForUpdate() to block until the next change.
+  uint32_t Meta::getUpdateGeneration() const{
+    volatile uint32_t *word = notifyWord();
+    return word ? (*word & ~1u) : 0;
+  }
+
+  /// Blocks until the update generation differs from the given generation, or maxWaitMs passed.
+  /// Returns true if the generation changed.
+  bool Meta::waitForUpdate(uint32_t generation, uint64_t maxWaitMs) const{
+    return waitNotifyWord(notifyWord(), generation, maxWaitMs);
+  }
+
+  /// Returns the current update generation of the given track, which changes every time a packet
+  /// is added to it. Pass it to waitForTrackUpdate() to block until the next change.
+  uint32_t Meta::getTrackGeneration(size_t trackIdx) const{
+    volatile uint32_t *word = trackNotifyWord(trackIdx);
+    return word ? (*word & ~1u) : 0;
+  }
+
+  /// Blocks until the update generation of the given track differs from the given generation, or
+  /// maxWaitMs passed. Returns true if the generation changed.
+  bool Meta::waitForTrackUpdate(size_t trackIdx, uint32_t generation, uint64_t maxWaitMs) const{
+    return waitNotifyWord(trackNotifyWord(trackIdx), generation, maxWaitMs);
+  }
+
+#ifdef __linux__
+  /// Makes the update notifications of one stream available through an eventfd
+  struct updateWatch{
+    std::string streamName;
+    int fd;
+    size_t users;
+    volatile bool stop;
+    volatile bool done; ///< Set by the thread right before it exits
+    tthread::thread *thread;
+  };
+  static tthread::mutex updateWatchMutex;
+  /// Watches in use, by stream name
+  static std::map<std::string, updateWatch *> updateWatches;
+  /// Watches no longer in use, whose thread may not have exited yet
+  static std::set<updateWatch *> stoppedWatches;
+
+  /// Signals the eventfd of a watch
+  static void signalWatch(updateWatch *w){
+    uint64_t one = 1;
+    if (write(w->fd, &one, sizeof(one)) != sizeof(one)){
+      DONTEVEN_MSG("Could not signal update of %s: %s", w->streamName.c_str(), strerror(errno));
+    }
+  }
+
+  /// Blocks on the notify word of the stream of a watch and signals its eventfd every time the
+  /// word changes, until told to stop. Also signals when the stream goes away or restarts, then
+  /// attaches to the new stream page once there is one.
+  static void updateWatchThread(void *arg){
+    updateWatch *w = (updateWatch *)arg;
+    char pageName[NAME_BUFFER_SIZE];
+    snprintf(pageName, NAME_BUFFER_SIZE, SHM_STREAM_META, w->streamName.c_str());
+    IPC::sharedPage page;
+    Util::RelAccX stream;
+    volatile uint32_t *word = 0;
+    uint32_t generation = 0;
+    while (!w->stop){
+      if (word && !stream.isExit() && !stream.isReload()){
+        if (waitNotifyWord(word, generation, 500)){
+          generation = *word & ~1u;
+          signalWatch(w);
+        }
+        continue;
+      }
+      if (word){
+        signalWatch(w);
+        word = 0;
+      }
+      page.init(pageName, 0, false, false);
+      if (page.mapped){stream = Util::RelAccX(page.mapped, false);}
+      if (!page.mapped || !stream.isReady() || stream.isExit() || stream.isReload()){
+        Util::sleep(500);
+        continue;
+      }
+      word = notifyFieldWord(stream, stream.getFieldData("notify"), 0);
+      if (!word){
+        Util::sleep(500);
+        continue;
+      }
+      generation = *word & ~1u;
+      signalWatch(w);
+    }
+    w->done = true;
+  }
+
+  /// Cleans up watches that are no longer in use, once their thread has exited.
+  /// Their eventfd is only closed here, so callers never see its number reused while they may
+  /// still be waiting on it.
+  static void reapUpdateWatches(){
+    std::set<updateWatch *>::iterator it = stoppedWatches.begin();
+    while (it != stoppedWatches.end()){
+      updateWatch *w = *it;
+      if (!w->done){
+        ++it;
+        continue;
+      }
+      w->thread->join();
+      delete w->thread;
+      close(w->fd);
+      delete w;
+      stoppedWatches.erase(it++);
+    }
+  }
+#endif
+
+  /// Returns an eventfd that becomes readable whenever a packet is added to the given stream, or
+  /// when the stream goes away or restarts. Meant for event loops that serve many connections
+  /// at once, as a replacement for waitForUpdate(). All callers in this process share a single
+  /// watch (and thread) per stream. Whoever waits on the eventfd resets it by reading it.
+  /// Call unwatchUpdates() once for every call that did not return -1.
+  int watchUpdates(const std::string &streamName){
+#ifdef __linux__
+    tthread::lock_guard<tthread::mutex> guard(updateWatchMutex);
+    reapUpdateWatches();
+    std::map<std::string, updateWatch *>::iterator it = updateWatches.find(streamName);
+    if (it != updateWatches.end()){
+      ++it->second->users;
+      return it->second->fd;
+    }
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1){
+      WARN_MSG("Could not create eventfd to watch %s: %s", streamName.c_str(), strerror(errno));
+      return -1;
+    }
+    updateWatch *w = new updateWatch;
+    w->streamName = streamName;
+    w->fd = fd;
+    w->users = 1;
+    w->stop = false;
+    w->done = false;
+    w->thread = new tthread::thread(updateWatchThread, w);
+    updateWatches[streamName] = w;
+    return fd;
+#else
+    return -1;
+#endif
+  }
+
+  /// Gives up one use of the watch returned by watchUpdates() for the given stream.
+  /// The watch stops once it is no longer used.
+  void unwatchUpdates(const std::string &streamName){
+#ifdef __linux__
+    tthread::lock_guard<tthread::mutex> guard(updateWatchMutex);
+    std::map<std::string, updateWatch *>::iterator it = updateWatches.find(streamName);
+    if (it != updateWatches.end() && !--it->second->users){
+      it->second->stop = true;
+      stoppedWatches.insert(it->second);
+      updateWatches.erase(it);
+    }
+    reapUpdateWatches();
+#endif
+  }
+
   void Meta::setChannels(size_t trackIdx, uint16_t channels){
     DTSC::Track &t = tracks.at(trackIdx);
     t.track.setInt(t.trackChannelsField, channels);
@@ -1991,6 +2281,23 @@ namespace DTSC{
     return trackList.getPointer(trackTypeField, trackIdx);
   }
 
+  /// Returns the track type as an integer, without allocating or comparing strings.
+  /// The raw type field is compared against the cached copy, so changes by any process are picked up.
+  /// Falls back to parsing the string when the field is not a RAX_32STRING, which the cache relies on.
+  trackType Meta::getTypeId(size_t trackIdx) const{
+    const Track &t = tracks.at(trackIdx);
+    const char *type = trackList.getPointer(trackTypeField, trackIdx);
+    if (!type){return TYPE_UNKNOWN;}
+    if (trackTypeField.type != RAX_32STRING){
+      return typeFromString(std::string(type, strnlen(type, trackTypeField.size)));
+    }
+    if (memcmp(t.typeCache, type, TRACK_TYPECODEC_CACHE)){
+      memcpy(t.typeCache, type, TRACK_TYPECODEC_CACHE);
+      t.typeId = typeFromString(std::string(t.typeCache, strnlen(t.typeCache, TRACK_TYPECODEC_CACHE)));
+    }
+    return t.typeId;
+  }
+
   void Meta::setCodec(size_t trackIdx, const std::string &codec){
     trackList.setString(trackCodecField, codec, trackIdx);
     DTSC::Track &t = tracks.at(trackIdx);
@@ -2000,6 +2307,23 @@ namespace DTSC{
     return trackList.getPointer(trackCodecField, trackIdx);
   }
 
+  /// Returns the track codec as an integer, without allocating or comparing strings.
+  /// The raw codec field is compared against the cached copy, so changes by any process are picked up.
+  /// Falls back to parsing the string when the field is not a RAX_32STRING, which the cache relies on.
+  codecType Meta::getCodecId(size_t trackIdx) const{
+    const Track &t = tracks.at(trackIdx);
+    const char *codec = trackList.getPointer(trackCodecField, trackIdx);
+    if (!codec){return CODEC_UNKNOWN;}
+    if (trackCodecField.type != RAX_32STRING){
+      return codecFromString(std::string(codec, strnlen(codec, trackCodecField.size)));
+    }
+    if (memcmp(t.codecCache, codec, TRACK_TYPECODEC_CACHE)){
+      memcpy(t.codecCache, codec, TRACK_TYPECODEC_CACHE);
+      t.codecId = codecFromString(std::string(t.codecCache, strnlen(t.codecCache, TRACK_TYPECODEC_CACHE)));
+    }
+    return t.codecId;
+  }
+
   void Meta::setLang(size_t trackIdx, const std::string &lang){
     DTSC::Track &t = tracks.at(trackIdx);
     t.track.setString(t.trackLangField, lang);
@@ -2256,10 +2580,10 @@ namespace DTSC{
     if (!getValidTracks().count(trackIdx)){return;}
     Track &t = tracks[trackIdx];
     for (uint64_t i = t.pages.getDeleted(); i < t.pages.getEndPos(); i++){
-      if (t.pages.getInt("avail", i) == 0){continue;}
+      if (t.pages.getInt(t.pageFields[PAGE_AVAIL], i) == 0){continue;}
       char thisPageName[NAME_BUFFER_SIZE];
       snprintf(thisPageName, NAME_BUFFER_SIZE, SHM_TRACK_DATA, streamName.c_str(), trackIdx,
-               (uint32_t)t.pages.getInt("firstkey", i));
+               (uint32_t)t.pages.getInt(t.pageFields[PAGE_FIRSTKEY], i));
       IPC::sharedPage p(thisPageName, 20971520);
       p.master = true;
     }
@@ -2304,13 +2628,14 @@ namespace DTSC{
     setFirstms(trackIdx, t.keys.getInt(t.keyTimeField, t.keys.getDeleted()));
 
     // Update page info
-    Util::RelAccX &tPages = pages(trackIdx);
+    Util::RelAccX &tPages = t.pages;
+    const PageSchema &P = t.pageFields;
     uint32_t firstPage = tPages.getDeleted();
-    uint32_t keyCount = tPages.getInt("keycount", firstPage);
-    uint32_t firstKey = tPages.getInt("firstkey", firstPage);
+    uint32_t keyCount = tPages.getInt(P[PAGE_KEYCOUNT], firstPage);
+    uint32_t firstKey = tPages.getInt(P[PAGE_FIRSTKEY], firstPage);
     // Delete the page if this was the last key
     if (firstKey + keyCount <= deletedKeyNum + 1){
-      if (tPages.getInt("avail", firstPage)){
+      if (tPages.getInt(P[PAGE_AVAIL], firstPage)){
         // Open the correct page
         char pageId[NAME_BUFFER_SIZE];
         snprintf(pageId, NAME_BUFFER_SIZE, SHM_TRACK_DATA, streamName.c_str(), trackIdx, firstKey);
@@ -2321,10 +2646,10 @@ namespace DTSC{
         toErase.master = true;
       }
       tPages.deleteRecords(1, streamName);
-    }else if (tPages.getInt("avail", firstPage) == 0){
-      tPages.setInt("keycount", keyCount - 1, firstPage);
-      tPages.setInt("parts", tPages.getInt("parts", firstPage) - deletedPartCount, firstPage);
-      tPages.setInt("firstkey", deletedKeyNum + 1, firstPage);
+    }else if (tPages.getInt(P[PAGE_AVAIL], firstPage) == 0){
+      tPages.setInt(P[PAGE_KEYCOUNT], keyCount - 1, firstPage);
+      tPages.setInt(P[PAGE_PARTS], tPages.getInt(P[PAGE_PARTS], firstPage) - deletedPartCount, firstPage);
+      tPages.setInt(P[PAGE_FIRSTKEY], deletedKeyNum + 1, firstPage);
     }
 
     if (resizeLock){resizeLock.unlink();}
@@ -2566,6 +2891,7 @@ namespace DTSC{
                        t.fragments.getInt(t.fragmentSizeField, lastFragNum) + packDataSize, lastFragNum);
     t.track.setInt(t.trackLastmsField, packTime);
     markUpdated(tNumber);
+    notifyUpdate(tNumber);
   }
 
   /// Prints the metadata and tracks in human-readable format
@@ -2617,6 +2943,8 @@ namespace DTSC{
   const Util::RelAccX &Meta::fragments(size_t idx) const{return tracks.at(idx).fragments;}
   const Util::RelAccX &Meta::pages(size_t idx) const{return tracks.at(idx).pages;}
   Util::RelAccX &Meta::pages(size_t idx){return tracks.at(idx).pages;}
+  /// Returns the resolved page record field handles for the given track.
+  const PageSchema &Meta::pageFields(size_t idx) const{return tracks.at(idx).pageFields;}
 
   /// Wipes internal structures, also marking as outdated and deleting memory structures if in
   /// master mode.
@@ -2871,9 +3199,10 @@ namespace DTSC{
       conn.SendNow("\340", 1); // Begin track object
 
       if (!skipDynamic){
-        const Util::RelAccX &fragments = tracks.at(*it).fragments;
-        const Util::RelAccX &keys = tracks.at(*it).keys;
-        const Util::RelAccX &parts = tracks.at(*it).parts;
+        const Track &t = tracks.at(*it);
+        const Util::RelAccX &fragments = t.fragments;
+        const Util::RelAccX &keys = t.keys;
+        const Util::RelAccX &parts = t.parts;
 
         size_t fragBegin = fragments.getStartPos();
         size_t fragCount = fragments.getPresent();
@@ -2885,34 +3214,34 @@ namespace DTSC{
         conn.SendNow("\000\011fragments\002", 12);
         conn.SendNow(c32(fragCount * DTSH_FRAGMENT_SIZE), 4);
         for (size_t i = 0; i < fragCount; i++){
-          conn.SendNow(c32(fragments.getInt("duration", i + fragBegin)), 4);
-          conn.SendNow(std::string(1, (char)fragments.getInt("keys", i + fragBegin)));
+          conn.SendNow(c32(fragments.getInt(t.fragmentDurationField, i + fragBegin)), 4);
+          conn.SendNow(std::string(1, (char)fragments.getInt(t.fragmentKeysField, i + fragBegin)));
 
-          conn.SendNow(c32(fragments.getInt("firstkey", i + fragBegin) + 1), 4);
-          conn.SendNow(c32(fragments.getInt("size", i + fragBegin)), 4);
+          conn.SendNow(c32(fragments.getInt(t.fragmentFirstKeyField, i + fragBegin) + 1), 4);
+          conn.SendNow(c32(fragments.getInt(t.fragmentSizeField, i + fragBegin)), 4);
         }
 
         conn.SendNow("\000\004keys\002", 7);
         conn.SendNow(c32(keyCount * DTSH_KEY_SIZE), 4);
         for (size_t i = 0; i < keyCount; i++){
-          conn.SendNow(c64(keys.getInt("bpos", i + fragBegin)), 8);
-          conn.SendNow(c24(keys.getInt("duration", i + keyBegin)), 3);
-          conn.SendNow(c32(keys.getInt("number", i + keyBegin)), 4);
-          conn.SendNow(c16(keys.getInt("parts", i + keyBegin)), 2);
-          conn.SendNow(c64(keys.getInt("time", i + keyBegin)), 8);
+          conn.SendNow(c64(keys.getInt(t.keyBposField, i + fragBegin)), 8);
+          conn.SendNow(c24(keys.getInt(t.keyDurationField, i + keyBegin)), 3);
+          conn.SendNow(c32(keys.getInt(t.keyNumberField, i + keyBegin)), 4);
+          conn.SendNow(c16(keys.getInt(t.keyPartsField, i + keyBegin)), 2);
+          conn.SendNow(c64(keys.getInt(t.keyTimeField, i + keyBegin)), 8);
         }
         conn.SendNow("\000\010keysizes\002,", 11);
         conn.SendNow(c32(keyCount * 4), 4);
         for (size_t i = 0; i < keyCount; i++){
-          conn.SendNow(c32(keys.getInt("size", i + keyBegin)), 4);
+          conn.SendNow(c32(keys.getInt(t.keySizeField, i + keyBegin)), 4);
         }
 
         conn.SendNow("\000\005parts\002", 8);
         conn.SendNow(c32(partCount * DTSH_PART_SIZE), 4);
         for (size_t i = 0; i < partCount; i++){
-          conn.SendNow(c24(parts.getInt("size", i + partBegin)), 3);
-          conn.SendNow(c24(parts.getInt("duration", i + partBegin)), 3);
-          conn.SendNow(c24(parts.getInt("offset", i + partBegin)), 3);
+          conn.SendNow(c24(parts.getInt(t.partSizeField, i + partBegin)), 3);
+          conn.SendNow(c24(parts.getInt(t.partDurationField, i + partBegin)), 3);
+          conn.SendNow(c24(parts.getInt(t.partOffsetField, i + partBegin)), 3);
         }
       }
 
@@ -3073,16 +3402,26 @@ namespace DTSC{
   }
 
   /// Gets indice of the fragment containing timestamp, or last fragment if nowhere.
+  /// Fragment end times only ever go up, so this is a binary search for the first fragment ending
+  /// after timestamp.
   uint32_t Meta::getFragmentIndexForTime(uint32_t idx, uint64_t timestamp) const{
-    DTSC::Fragments fragments(tracks.at(idx).fragments);
-    DTSC::Keys keys(tracks.at(idx).keys);
-    uint32_t firstFragment = fragments.getFirstValid();
-    uint32_t endFragment = fragments.getEndValid();
-    for (size_t i = firstFragment; i < endFragment; i++){
-      uint32_t keyNumber = fragments.getFirstKey(i);
-      uint32_t duration = fragments.getDuration(i);
-      if (timestamp < keys.getTime(keyNumber) + duration){return i;}
+    const Track &trk = tracks.at(idx);
+    const Util::RelAccX &fragments = trk.fragments;
+    const Util::RelAccX &keys = trk.keys;
+    uint32_t firstFragment = fragments.getDeleted();
+    uint32_t endFragment = fragments.getEndPos();
+    size_t lo = firstFragment, hi = endFragment;
+    while (lo < hi){
+      size_t mid = lo + (hi - lo) / 2;
+      uint64_t keyNumber = fragments.getInt(trk.fragmentFirstKeyField, mid);
+      uint32_t duration = fragments.getInt(trk.fragmentDurationField, mid);
+      if (timestamp < keys.getInt(trk.keyTimeField, keyNumber) + duration){
+        hi = mid;
+      }else{
+        lo = mid + 1;
+      }
     }
+    if (lo < endFragment){return lo;}
     if (endFragment > firstFragment){
       if (timestamp < getLastms(idx)){return endFragment - 1;}
     }
@@ -3096,15 +3435,21 @@ namespace DTSC{
   }
 
   /// Returns indice of the key containing timestamp, or last key if nowhere.
+  /// Key end times only ever go up, so this is a binary search for the first key ending after
+  /// timestamp.
   uint32_t Meta::getKeyIndexForTime(uint32_t idx, uint64_t timestamp) const{
-    DTSC::Keys keys(tracks.at(idx).keys);
-    uint32_t firstKey = keys.getFirstValid();
-    uint32_t endKey = keys.getEndValid();
-
-    for (size_t i = firstKey; i < endKey; i++){
-      if (keys.getTime(i) + keys.getDuration(i) > timestamp){return i;}
+    const Track &trk = tracks.at(idx);
+    const Util::RelAccX &keys = trk.keys;
+    size_t lo = keys.getDeleted(), hi = keys.getEndPos();
+    while (lo < hi){
+      size_t mid = lo + (hi - lo) / 2;
+      if (keys.getInt(trk.keyTimeField, mid) + keys.getInt(trk.keyDurationField, mid) > timestamp){
+        hi = mid;
+      }else{
+        lo = mid + 1;
+      }
     }
-    return endKey;
+    return lo;
   }
 
   /// Returns the tiestamp for the given fragment index in the given track index.
@@ -3199,43 +3544,61 @@ namespace DTSC{
     return 0;
   }
 
+  /// Returns the last page record in pages whose field is at most val, or the first record if none is.
+  /// Page records are sorted on their first key and time, so this is a binary search.
+  static uint64_t findPage(const Util::RelAccX &pages, const Util::RelAccXFieldData &field, uint64_t val){
+    uint64_t lo = pages.getStartPos(), hi = pages.getEndPos();
+    uint64_t first = lo;
+    while (lo < hi){
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (pages.getInt(field, mid) > val){
+        hi = mid;
+      }else{
+        lo = mid + 1;
+      }
+    }
+    return lo > first ? lo - 1 : first;
+  }
+
+  /// Walks back from page record i to the closest record that is available, or the first record if none is.
+  static uint64_t lastAvailablePage(const Util::RelAccX &pages, const Util::RelAccXFieldData &avail, uint64_t i){
+    uint64_t first = pages.getStartPos();
+    while (i > first && !pages.getInt(avail, i)){--i;}
+    return i;
+  }
+
   /// Given the current page, check if the next page is available. Returns true if it is.
   bool Meta::nextPageAvailable(uint32_t idx, size_t currentPage) const{
-    const Util::RelAccX &pages = tracks.at(idx).pages;
-    for (size_t i = pages.getStartPos(); i + 1 < pages.getEndPos(); ++i){
-      if (pages.getInt("firstkey", i) == currentPage){return pages.getInt("avail", i + 1);}
-    }
-    return false;
+    const Track &trk = tracks.at(idx);
+    const Util::RelAccX &pages = trk.pages;
+    const Util::RelAccXFieldData &avail = trk.pageFields[PAGE_AVAIL];
+    const Util::RelAccXFieldData &firstkey = trk.pageFields[PAGE_FIRSTKEY];
+    uint64_t i = findPage(pages, firstkey, currentPage);
+    if (i + 1 >= pages.getEndPos() || pages.getInt(firstkey, i) != currentPage){return false;}
+    return pages.getInt(avail, i + 1);
   }
 
   /// Given a timestamp, returns the page number that timestamp can be found on.
   /// If the timestamp is not available, returns the closest page number that is.
   size_t Meta::getPageNumberForTime(uint32_t idx, uint64_t time) const{
-    const Util::RelAccX &pages = tracks.at(idx).pages;
-    Util::RelAccXFieldData avail = pages.getFieldData("avail");
-    Util::RelAccXFieldData firsttime = pages.getFieldData("firsttime");
-    uint32_t res = pages.getStartPos();
-    uint64_t endPos = pages.getEndPos();
-    for (uint64_t i = res; i < endPos; ++i){
-      if (pages.getInt(avail, i) == 0){continue;}
-      if (pages.getInt(firsttime, i) > time){break;}
-      res = i;
-    }
-    DONTEVEN_MSG("Page number for time %" PRIu64 " on track %" PRIu32 " can be found on page %" PRIu64, time, idx, pages.getInt("firstkey", res));
-    return pages.getInt("firstkey", res);
+    const Track &trk = tracks.at(idx);
+    const Util::RelAccX &pages = trk.pages;
+    const Util::RelAccXFieldData &avail = trk.pageFields[PAGE_AVAIL];
+    const Util::RelAccXFieldData &firsttime = trk.pageFields[PAGE_FIRSTTIME];
+    const Util::RelAccXFieldData &firstkey = trk.pageFields[PAGE_FIRSTKEY];
+    uint64_t res = lastAvailablePage(pages, avail, findPage(pages, firsttime, time));
+    DONTEVEN_MSG("Page number for time %" PRIu64 " on track %" PRIu32 " can be found on page %" PRIu64, time, idx, pages.getInt(firstkey, res));
+    return pages.getInt(firstkey, res);
   }
 
   /// Given a key, returns the page number it can be found on.
   /// If the key is not available, returns the closest page that is.
   size_t Meta::getPageNumberForKey(uint32_t idx, uint64_t keyNum) const{
-    const Util::RelAccX &pages = tracks.at(idx).pages;
-    size_t res = pages.getStartPos();
-    for (size_t i = pages.getStartPos(); i < pages.getEndPos(); ++i){
-      if (pages.getInt("avail", i) == 0){continue;}
-      if (pages.getInt("firstkey", i) > keyNum){break;}
-      res = i;
-    }
-    return pages.getInt("firstkey", res);
+    const Track &trk = tracks.at(idx);
+    const Util::RelAccX &pages = trk.pages;
+    const Util::RelAccXFieldData &avail = trk.pageFields[PAGE_AVAIL];
+    const Util::RelAccXFieldData &firstkey = trk.pageFields[PAGE_FIRSTKEY];
+    return pages.getInt(firstkey, lastAvailablePage(pages, avail, findPage(pages, firstkey, keyNum)));
   }
 
   /// Returns the key number containing a given time.
@@ -3248,20 +3611,27 @@ namespace DTSC{
     const Util::RelAccX &parts = trk.parts;
     if (!keys.getEndPos()){return INVALID_KEY_NUM;}
     size_t res = keys.getStartPos();
-    for (size_t i = res; i < keys.getEndPos(); i++){
-      if (keys.getInt(trk.keyTimeField, i) > time){
-        //It's possible we overshot our timestamp, but the previous key does not contain it.
-        //This happens when seeking to a timestamp past the last part of the previous key, but
-        //before the first part of the next key.
-        //In this case, we should _not_ return the previous key, but the current key.
-        //That prevents getting stuck at the end of the page, waiting for a part to show up that never will.
-        if (keys.getInt(trk.keyFirstPartField, i) > parts.getStartPos()){
-          uint64_t dur = parts.getInt(trk.partDurationField, keys.getInt(trk.keyFirstPartField, i)-1);
-          if (keys.getInt(trk.keyTimeField, i) - dur < time){res = i;}
-        }
-        continue;
+    // Binary search for the first key after time; the one before it contains time
+    size_t lo = res, hi = keys.getEndPos();
+    while (lo < hi){
+      size_t mid = lo + (hi - lo) / 2;
+      if (keys.getInt(trk.keyTimeField, mid) > time){
+        hi = mid;
+      }else{
+        lo = mid + 1;
+      }
+    }
+    if (lo > res){res = lo - 1;}
+    if (lo < keys.getEndPos()){
+      //It's possible we overshot our timestamp, but the previous key does not contain it.
+      //This happens when seeking to a timestamp past the last part of the previous key, but
+      //before the first part of the next key.
+      //In this case, we should _not_ return the previous key, but the current key.
+      //That prevents getting stuck at the end of the page, waiting for a part to show up that never will.
+      if (keys.getInt(trk.keyFirstPartField, lo) > parts.getStartPos()){
+        uint64_t dur = parts.getInt(trk.partDurationField, keys.getInt(trk.keyFirstPartField, lo)-1);
+        if (keys.getInt(trk.keyTimeField, lo) - dur < time){res = lo;}
       }
-      res = i;
     }
     DONTEVEN_MSG("Key number for time %" PRIu64 " on track %" PRIu32 " is %zu", time, idx, res);
     return res;
@@ -3448,12 +3818,17 @@ namespace DTSC{
   }
   size_t Keys::getSize(size_t idx) const{return cKeys.getInt(sizeField, idx);}
 
-  Fragments::Fragments(const Util::RelAccX &_fragments) : fragments(_fragments){}
+  Fragments::Fragments(const Util::RelAccX &_fragments) : fragments(_fragments){
+    durationField = fragments.getFieldData("duration");
+    keysField = fragments.getFieldData("keys");
+    firstKeyField = fragments.getFieldData("firstkey");
+    sizeField = fragments.getFieldData("size");
+  }
   size_t Fragments::getFirstValid() const{return fragments.getDeleted();}
   size_t Fragments::getEndValid() const{return fragments.getEndPos();}
   size_t Fragments::getValidCount() const{return getEndValid() - getFirstValid();}
-  uint64_t Fragments::getDuration(size_t idx) const{return fragments.getInt("duration", idx);}
-  size_t Fragments::getKeycount(size_t idx) const{return fragments.getInt("keys", idx);}
-  size_t Fragments::getFirstKey(size_t idx) const{return fragments.getInt("firstkey", idx);}
-  size_t Fragments::getSize(size_t idx) const{return fragments.getInt("size", idx);}
+  uint64_t Fragments::getDuration(size_t idx) const{return fragments.getInt(durationField, idx);}
+  size_t Fragments::getKeycount(size_t idx) const{return fragments.getInt(keysField, idx);}
+  size_t Fragments::getFirstKey(size_t idx) const{return fragments.getInt(firstKeyField, idx);}
+  size_t Fragments::getSize(size_t idx) const{return fragments.getInt(sizeField, idx);}
 }// namespace DTSC
@@ -27,6 +27,8 @@
 #define TRACK_VALID_INT_PROCESS 4 //internal processes
 #define TRACK_VALID_ALL 0xFF //all of the above, default
 
+#define TRACK_TYPECODEC_CACHE 32 // Size of the track list type and codec fields (RAX_32STRING)
+
 // Increase this value every time the DTSH file format changes in an incompatible way
 // Changelog:
 //  Version 0-2: Undocumented changes
@@ -57,6 +59,50 @@ namespace DTSC{
 
   enum packType{DTSC_INVALID, DTSC_HEAD, DTSC_V1, DTSC_V2, DTCM};
 
+  /// Track types as integers, for hot paths that should not compare strings. See Meta::getTypeId.
+  enum trackType{TYPE_UNKNOWN, TYPE_VIDEO, TYPE_AUDIO, TYPE_META};
+
+  /// Track codecs as integers, for hot paths that should not compare strings. See Meta::getCodecId.
+  /// Codecs not listed here are CODEC_UNKNOWN; use Meta::getCodec for those.
+  enum codecType{
+    CODEC_UNKNOWN,
+    CODEC_H264,
+    CODEC_HEVC,
+    CODEC_AV1,
+    CODEC_VP8,
+    CODEC_VP9,
+    CODEC_VP6,
+    CODEC_VP6ALPHA,
+    CODEC_MPEG2,
+    CODEC_H263,
+    CODEC_JPEG,
+    CODEC_THEORA,
+    CODEC_SCREENVIDEO1,
+    CODEC_SCREENVIDEO2,
+    CODEC_AAC,
+    CODEC_MP3,
+    CODEC_MP2,
+    CODEC_AC3,
+    CODEC_EAC3,
+    CODEC_DTS,
+    CODEC_OPUS,
+    CODEC_VORBIS,
+    CODEC_PCM,
+    CODEC_ALAW,
+    CODEC_ULAW,
+    CODEC_FLOAT,
+    CODEC_ADPCM,
+    CODEC_NELLYMOSER,
+    CODEC_SPEEX,
+    CODEC_RAWTS,
+    CODEC_JSON,
+    CODEC_SUBTITLE,
+    CODEC_ID3
+  };
+
+  trackType typeFromString(const std::string &type);
+  codecType codecFromString(const std::string &codec);
+
   /// This class allows scanning through raw binary format DTSC data.
   /// It can be used as an iterator or as a direct accessor.
   class Scan{
@@ -211,6 +257,20 @@ namespace DTSC{
     Util::RelAccXFieldData sizeField;
   };
 
+  /// Fields of the data page records of a track, in pageFieldDefs order
+  enum pageField{
+    PAGE_FIRSTKEY,
+    PAGE_KEYCOUNT,
+    PAGE_PARTS,
+    PAGE_SIZE,
+    PAGE_AVAIL,
+    PAGE_FIRSTTIME,
+    PAGE_LASTKEYTIME,
+    PAGE_FIELDS
+  };
+  extern const Util::RelAccXFieldDef pageFieldDefs[PAGE_FIELDS];
+  typedef Util::RelAccXSchema<PAGE_FIELDS> PageSchema;
+
   class Fragments{
   public:
     Fragments(const Util::RelAccX &_fragments);
@@ -224,10 +284,15 @@ namespace DTSC{
 
   private:
     const Util::RelAccX &fragments;
+    Util::RelAccXFieldData durationField;
+    Util::RelAccXFieldData keysField;
+    Util::RelAccXFieldData firstKeyField;
+    Util::RelAccXFieldData sizeField;
   };
 
   class Track{
   public:
+    Track();
     Util::RelAccX parts;
     Util::RelAccX keys;
     Util::RelAccX fragments;
@@ -274,6 +339,15 @@ namespace DTSC{
     Util::RelAccXFieldData fragmentSizeField;
 
     Util::RelAccXFieldData extraJSON;
+
+    PageSchema pageFields;
+
+    // Integer type and codec, with the raw track list strings they were parsed from.
+    // Re-parsed only when those strings change; see Meta::getTypeId and Meta::getCodecId.
+    mutable char typeCache[TRACK_TYPECODEC_CACHE];
+    mutable trackType typeId;
+    mutable char codecCache[TRACK_TYPECODEC_CACHE];
+    mutable codecType codecId;
   };
 
   class Meta{
@@ -339,6 +413,10 @@ namespace DTSC{
     void markUpdated(size_t trackIdx);
     uint64_t getLastUpdated(size_t trackIdx) const;
     uint64_t getLastUpdated() const;
+    uint32_t getUpdateGeneration() const;
+    bool waitForUpdate(uint32_t generation, uint64_t maxWaitMs) const;
+    uint32_t getTrackGeneration(size_t trackIdx) const;
+    bool waitForTrackUpdate(size_t trackIdx, uint32_t generation, uint64_t maxWaitMs) const;
 
     void setChannels(size_t trackIdx, uint16_t channels);
     uint16_t getChannels(size_t trackIdx) const;
@@ -357,9 +435,11 @@ namespace DTSC{
 
     void setType(size_t trackIdx, const std::string &type);
     std::string getType(size_t trackIdx) const;
+    trackType getTypeId(size_t trackIdx) const;
 
     void setCodec(size_t trackIdx, const std::string &codec);
     std::string getCodec(size_t trackIdx) const;
+    codecType getCodecId(size_t trackIdx) const;
 
     void setLang(size_t trackIdx, const std::string &lang);
     std::string getLang(size_t trackIdx) const;
@@ -478,6 +558,7 @@ namespace DTSC{
     const Util::RelAccX &fragments(size_t idx) const;
     Util::RelAccX &pages(size_t idx);
     const Util::RelAccX &pages(size_t idx) const;
+    const PageSchema &pageFields(size_t idx) const;
 
     std::string toPrettyString() const;
 
@@ -526,6 +607,10 @@ namespace DTSC{
     Util::RelAccXFieldData streamBootMsOffsetField;
     Util::RelAccXFieldData streamUTCOffsetField;
     Util::RelAccXFieldData streamMinimumFragmentDurationField;
+    Util::RelAccXFieldData streamNotifyField;
+    volatile uint32_t *notifyWord() const;
+    volatile uint32_t *trackNotifyWord(size_t trackIdx) const;
+    void notifyUpdate(size_t trackIdx);
 
     Util::RelAccXFieldData trackValidField;
     Util::RelAccXFieldData trackIdField;
@@ -533,6 +618,7 @@ namespace DTSC{
     Util::RelAccXFieldData trackCodecField;
     Util::RelAccXFieldData trackPageField;
     Util::RelAccXFieldData trackLastUpdateField;
+    Util::RelAccXFieldData trackNotifyField;
     Util::RelAccXFieldData trackPidField;
     Util::RelAccXFieldData trackMinKeepAwayField;
     Util::RelAccXFieldData trackSourceTidField;
@@ -543,4 +629,7 @@ namespace DTSC{
     Util::RelAccXFieldData trackMilliSyncMsField;
     Util::RelAccXFieldData trackFirstRtpMsField;
   };
+
+  int watchUpdates(const std::string &streamName);
+  void unwatchUpdates(const std::string &streamName);
 }// namespace DTSC
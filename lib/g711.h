@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/// ITU-T G.711 A-law and mu-law decoding.
+/// Buffers are decoded with SIMD kernels where the CPU supports them, picked once at startup.
+namespace G711{
+  enum Codec{UNKNOWN = 0, ALAW, ULAW};
+
+  Codec getCodec(const std::string &name);
+  const char *getName(Codec codec);
+  const char *getKernel();
+  bool setKernel(const std::string &name);
+
+  int16_t alawToPcm(uint8_t alaw);
+  int16_t ulawToPcm(uint8_t ulaw);
+  bool decode(Codec codec, const char *in, int16_t *out, size_t count);
+}// namespace G711
@@ -5,18 +5,23 @@ namespace AACConverter{
   // pcm_mulaw, 8000 Hz, mono, s16, 64 kb/s
   AACConverter::AACConverter(uint32_t inSampleRate, uint16_t inChannels, uint16_t outBitrate, uint32_t outBandwidth){
     isInitialized = true;
+    pcmBuffer = 0;
+    aacBuffer = 0;
     // Initialize FAAC encoder
     faac = faacEncOpen(inSampleRate, inChannels, &numInputSamples, &maxOutAacBytes);
+    INFO_MSG("[FAAC] Decoding G.711 with the %s kernel", G711::getKernel());
     INFO_MSG("[FAAC] Needs %d input PCM samples and will fill a max of %d", numInputSamples, maxOutAacBytes);
     if (faac == NULL){
       isInitialized = false;
       FAIL_MSG("[FAAC] Failed to initialize the encoder");
     }
     if (isInitialized){
-      pcmBufferSize = 0;
-      frameMsTime = 0;
-      first = true;
-      pcmBuffer = new int16_t[numInputSamples*8];
+      // Both buffers are allocated once here; encoding never allocates
+      pcmCapacity = numInputSamples*8;
+      pcmStart = 0;
+      pcmEnd = 0;
+      pcmBuffer = new int16_t[pcmCapacity];
+      aacBuffer = new unsigned char[maxOutAacBytes];
       // Set encoding parameters
       // https://github.com/knik0/faac/blob/master/docs/libfaac.pdf
       faacEncConfigurationPtr config = faacEncGetCurrentConfiguration(faac);
@@ -34,8 +39,7 @@ namespace AACConverter{
         isInitialized = false;
         FAIL_MSG("[FAAC] Failed to configure the encoder");
       }else{
-        frameDuration = (double(numInputSamples) / (config->bandWidth * 2)) * 1000;
-        INFO_MSG("[FAAC] FAAC output initialized with bitrate %llu and bandwidth %llu and frameDuration %llu", config->bitRate, config->bandWidth, frameDuration);
+        INFO_MSG("[FAAC] FAAC output initialized with bitrate %lu and bandwidth %u", config->bitRate, config->bandWidth);
       }
     }
 	}
@@ -44,162 +48,177 @@ namespace AACConverter{
     if (isInitialized){
       faacEncClose(faac);
       VERYHIGH_MSG("[FAAC] closed");
-      delete[] pcmBuffer;
     }
+    if (pcmBuffer){delete[] pcmBuffer;}
+    if (aacBuffer){delete[] aacBuffer;}
   }
 
-  static int16_t alawToPcm(uint8_t alaw){
-    // https://github.com/GStreamer/gst-plugins-good/blob/master/gst/law/alaw-decode.c
-    static const int16_t alawToLinearTable[256] = {
-    -5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736,
-    -7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784,
-    -2752, -2624, -3008, -2880, -2240, -2112, -2496, -2368,
-    -3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392,
-    -22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
-    -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
-    -11008, -10496, -12032, -11520, -8960, -8448, -9984, -9472,
-    -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
-    -344, -328, -376, -360, -280, -264, -312, -296,
-    -472, -456, -504, -488, -408, -392, -440, -424,
-    -88, -72, -120, -104, -24, -8, -56, -40,
-    -216, -200, -248, -232, -152, -136, -184, -168,
-    -1376, -1312, -1504, -1440, -1120, -1056, -1248, -1184,
-    -1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696,
-    -688, -656, -752, -720, -560, -528, -624, -592,
-    -944, -912, -1008, -976, -816, -784, -880, -848,
-    5504, 5248, 6016, 5760, 4480, 4224, 4992, 4736,
-    7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784,
-    2752, 2624, 3008, 2880, 2240, 2112, 2496, 2368,
-    3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392,
-    22016, 20992, 24064, 23040, 17920, 16896, 19968, 18944,
-    30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136,
-    11008, 10496, 12032, 11520, 8960, 8448, 9984, 9472,
-    15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568,
-    344, 328, 376, 360, 280, 264, 312, 296,
-    472, 456, 504, 488, 408, 392, 440, 424,
-    88, 72, 120, 104, 24, 8, 56, 40,
-    216, 200, 248, 232, 152, 136, 184, 168,
-    1376, 1312, 1504, 1440, 1120, 1056, 1248, 1184,
-    1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696,
-    688, 656, 752, 720, 560, 528, 624, 592,
-    944, 912, 1008, 976, 816, 784, 880, 848
-    };
-
-    return alawToLinearTable[alaw];
-  }
-
-  static int16_t ulawToPcm(uint8_t ulaw){
-    // https://github.com/dpwe/dpwelib/blob/master/ulaw.c
-    static const int16_t ulawToLinearTable[256] = {
-    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
-    -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
-    -15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
-    -11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316,
-    -7932, -7676, -7420, -7164, -6908, -6652, -6396, -6140,
-    -5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092,
-    -3900, -3772, -3644, -3516, -3388, -3260, -3132, -3004,
-    -2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980,
-    -1884, -1820, -1756, -1692, -1628, -1564, -1500, -1436,
-    -1372, -1308, -1244, -1180, -1116, -1052, -988, -924,
-    -876, -844, -812, -780, -748, -716, -684, -652,
-    -620, -588, -556, -524, -492, -460, -428, -396,
-    -372, -356, -340, -324, -308, -292, -276, -260,
-    -244, -228, -212, -196, -180, -164, -148, -132,
-    -120, -112, -104, -96, -88, -80, -72, -64,
-    -56, -48, -40, -32, -24, -16, -8, 0,
-    32124, 31100, 30076, 29052, 28028, 27004, 25980, 24956,
-    23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764,
-    15996, 15484, 14972, 14460, 13948, 13436, 12924, 12412,
-    11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316,
-    7932, 7676, 7420, 7164, 6908, 6652, 6396, 6140,
-    5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092,
-    3900, 3772, 3644, 3516, 3388, 3260, 3132, 3004,
-    2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980,
-    1884, 1820, 1756, 1692, 1628, 1564, 1500, 1436,
-    1372, 1308, 1244, 1180, 1116, 1052, 988, 924,
-    876, 844, 812, 780, 748, 716, 684, 652,
-    620, 588, 556, 524, 492, 460, 428, 396,
-    372, 356, 340, 324, 308, 292, 276, 260,
-    244, 228, 212, 196, 180, 164, 148, 132,
-    120, 112, 104, 96, 88, 80, 72, 64,
-    56, 48, 40, 32, 24, 16, 8, 0
-    };
-
-    return ulawToLinearTable[ulaw];
+  /// Appends PCM samples to the buffer. If the buffer is full, the samples not encoded yet are dropped first.
+  /// Returns false if the samples could not be added at all.
+  bool AACConverter::addPCM(const int16_t* pcm, uint32_t samples){
+    if (!isInitialized || !pcm || !samples){return false;}
+    if (samples > pcmCapacity){
+      WARN_MSG("[FAAC] Dropped %u samples that do not fit the PCM buffer", samples);
+      return false;
+    }
+    // Make room at the end of the buffer, moving the unencoded remainder to the front only when needed
+    if (pcmEnd + samples > pcmCapacity){
+      if (pcmEnd - pcmStart + samples > pcmCapacity){
+        WARN_MSG("[FAAC] Cleared PCM buffer (%zu samples) to prevent overflow", pcmEnd - pcmStart);
+        pcmStart = pcmEnd;
+      }
+      memmove(pcmBuffer, pcmBuffer + pcmStart, (pcmEnd - pcmStart)*sizeof(int16_t));
+      pcmEnd -= pcmStart;
+      pcmStart = 0;
+    }
+    memcpy(pcmBuffer + pcmEnd, pcm, samples*sizeof(int16_t));
+    pcmEnd += samples;
+    VERYHIGH_MSG("[FAAC] Current size of pcmBuffer is %zu samples", pcmEnd - pcmStart);
+    return true;
   }
 
-  void AACConverter::transcode(std::string inCodec, const char* inData, uint32_t inSize, unsigned char* &outAac, int32_t &outAacSize){
-    /* --- Pre-validations start */
+  /// Encodes a single frame of buffered PCM data, if there is enough of it.
+  /// Returns false if less than numInputSamples samples are buffered. Otherwise, those samples are consumed and
+  /// outAacSize is set to the encoded size: negative on errors, zero while the encoder is still filling its delay.
+  /// When positive, outAac points to the internal output buffer, which stays valid until the next call.
+  bool AACConverter::encodeFrame(unsigned char* &outAac, int32_t &outAacSize){
     outAacSize = -1;
-    if (!isInitialized){
-      FAIL_MSG("[FAAC] Not initialised");
-      return;
-    }
-    if (inCodec != "ALAW" && inCodec != "ULAW"){
-      FAIL_MSG("[FAAC] Unsupported codec %s provided", inCodec.c_str());
-      return;
+    if (!isInitialized || pcmEnd - pcmStart < numInputSamples){return false;}
+    HIGH_MSG("[FAAC] Sending %lu PCM bytes for AAC conversion", numInputSamples*sizeof(int16_t));
+    int bytesEncoded = faacEncEncode(faac, (int32_t*)(pcmBuffer + pcmStart), numInputSamples, aacBuffer, maxOutAacBytes);
+    pcmStart += numInputSamples;
+    if (pcmStart == pcmEnd){pcmStart = pcmEnd = 0;}
+    if (bytesEncoded < 0){
+      ERROR_MSG("[FAAC] Encoding failed with code %d", bytesEncoded);
+    }else if (bytesEncoded == 0){
+      HIGH_MSG("[FAAC] Encoded %lu PCM samples to ZERO AAC bytes", numInputSamples);
+    }else{
+      outAac = aacBuffer;
+      VERYHIGH_MSG("[FAAC] Encoded %lu PCM samples to %d AAC bytes", numInputSamples, bytesEncoded);
     }
-    if (!inData || !inSize){
-      FAIL_MSG("[FAAC] No %s input data provided", inCodec.c_str());
+    outAacSize = bytesEncoded;
+    return true;
+  }
+
+  AACWorker::AACWorker(uint32_t inSampleRate, uint16_t inChannels, uint16_t outBitrate, uint32_t outBandwidth)
+      : conv(inSampleRate, inChannels, outBitrate, outBandwidth), blocks(AAC_PCM_BLOCKS), frames(AAC_FRAMES){
+    sampleRate = inSampleRate ? inSampleRate : 8000;
+    channels = inChannels ? inChannels : 1;
+    idle = false;
+    running = true;
+    started = false;
+    baseMs = 0;
+    samplesIn = 0;
+    samplesOut = 0;
+    thread = 0;
+    if (conv && conv.maxOutAacBytes > AAC_FRAME_MAX_BYTES){
+      FAIL_MSG("[FAAC] Encoder frames of up to %lu bytes do not fit in %d bytes", conv.maxOutAacBytes, AAC_FRAME_MAX_BYTES);
       return;
     }
-    /* Pre-validations end --- */
+    if (conv){thread = new tthread::thread(workerThread, this);}
+  }
 
-    // Convert ALAW/ULAW to PCM using standard lookup table from ITU-T G.711
-    int16_t* pcmData = new int16_t[inSize];
-    if (inCodec == "ALAW"){
-      for (int i = 0; i < inSize; ++i){
-        pcmData[i] = alawToPcm(static_cast<uint8_t>(inData[i]));
+  AACWorker::~AACWorker(){
+    running = false;
+    if (thread){
+      {
+        tthread::lock_guard<tthread::mutex> guard(waitMutex);
+        waitCond.notify_one();
       }
+      thread->join();
+      delete thread;
     }
-    if (inCodec == "ULAW"){
-      for (int i = 0; i < inSize; ++i){
-        pcmData[i] = ulawToPcm(static_cast<uint8_t>(inData[i]));
-      }
+  }
+
+  /// Decodes G.711 input into PCM blocks and queues them for the encoder thread.
+  /// Returns false if the input was (partially) dropped.
+  bool AACWorker::push(G711::Codec inCodec, uint64_t msTime, const char* inData, uint32_t inSize){
+    if (!thread){return false;}
+    if (inCodec != G711::ALAW && inCodec != G711::ULAW){
+      FAIL_MSG("[FAAC] Unsupported codec %s provided", G711::getName(inCodec));
+      return false;
     }
-    std::memcpy(pcmBuffer+(pcmBufferSize / sizeof(int16_t)), pcmData, inSize*sizeof(int16_t));
-    delete[] pcmData;
-    pcmBufferSize += inSize*sizeof(int16_t);
-    VERYHIGH_MSG("[FAAC] Current size of pcmBuffer is %ub", pcmBufferSize);
-    if (pcmBufferSize < numInputSamples*sizeof(int16_t)){
-      return;
+    bool ret = true;
+    for (uint32_t offset = 0; offset < inSize; offset += AAC_PCM_BLOCK_SAMPLES){
+      PCMBlock* block = blocks.back();
+      if (!block){
+        WARN_MSG("[FAAC] Encoder is falling behind, dropped %u %s samples", inSize - offset, G711::getName(inCodec));
+        ret = false;
+        break;
+      }
+      block->samples = std::min(inSize - offset, (uint32_t)AAC_PCM_BLOCK_SAMPLES);
+      block->msTime = msTime + (uint64_t)(offset / channels) * 1000 / sampleRate;
+      G711::decode(inCodec, inData + offset, block->pcm, block->samples);
+      blocks.push();
     }
-    if (pcmBufferSize > numInputSamples*7){
-      pcmBufferSize = 0;
-      WARN_MSG("[FAAC] Cleared PCM buffer (%u) to prevent memory leak", pcmBufferSize);
-      return;
+    // The encoder thread sets idle before its final check for input, so either it sees the new block or we see idle
+    __sync_synchronize();
+    if (idle){
+      tthread::lock_guard<tthread::mutex> guard(waitMutex);
+      waitCond.notify_one();
     }
-    HIGH_MSG("[FAAC] Sending %u PCM bytes for AAC conversion", numInputSamples*sizeof(int16_t));
+    return ret;
+  }
 
-    // Encode PCM data to AAC
-    int bytesEncoded = faacEncEncode(faac, (int32_t*)pcmBuffer, numInputSamples, outAac, maxOutAacBytes);
-    /* --- Conversion handling starts */
-    if (bytesEncoded < 0){
-      ERROR_MSG("[FAAC] Encoding failed with code %d", bytesEncoded);
-      pcmBufferSize = 0;
-      if (!first){
-        WARN_MSG("[FAAC] Encoding failed, still incrementing frameMsTime");
-        frameMsTime += frameDuration;
-      }
-      return;
-    }else if (bytesEncoded == 0){
-      WARN_MSG("[FAAC] Encoded %d PCM samples to ZERO AAC bytes", numInputSamples);
-      outAacSize = 0;
-      return;
-    }else{
-      if (first){
-        HIGH_MSG("[FAAC] Set the first timestamp to %llu", frameMsTime);
-        first = false;
-      }else{
-        frameMsTime += frameDuration;
+  /// Returns the oldest encoded frame not yet picked up, or null if there is none.
+  AACFrame* AACWorker::front(){return frames.front();}
+
+  /// Releases the frame returned by front().
+  void AACWorker::pop(){frames.pop();}
+
+  /// Returns true while input handed to push() is still waiting to be encoded.
+  /// Once false, all frames for that input can be picked up through front().
+  bool AACWorker::busy() const{return thread && !blocks.empty();}
+
+  void AACWorker::workerThread(void* arg){((AACWorker*)arg)->run();}
+
+  void AACWorker::run(){
+    while (running){
+      PCMBlock* block = blocks.front();
+      if (!block){
+        tthread::lock_guard<tthread::mutex> guard(waitMutex);
+        idle = true;
+        __sync_synchronize();
+        while (running && !blocks.front()){waitCond.wait(waitMutex);}
+        idle = false;
+        continue;
       }
-      memmove(pcmBuffer, pcmBuffer+numInputSamples, pcmBufferSize-numInputSamples*sizeof(int16_t));
-      pcmBufferSize -= numInputSamples*sizeof(int16_t);
-      outAacSize = bytesEncoded;
-      INFO_MSG("[FAAC] (%ums) Encoded %d PCM samples to %d AAC bytes", frameMsTime, numInputSamples, bytesEncoded);
+      encodeBlock(*block);
+      blocks.pop();
     }
-    /* Conversion handling ends --- */
+  }
+
+  /// Feeds a block to the encoder and queues all frames that come out.
+  /// Frame timestamps run on from the first input by sample count, only jumping ahead when the input does.
+  void AACWorker::encodeBlock(const PCMBlock &block){
+    uint64_t expectMs = baseMs + samplesIn * 1000 / sampleRate;
+    if (!started){
+      started = true;
+      baseMs = block.msTime;
+    }else if (block.msTime > expectMs + AAC_RESYNC_MS){
+      INFO_MSG("[FAAC] Input jumped %" PRIu64 "ms ahead, moving output timestamps along", block.msTime - expectMs);
+      baseMs += block.msTime - expectMs;
+    }
+    samplesIn += block.samples / channels;
+    conv.addPCM(block.pcm, block.samples);
 
-    VERYHIGH_MSG("[FAAC] Remaining PCM data after conversion is %ub", pcmBufferSize);
+    unsigned char* aac = 0;
+    int32_t aacSize;
+    while (conv.encodeFrame(aac, aacSize)){
+      // The encoder delay shifts all output by the same amount, so the first frame out gets the first input time
+      if (!aacSize){continue;}
+      uint64_t frameMs = baseMs + samplesOut * 1000 / sampleRate;
+      samplesOut += conv.numInputSamples / channels;
+      if (aacSize < 0){continue;}
+      AACFrame* frame = frames.back();
+      if (!frame){
+        WARN_MSG("[FAAC] Encoded frames are not picked up, dropped frame at %" PRIu64 "ms", frameMs);
+        continue;
+      }
+      frame->msTime = frameMs;
+      frame->size = aacSize;
+      memcpy(frame->data, aac, aacSize);
+      frames.push();
+    }
   }
 }
@@ -1,3 +1,4 @@
+#pragma once
 #include <vector>
 #include <faac.h>
 #include <cstdint>
@@ -6,23 +7,80 @@
 #include <stdexcept>
 #include <cstring>
 #include "util.h"
+#include "g711.h"
+#include "tinythread.h"
 #include "defines.h"
 
+#define AAC_PCM_BLOCK_SAMPLES 1024 // Max PCM samples per block handed to the encoder thread
+#define AAC_PCM_BLOCKS 64          // Blocks that can be queued for the encoder thread
+#define AAC_FRAME_MAX_BYTES 6144   // Max size of a single encoded AAC frame (FAAC: 768 bytes per channel)
+#define AAC_FRAMES 32              // Encoded frames that can wait to be picked up
+#define AAC_RESYNC_MS 500          // Input gap after which output timestamps jump ahead instead of running on
+#define AAC_DRAIN_WAIT 1000        // Max ms to wait for the encoder thread to finish queued input when draining
+
 namespace AACConverter {
   class AACConverter {
     private:
       faacEncHandle faac;
       bool isInitialized;
-      int16_t* pcmBuffer;
-      uint32_t pcmBufferSize;
-      uint16_t frameDuration;
-      bool first;
+      int16_t* pcmBuffer; ///< Ring of PCM samples, numInputSamples*8 large
+      size_t pcmCapacity; ///< Size of pcmBuffer, in samples
+      size_t pcmStart; ///< First sample in pcmBuffer not yet encoded
+      size_t pcmEnd; ///< One past the last sample in pcmBuffer
+      unsigned char* aacBuffer; ///< Output buffer for a single AAC frame, maxOutAacBytes large
     public:
       AACConverter(uint32_t inSampleRate, uint16_t inChannels, uint16_t outBitrate, uint32_t outBandwidth);
       ~AACConverter();
-      unsigned long numInputSamples;
-      uint64_t frameMsTime;
+      unsigned long numInputSamples; ///< Samples per AAC frame, over all channels
       unsigned long maxOutAacBytes;
-      void transcode(std::string inCodec, const char* inData, uint32_t inSize, unsigned char* &outAac, int32_t &outAacSize);
+      operator bool() const{return isInitialized;}
+      bool addPCM(const int16_t* pcm, uint32_t samples);
+      bool encodeFrame(unsigned char* &outAac, int32_t &outAacSize);
+  };
+
+  /// A block of PCM input for the encoder thread
+  struct PCMBlock{
+    uint64_t msTime; ///< Time of the first sample
+    uint32_t samples; ///< Samples in pcm, over all channels
+    int16_t pcm[AAC_PCM_BLOCK_SAMPLES];
+  };
+
+  /// A single encoded AAC frame, waiting to be picked up from the encoder thread
+  struct AACFrame{
+    uint64_t msTime;
+    uint32_t size;
+    char data[AAC_FRAME_MAX_BYTES];
+  };
+
+  /// Encodes G.711 audio to AAC on its own thread, so slow encodes never hold up packet ingest.
+  /// push, front and pop are to be called from the ingest thread only.
+  /// Output timestamps follow from the number of samples encoded, counting from the first input.
+  class AACWorker{
+    public:
+      AACWorker(uint32_t inSampleRate, uint16_t inChannels, uint16_t outBitrate, uint32_t outBandwidth);
+      ~AACWorker();
+      bool push(G711::Codec inCodec, uint64_t msTime, const char* inData, uint32_t inSize);
+      AACFrame* front();
+      void pop();
+      bool busy() const;
+    private:
+      static void workerThread(void* arg);
+      void run();
+      void encodeBlock(const PCMBlock &block);
+      AACConverter conv;
+      uint32_t sampleRate;
+      uint16_t channels;
+      Util::SPSCQueue<PCMBlock> blocks; ///< Ingest thread to encoder thread
+      Util::SPSCQueue<AACFrame> frames; ///< Encoder thread to ingest thread
+      tthread::mutex waitMutex;
+      tthread::condition_variable waitCond;
+      volatile bool idle; ///< True while the encoder thread is (about to be) waiting for input
+      volatile bool running;
+      tthread::thread* thread;
+      // Only used by the encoder thread
+      bool started;
+      uint64_t baseMs; ///< Time of the first sample
+      uint64_t samplesIn; ///< Samples per channel received since baseMs
+      uint64_t samplesOut; ///< Samples per channel covered by the frames output so far
   };
 }
@@ -31,84 +31,6 @@ namespace MP3Converter{
       VERYHIGH_MSG("[RTMPServer] LAME closed");
     }
 
-    static int16_t alawToPcm(uint8_t alaw){
-      static const int16_t alawToLinearTable[256] = {
-        -5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736,
-        -7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784,
-        -2752, -2624, -3008, -2880, -2240, -2112, -2496, -2368,
-        -3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392,
-        -22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
-        -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
-        -11008, -10496, -12032, -11520, -8960, -8448, -9984, -9472,
-        -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
-        -344, -328, -376, -360, -280, -264, -312, -296,
-        -472, -456, -504, -488, -408, -392, -440, -424,
-        -88, -72, -120, -104, -24, -8, -56, -40,
-        -216, -200, -248, -232, -152, -136, -184, -168,
-        -1376, -1312, -1504, -1440, -1120, -1056, -1248, -1184,
-        -1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696,
-        -688, -656, -752, -720, -560, -528, -624, -592,
-        -944, -912, -1008, -976, -816, -784, -880, -848,
-        5504, 5248, 6016, 5760, 4480, 4224, 4992, 4736,
-        7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784,
-        2752, 2624, 3008, 2880, 2240, 2112, 2496, 2368,
-        3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392,
-        22016, 20992, 24064, 23040, 17920, 16896, 19968, 18944,
-        30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136,
-        11008, 10496, 12032, 11520, 8960, 8448, 9984, 9472,
-        15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568,
-        344, 328, 376, 360, 280, 264, 312, 296,
-        472, 456, 504, 488, 408, 392, 440, 424,
-        88, 72, 120, 104, 24, 8, 56, 40,
-        216, 200, 248, 232, 152, 136, 184, 168,
-        1376, 1312, 1504, 1440, 1120, 1056, 1248, 1184,
-        1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696,
-        688, 656, 752, 720, 560, 528, 624, 592,
-        944, 912, 1008, 976, 816, 784, 880, 848
-      };
-
-      return alawToLinearTable[alaw];
-    }
-
-    static int16_t ulawToPcm(uint8_t ulaw){
-      static const int16_t ulawToLinearTable[256] = {
-        -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
-        -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
-        -15740, -14716, -13692, -12668, -11644, -10620,  -9596,  -8572,
-        -7548,  -6524,  -5500,  -4476,  -3452,  -2428,  -1404,   -380,
-        -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
-        -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
-        -15740, -14716, -13692, -12668, -11644, -10620,  -9596,  -8572,
-        -7548,  -6524,  -5500,  -4476,  -3452,  -2428,  -1404,   -380,
-        32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
-        23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
-        15740,  14716,  13692,  12668,  11644,  10620,   9596,   8572,
-        7548,   6524,   5500,   4476,   3452,   2428,   1404,    380,
-        32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
-        23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
-        15740,  14716,  13692,  12668,  11644,  10620,   9596,   8572,
-        7548,   6524,   5500,   4476,   3452,   2428,   1404,    380,
-        -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
-        -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
-        -15740, -14716, -13692, -12668, -11644, -10620,  -9596,  -8572,
-        -7548,  -6524,  -5500,  -4476,  -3452,  -2428,  -1404,   -380,
-        -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
-        -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
-        -15740, -14716, -13692, -12668, -11644, -10620,  -9596,  -8572,
-        -7548,  -6524,  -5500,  -4476,  -3452,  -2428,  -1404,   -380,
-        32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
-        23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
-        15740,  14716,  13692,  12668,  11644,  10620,   9596,   8572,
-        7548,   6524,   5500,   4476,   3452,   2428,   1404,    380,
-        32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
-        23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
-        15740,  14716,  13692,  12668,  11644,  10620,   9596,   8572,
-        7548,   6524,   5500,   4476,   3452,   2428,   1404,    380
-      };
-
-      return ulawToLinearTable[ulaw ^ 0xFF];
-    }
-
     char* MP3Converter::toMemory(std::string filePath, size_t *fileSize){
       // Open the file
       std::ifstream file(filePath, std::ios::binary | std::ios::ate);
@@ -138,7 +60,7 @@ namespace MP3Converter{
     /**
      * @brief Convert a chunk of A-law/U-law data to MP3.
      *
-     * @param inCodec String identifying input codec A-law/U-law.
+     * @param inCodec Input codec, A-law or U-law.
      * @param inData  Pointer to the input A-law/U-law data.
      * @param inSize  Size of the input A-law/U-law data in bytes.
      *
@@ -152,33 +74,24 @@ namespace MP3Converter{
      *        This ensures enough space for the worst-case scenario.
      *        Formula: mp3BufferSize >= (alawSize * 1.25) + 7200
     **/
-    std::vector<char> MP3Converter::transcode(std::string inCodec, const char* inData, int inSize){
+    std::vector<char> MP3Converter::transcode(G711::Codec inCodec, const char* inData, int inSize){
       if (!isInitialized){
         FAIL_MSG("[LAME] Not initialised");
         return {};
       }
-      if (inCodec != "ALAW" && inCodec != "ULAW"){
-        FAIL_MSG("[LAME] Unsupported codec %s provided", inCodec.c_str());
+      if (inCodec != G711::ALAW && inCodec != G711::ULAW){
+        FAIL_MSG("[LAME] Unsupported codec %s provided", G711::getName(inCodec));
         return {};
       }
       if (!inData || !inSize){
-        FAIL_MSG("[LAME] No %s input data provided", inCodec.c_str());
+        FAIL_MSG("[LAME] No %s input data provided", G711::getName(inCodec));
         return {};
       }
-      HIGH_MSG("[LAME] Transcoder called with inCodec %s and inSize %d", inCodec.c_str(), inSize);
+      HIGH_MSG("[LAME] Transcoder called with inCodec %s and inSize %d", G711::getName(inCodec), inSize);
       // Ensure pcmBuffer is large enough
       std::vector<int16_t> pcmBuffer(inSize);
-      if (inCodec == "ALAW"){
-        for (uint16_t i = 0; i < inSize; ++i){
-          pcmBuffer[i] = alawToPcm(static_cast<uint8_t>(inData[i]));
-        }
-      }
-      if (inCodec == "ULAW"){
-        for (uint16_t i = 0; i < inSize; ++i){
-          pcmBuffer[i] = ulawToPcm(static_cast<uint8_t>(inData[i]));
-        }
-      }
-      HIGH_MSG("[LAME] Converted %zu bytes of %s data to PCM", pcmBuffer.size(), inCodec.c_str());
+      G711::decode(inCodec, inData, pcmBuffer.data(), inSize);
+      HIGH_MSG("[LAME] Converted %zu bytes of %s data to PCM", pcmBuffer.size(), G711::getName(inCodec));
       // Encode PCM to MP3
       int mp3BufferSize = (inSize * 1.25) + 7200;
       mp3Buffer.resize(mp3BufferSize);
@@ -203,7 +116,7 @@ namespace MP3Converter{
       }else if (bytesWritten == 0){
         HIGH_MSG("[RTMPServer] 0 bytes encoded. May be an error");
       }else{
-        HIGH_MSG("[RTMPServer] LAME encoded %d %s bytes to %d MP3 bytes", inSize, inCodec.c_str(), bytesWritten);
+        HIGH_MSG("[RTMPServer] LAME encoded %d %s bytes to %d MP3 bytes", inSize, G711::getName(inCodec), bytesWritten);
         std::vector<char> encodedMP3(mp3Buffer.begin(), mp3Buffer.begin() + bytesWritten);
         mp3Buffer.erase(mp3Buffer.begin(), mp3Buffer.begin() + bytesWritten);
         return encodedMP3;
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <stdexcept>
 #include "defines.h"
+#include "g711.h"
 
 #define LAME_QUALITY 5  // 0 = best, 9 = worst
 
@@ -19,7 +20,7 @@ namespace MP3Converter{
       MP3Converter(uint32_t inSampleRate, uint16_t inChannels, uint16_t outBitrate);
       ~MP3Converter();
       char* toMemory(std::string filePath, size_t *fileSize);
-      std::vector<char> transcode(std::string inCodec, const char* inData, int inSize);
+      std::vector<char> transcode(G711::Codec inCodec, const char* inData, int inSize);
       int finalize(char* finalBuffer, int bufferSize);
       int getRemainingBytes();
   };
@@ -1,8 +1,12 @@
 #include "hls_support.h"
+#include "checksum.h"
 #include "langcodes.h" /*LTS*/
+#include "procs.h"
 #include "stream.h"
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
+#include <unistd.h>
 
 namespace HLS{
 
@@ -88,7 +92,7 @@ namespace HLS{
   /// Returns 503 if time spent in BPR > 3x Target Duration
   uint32_t blockPlaylistReload(const DTSC::Meta &M, const std::map<size_t, Comms::Users> &userSelect, const TrackData &trackData,
                                const HlsSpecData &hlsSpecData, const DTSC::Fragments &fragments,
-                               const DTSC::Keys &keys){
+                               const DTSC::Keys &keys, uint64_t *bprEnd){
     // Return if forced noLLHLS
     if (trackData.noLLHLS){return 0;}
 
@@ -112,6 +116,8 @@ namespace HLS{
         hlsPartNr = 1;
       }
 
+      // Read the generation before the live edge, so no update can slip in between
+      uint32_t generation = M.getUpdateGeneration();
       uint64_t lastFragmentDur = getLastFragDur(M, userSelect, trackData, hlsMsnNr, fragments, keys);
       std::ldiv_t res = std::ldiv(lastFragmentDur, partDurationMaxMs);
       DEBUG_MSG(5, "req MSN %" PRIu64 " fin MSN %zu, req Part %" PRIu64 " fin Part %ld", hlsMsnNr,
@@ -124,11 +130,23 @@ namespace HLS{
                              std::max(M.getMinKeepAway(trackData.timingTrackId),
                                       M.getMinKeepAway(trackData.requestTrackId));
 
+      // With a deadline pointer, never block: the caller keeps the deadline across calls and
+      // retries the request for as long as bprPending is returned.
+      if (bprEnd){
+        if (!*bprEnd){*bprEnd = Util::bootMS() + std::max(bprTimeLimit, (int64_t)0);}
+        if (hlsPartNr <= res.quot){return 0;}
+        return (Util::bootMS() >= *bprEnd) ? 503 : bprPending;
+      }
+
+      uint64_t bprEnd = Util::bootMS() + std::max(bprTimeLimit, (int64_t)0);
       while (hlsPartNr > res.quot){
-        if (bprTimeLimit < 1){return 503;}
+        uint64_t now = Util::bootMS();
+        if (now >= bprEnd){return 503;}
         DEBUG_MSG(5, "Part Block: req %" PRIu64 " fin %ld", hlsPartNr, res.quot);
-        Util::wait(partDurationMaxMs - res.rem + 25);
-        bprTimeLimit -= (partDurationMaxMs - res.rem + 25);
+        // Wake up as soon as the buffer adds a packet. The timeout covers the case where only
+        // the jitter-limited live edge moves, which happens with time instead of new data.
+        M.waitForUpdate(generation, std::min(bprEnd - now, (uint64_t)(partDurationMaxMs - res.rem)));
+        generation = M.getUpdateGeneration();
         lastFragmentDur = getLastFragDur(M, userSelect, trackData, hlsMsnNr, fragments, keys);
         res = std::ldiv(lastFragmentDur, partDurationMaxMs);
       }
@@ -749,22 +767,44 @@ namespace HLS{
     }
   }
 
+  /// Non-blocking counterpart of the wait in getPartTargetTime.
+  /// Returns true once the data for the given part is available, or once waitEnd has passed.
+  /// A waitEnd of 0 is set to the deadline getPartTargetTime would use; keep it between calls.
+  bool partReady(const DTSC::Meta &M, const uint32_t idx, const uint32_t mTrack,
+                 const uint64_t startTime, const uint32_t part, uint64_t &waitEnd){
+    // Same estimate and margin as getPartTargetTime
+    const uint64_t calcTargetTime = startTime + (part + 1) * partDurationMaxMs + 50;
+    uint64_t lastms = std::min(M.getLastms(mTrack), M.getLastms(idx));
+    if (calcTargetTime <= lastms){return true;}
+    uint64_t now = Util::bootMS();
+    if (!waitEnd){waitEnd = now + (calcTargetTime - lastms) + 3 * partDurationMaxMs;}
+    return now >= waitEnd;
+  }
+
   /// returns the end time for a given partial fragment
   /// returns 0 for a hinted part which never got created
+  /// Unless wait is false, first waits for the part's data to become available.
   uint64_t getPartTargetTime(const DTSC::Meta &M, const uint32_t idx, const uint32_t mTrack,
-                             const uint64_t startTime, const uint64_t msn, const uint32_t part){
+                             const uint64_t startTime, const uint64_t msn, const uint32_t part,
+                             bool wait){
     DTSC::Fragments fragments(M.fragments(mTrack));
 
     // Estimate the target end time for a given part
     // 50 ms is margin of safety to accommodate inconsistencies
     const uint64_t calcTargetTime = startTime + (part + 1) * partDurationMaxMs + 50;
 
+    uint32_t generation = M.getUpdateGeneration();
     uint64_t lastms = std::min(M.getLastms(mTrack), M.getLastms(idx));
-    uint16_t count = 0;
 
-    // wait until estimated target end time is <= lastms for the track
-    while (calcTargetTime > lastms && count++ < 50){
-      Util::wait(calcTargetTime - lastms);
+    // wait until estimated target end time is <= lastms for the track, waking up on every update
+    // Gives up if the stream stalls for longer than the part hold back
+    uint64_t waitEnd = Util::bootMS() + (calcTargetTime > lastms ? calcTargetTime - lastms : 0) +
+                       3 * partDurationMaxMs;
+    while (wait && calcTargetTime > lastms){
+      uint64_t now = Util::bootMS();
+      if (now >= waitEnd){break;}
+      M.waitForUpdate(generation, waitEnd - now);
+      generation = M.getUpdateGeneration();
       lastms = std::min(M.getLastms(mTrack), M.getLastms(idx));
     }
 
@@ -783,4 +823,503 @@ namespace HLS{
     return partTargetTime;
   }
 
+  /// Header at the start of every shared segment page, followed by the TS data itself
+  struct SegmentHeader{
+    volatile uint8_t state; ///< One of the segState* values below
+    int64_t instance;       ///< Boot offset of the stream instance that produced the segment
+    uint64_t from;          ///< Start time of the segment, as requested
+    uint64_t until;         ///< End time of the segment, as requested
+    uint64_t size;          ///< Bytes of TS data present after the header
+    uint64_t writer;        ///< PID of the process muxing the segment
+  };
+  const size_t segDataOffset = 64;
+  const uint8_t segWriting = 1;
+  const uint8_t segComplete = 2;
+  const uint8_t segFailed = 3;
+
+  /// Entry in the segment index page of a stream.
+  /// Every segment page of a track set lies within [firstFrag, endFrag), so that all of them can be
+  /// found again when they expire or the stream or track goes away.
+  /// Only accessed while holding the SEM_HLS_SEGMENT semaphore of the stream.
+  struct SegmentIndexEntry{
+    char trackKey[HLS_SEGMENT_KEY_LEN]; ///< Empty if the entry is unused
+    uint64_t firstFrag;
+    uint64_t endFrag;
+  };
+
+  /// Opens the segment index page of the given stream, creating it first if create is true.
+  static SegmentIndexEntry *openSegmentIndex(IPC::sharedPage &index, const std::string &streamName, bool create){
+    char pageName[NAME_BUFFER_SIZE];
+    snprintf(pageName, NAME_BUFFER_SIZE, SHM_HLS_SEGMENT_INDEX, streamName.c_str());
+    const size_t indexLen = HLS_SEGMENT_INDEX_ENTRIES * sizeof(SegmentIndexEntry);
+    index.init(pageName, 0, false, false);
+    if (!index.mapped && create){
+      index.init(pageName, indexLen, true, false);
+      // Shared by all outputs of the stream; removed by SegmentCache::wipe
+      index.master = false;
+    }
+    if (!index.mapped || index.len < indexLen){
+      index.close();
+      return 0;
+    }
+    return (SegmentIndexEntry *)index.mapped;
+  }
+
+  /// Removes the cache pages of the given fragment range of a track set
+  static void removeSegments(const std::string &streamName, const char *trackKey, uint64_t from, uint64_t to){
+    char pageName[NAME_BUFFER_SIZE];
+    for (uint64_t i = from; i < to; ++i){
+      snprintf(pageName, NAME_BUFFER_SIZE, SHM_HLS_SEGMENT, streamName.c_str(), trackKey, (size_t)i);
+      IPC::sharedPage oldPage(pageName, 0, false, false);
+      if (oldPage.mapped){oldPage.master = true;}
+    }
+  }
+
+  /// Returns true if the given track set key contains the given track
+  static bool keyHasTrack(const char *trackKey, size_t track){
+    const char *p = trackKey;
+    while (*p){
+      char *end;
+      if (strtoull(p, &end, 10) == track){return true;}
+      if (*end != '_'){break;}
+      p = end + 1;
+    }
+    return false;
+  }
+
+  SegmentCache::SegmentCache(){writing = false;}
+
+  SegmentCache::~SegmentCache(){close();}
+
+  /// Opens the cache page for the given fragment of the given track set.
+  /// Returns WRITE if the calling process should mux the segment and feed it through write(),
+  /// HIT if the complete segment is available through data() and size(),
+  /// or BYPASS if the cache could not be used for this request.
+  /// When another writer is still muxing the segment, waits up to maxWait ms for it.
+  SegmentCache::State SegmentCache::open(const std::string &strmName, const std::set<size_t> &tracks,
+                                         size_t fragNum, uint64_t from, uint64_t until,
+                                         int64_t instance, uint64_t maxWait){
+    close();
+    streamName = strmName;
+    std::stringstream tKey;
+    for (std::set<size_t>::const_iterator it = tracks.begin(); it != tracks.end(); ++it){
+      if (it != tracks.begin()){tKey << "_";}
+      tKey << *it;
+    }
+    trackKey = tKey.str();
+    if (trackKey.size() >= HLS_SEGMENT_KEY_LEN){return BYPASS;}
+
+    char pageName[NAME_BUFFER_SIZE];
+    snprintf(pageName, NAME_BUFFER_SIZE, SHM_HLS_SEGMENT, streamName.c_str(), trackKey.c_str(), fragNum);
+    char semName[NAME_BUFFER_SIZE];
+    snprintf(semName, NAME_BUFFER_SIZE, SEM_HLS_SEGMENT, streamName.c_str());
+    IPC::semaphore segLock(semName, O_CREAT | O_RDWR, ACCESSPERMS, 1);
+    if (!segLock){
+      WARN_MSG("Could not open HLS segment cache semaphore for %s", streamName.c_str());
+      return BYPASS;
+    }
+
+    segLock.wait();
+    page.init(pageName, 0, false, false);
+    SegmentHeader *hdr = (SegmentHeader *)page.mapped;
+    // Pages left behind by a previous instance of this stream get overwritten
+    if (hdr && page.len > segDataOffset && hdr->instance != instance && hdr->state != segWriting){
+      page.close();
+      hdr = 0;
+    }
+    if (!hdr || page.len <= segDataOffset){
+      // Record the page in the index first, so it can always be found again for removal
+      IPC::sharedPage index;
+      SegmentIndexEntry *entries = openSegmentIndex(index, streamName, true);
+      SegmentIndexEntry *entry = 0;
+      for (size_t i = 0; entries && i < HLS_SEGMENT_INDEX_ENTRIES; ++i){
+        if (!strcmp(entries[i].trackKey, trackKey.c_str())){
+          entry = entries + i;
+          break;
+        }
+        if (!entry && !entries[i].trackKey[0]){entry = entries + i;}
+      }
+      if (!entry){
+        segLock.post();
+        WARN_MSG("HLS segment index for %s is full; not caching %s", streamName.c_str(), trackKey.c_str());
+        return BYPASS;
+      }
+      if (!entry->trackKey[0]){
+        strcpy(entry->trackKey, trackKey.c_str());
+        entry->firstFrag = fragNum;
+        entry->endFrag = fragNum + 1;
+      }else{
+        if (fragNum < entry->firstFrag){entry->firstFrag = fragNum;}
+        if (fragNum >= entry->endFrag){entry->endFrag = fragNum + 1;}
+      }
+      page.init(pageName, SHM_HLS_SEGMENT_LEN, true, false);
+      if (!page.mapped){
+        segLock.post();
+        return BYPASS;
+      }
+      hdr = (SegmentHeader *)page.mapped;
+      hdr->instance = instance;
+      hdr->from = from;
+      hdr->until = until;
+      hdr->size = 0;
+      hdr->writer = getpid();
+      __sync_synchronize();
+      hdr->state = segWriting;
+      // The page must outlive this process; expire() or wipe() removes it once it is no longer valid
+      page.master = false;
+      writing = true;
+      segLock.post();
+      HIGH_MSG("Muxing fragment %zu of %s (%s) into segment cache", fragNum, streamName.c_str(), trackKey.c_str());
+      return WRITE;
+    }
+    segLock.post();
+
+    uint64_t waitUntil = Util::bootMS() + maxWait;
+    while (hdr->state != segComplete){
+      if (hdr->state == segFailed || Util::bootMS() >= waitUntil){
+        page.close();
+        return BYPASS;
+      }
+      if (hdr->writer && !Util::Procs::isRunning(hdr->writer)){
+        // Writer died halfway; remove the page so the next request can try again.
+        // Unlink under the lock, and only if the name still refers to the dead writer's page:
+        // another waiter may already have removed it and a new writer may have taken its place.
+        pid_t deadWriter = hdr->writer;
+        page.close();
+        segLock.wait();
+        page.init(pageName, 0, false, false);
+        hdr = (SegmentHeader *)page.mapped;
+        if (hdr && page.len > segDataOffset && hdr->writer == deadWriter && hdr->state == segWriting){
+          page.master = true;
+        }
+        page.close();
+        segLock.post();
+        return BYPASS;
+      }
+      Util::sleep(10);
+    }
+    __sync_synchronize();
+    if (hdr->from != from || hdr->until != until){
+      page.close();
+      return BYPASS;
+    }
+    return HIT;
+  }
+
+  bool SegmentCache::isWriting() const{return writing;}
+
+  /// Appends TS data to the segment being muxed. Gives up on caching if the page overflows.
+  void SegmentCache::write(const char *data, size_t len){
+    if (!writing){return;}
+    SegmentHeader *hdr = (SegmentHeader *)page.mapped;
+    if (segDataOffset + hdr->size + len > page.len){
+      WARN_MSG("Segment for %s (%s) does not fit the segment cache; not caching it",
+               streamName.c_str(), trackKey.c_str());
+      close();
+      return;
+    }
+    memcpy(page.mapped + segDataOffset + hdr->size, data, len);
+    hdr->size += len;
+  }
+
+  /// Marks the segment being muxed as complete, making it available to other viewers.
+  /// Also removes cache pages for fragments that are no longer valid.
+  void SegmentCache::finish(const DTSC::Fragments &fragments){
+    if (!writing){return;}
+    SegmentHeader *hdr = (SegmentHeader *)page.mapped;
+    __sync_synchronize();
+    hdr->state = segComplete;
+    writing = false;
+    expire(fragments.getFirstValid());
+  }
+
+  /// Stops using the current page. A partially written segment is marked failed and removed.
+  void SegmentCache::close(){
+    if (writing && page.mapped){
+      ((SegmentHeader *)page.mapped)->state = segFailed;
+      page.master = true;
+    }
+    writing = false;
+    page.close();
+  }
+
+  const char *SegmentCache::data() const{
+    if (!page.mapped){return 0;}
+    return page.mapped + segDataOffset;
+  }
+
+  size_t SegmentCache::size() const{
+    if (!page.mapped){return 0;}
+    return ((SegmentHeader *)page.mapped)->size;
+  }
+
+  /// Removes cache pages for all fragments of the current track set before the first valid fragment
+  void SegmentCache::expire(size_t firstValid){
+    char semName[NAME_BUFFER_SIZE];
+    snprintf(semName, NAME_BUFFER_SIZE, SEM_HLS_SEGMENT, streamName.c_str());
+    IPC::semaphore segLock(semName, O_CREAT | O_RDWR, ACCESSPERMS, 1);
+    if (!segLock){return;}
+    segLock.wait();
+    IPC::sharedPage index;
+    SegmentIndexEntry *entries = openSegmentIndex(index, streamName, false);
+    for (size_t i = 0; entries && i < HLS_SEGMENT_INDEX_ENTRIES; ++i){
+      if (strcmp(entries[i].trackKey, trackKey.c_str())){continue;}
+      if (entries[i].firstFrag < firstValid){
+        removeSegments(streamName, entries[i].trackKey, entries[i].firstFrag, std::min((uint64_t)firstValid, entries[i].endFrag));
+        entries[i].firstFrag = std::min((uint64_t)firstValid, entries[i].endFrag);
+      }
+      break;
+    }
+    segLock.post();
+  }
+
+  /// Removes all segment cache pages of the given stream, as well as its segment index.
+  /// Called when the stream shuts down; also used for cleaning up after crashes, so it does not
+  /// wait for a semaphore a dead process may still hold.
+  void SegmentCache::wipe(const std::string &streamName){
+    char semName[NAME_BUFFER_SIZE];
+    snprintf(semName, NAME_BUFFER_SIZE, SEM_HLS_SEGMENT, streamName.c_str());
+    IPC::semaphore segLock(semName, O_RDWR, ACCESSPERMS, 0, true);
+    bool locked = segLock && segLock.tryWaitOneSecond();
+    IPC::sharedPage index;
+    SegmentIndexEntry *entries = openSegmentIndex(index, streamName, false);
+    for (size_t i = 0; entries && i < HLS_SEGMENT_INDEX_ENTRIES; ++i){
+      if (!entries[i].trackKey[0]){continue;}
+      removeSegments(streamName, entries[i].trackKey, entries[i].firstFrag, entries[i].endFrag);
+    }
+    if (entries){index.master = true;}
+    index.close();
+    if (locked){segLock.post();}
+  }
+
+  /// Removes all segment cache pages of track sets containing the given track.
+  /// Called when the track is removed from the stream, as its index may be reused later.
+  void SegmentCache::wipeTrack(const std::string &streamName, size_t track){
+    char semName[NAME_BUFFER_SIZE];
+    snprintf(semName, NAME_BUFFER_SIZE, SEM_HLS_SEGMENT, streamName.c_str());
+    IPC::semaphore segLock(semName, O_RDWR, ACCESSPERMS, 0, true);
+    if (!segLock){return;}
+    segLock.wait();
+    IPC::sharedPage index;
+    SegmentIndexEntry *entries = openSegmentIndex(index, streamName, false);
+    for (size_t i = 0; entries && i < HLS_SEGMENT_INDEX_ENTRIES; ++i){
+      if (!entries[i].trackKey[0] || !keyHasTrack(entries[i].trackKey, track)){continue;}
+      removeSegments(streamName, entries[i].trackKey, entries[i].firstFrag, entries[i].endFrag);
+      memset(entries + i, 0, sizeof(SegmentIndexEntry));
+    }
+    segLock.post();
+  }
+
+  /// Header at the start of every playlist slot in the shared manifest page, followed by the
+  /// playlist itself. Readers copy the playlist out and retry if seq changed meanwhile.
+  struct ManifestSlot{
+    volatile uint32_t seq;       ///< Odd while the slot is being rewritten
+    volatile uint32_t generator; ///< PID of the process generating a new playlist, 0 if none; see manifestPublishing
+    volatile uint64_t claimTime; ///< Util::bootMS() at which generator claimed the slot
+    volatile uint64_t lastUsed;  ///< Util::bootMS() of the last write or cache hit
+    uint32_t variantLen;
+    uint32_t size;
+    ManifestVersion version;
+    char variant[HLS_MANIFEST_VARIANT_LEN];
+  };
+  const size_t manifestProbes = 4; ///< Slots checked per variant before evicting one
+  /// Set in ManifestSlot::generator, next to the PID, while the generator writes the slot.
+  /// A claim can be taken over once it times out, but not while it is being published.
+  const uint32_t manifestPublishing = 0x80000000u;
+
+  /// Releases the claim of the calling process on a slot, if it still holds it
+  static void releaseSlot(char *slot){
+    __sync_bool_compare_and_swap(&(((ManifestSlot *)slot)->generator), (uint32_t)getpid(), 0);
+  }
+
+  /// Stands in for the session token inside cached playlists
+  const std::string sessionPlaceholder = "\x1B" "tkn" "\x1B";
+
+  ManifestCache::ManifestCache(){claimed = 0;}
+
+  ManifestCache::~ManifestCache(){
+    if (claimed){releaseSlot(claimed);}
+    claimed = 0;
+    page.close();
+  }
+
+  /// Returns the slot holding the given variant, or the slot it should be written to.
+  char *ManifestCache::findSlot(const std::string &variant){
+    uint32_t hash = checksum::crc32c(0, variant.data(), variant.size());
+    char *oldest = 0;
+    uint64_t oldestUse = 0xFFFFFFFFFFFFFFFFull;
+    for (size_t i = 0; i < manifestProbes; ++i){
+      char *slot = page.mapped + ((hash + i) % HLS_MANIFEST_SLOTS) * HLS_MANIFEST_SLOT_LEN;
+      ManifestSlot *s = (ManifestSlot *)slot;
+      if (s->variantLen == variant.size() && !memcmp(s->variant, variant.data(), variant.size())){
+        return slot;
+      }
+      if (s->lastUsed < oldestUse){
+        oldest = slot;
+        oldestUse = s->lastUsed;
+      }
+    }
+    return oldest;
+  }
+
+  /// Copies the playlist from the given slot if it matches variant and version.
+  bool ManifestCache::readSlot(char *slot, const std::string &variant,
+                               const ManifestVersion &version, std::string &manifest){
+    ManifestSlot *s = (ManifestSlot *)slot;
+    uint32_t seq = s->seq;
+    if (seq & 1){return false;}
+    __sync_synchronize();
+    if (s->variantLen != variant.size() || memcmp(s->variant, variant.data(), variant.size())){
+      return false;
+    }
+    if (memcmp(&(s->version), &version, sizeof(ManifestVersion))){return false;}
+    if (!s->size || s->size > HLS_MANIFEST_SLOT_LEN - sizeof(ManifestSlot)){return false;}
+    manifest.assign(slot + sizeof(ManifestSlot), s->size);
+    __sync_synchronize();
+    if (s->seq != seq){return false;}
+    s->lastUsed = Util::bootMS();
+    return true;
+  }
+
+  /// Looks up the playlist for the given variant and stream state.
+  /// Returns true and fills manifest on a hit. On a miss, the calling process is usually made
+  /// responsible for generating the playlist and must pass it to set() afterwards.
+  /// If another writer is already generating it, waits up to maxWait ms for the result.
+  bool ManifestCache::get(const std::string &strmName, const std::string &variant,
+                          const ManifestVersion &version, std::string &manifest, uint64_t maxWait){
+    if (claimed){
+      releaseSlot(claimed);
+      claimed = 0;
+    }
+    if (variant.size() > HLS_MANIFEST_VARIANT_LEN){return false;}
+    if (!page.mapped || streamName != strmName){
+      page.close();
+      streamName = strmName;
+      char pageName[NAME_BUFFER_SIZE];
+      snprintf(pageName, NAME_BUFFER_SIZE, SHM_HLS_MANIFEST, streamName.c_str());
+      page.init(pageName, 0, false, false);
+      if (!page.mapped){
+        page.init(pageName, HLS_MANIFEST_SLOTS * HLS_MANIFEST_SLOT_LEN, true, false);
+        // Shared by all outputs of the stream; removed by MistUtilNuke
+        page.master = false;
+      }
+      if (!page.mapped || page.len < HLS_MANIFEST_SLOTS * HLS_MANIFEST_SLOT_LEN){
+        page.close();
+        return false;
+      }
+    }
+
+    char *slot = findSlot(variant);
+    if (readSlot(slot, variant, version, manifest)){return true;}
+    ManifestSlot *s = (ManifestSlot *)slot;
+    uint32_t myPid = getpid();
+    uint64_t waitUntil = Util::bootMS() + maxWait;
+    while (true){
+      uint32_t gen = s->generator;
+      pid_t genPid = gen & ~manifestPublishing;
+      // A stalled generator loses its claim, unless it is already writing the slot
+      if (!gen || !Util::Procs::isRunning(genPid) ||
+          (!(gen & manifestPublishing) && Util::bootMS() > s->claimTime + HLS_MANIFEST_WAIT)){
+        if (__sync_bool_compare_and_swap(&(s->generator), gen, myPid)){
+          s->claimTime = Util::bootMS();
+          claimed = slot;
+          claimVariant = variant;
+          claimVersion = version;
+          return false;
+        }
+      }
+      if (Util::bootMS() >= waitUntil){return false;}
+      Util::sleep(5);
+      if (readSlot(slot, variant, version, manifest)){return true;}
+    }
+  }
+
+  /// Stores the playlist generated after a get() call that missed.
+  /// Does nothing if the calling process was not made responsible for generating it.
+  void ManifestCache::set(const std::string &manifest){
+    if (!claimed){return;}
+    ManifestSlot *s = (ManifestSlot *)claimed;
+    claimed = 0;
+    if (sizeof(ManifestSlot) + manifest.size() > HLS_MANIFEST_SLOT_LEN){
+      HIGH_MSG("Playlist of %zu bytes for %s does not fit the manifest cache", manifest.size(),
+               streamName.c_str());
+      releaseSlot((char *)s);
+      return;
+    }
+    // Atomically check the claim is still ours and stop others from taking it over while writing
+    uint32_t myPid = getpid();
+    if (!__sync_bool_compare_and_swap(&(s->generator), myPid, myPid | manifestPublishing)){return;}
+    // Only the publishing process writes; an odd seq means a previous writer died halfway
+    uint32_t seq = s->seq & ~1u;
+    s->seq = seq + 1;
+    __sync_synchronize();
+    memcpy(s->variant, claimVariant.data(), claimVariant.size());
+    s->variantLen = claimVariant.size();
+    s->version = claimVersion;
+    memcpy(((char *)s) + sizeof(ManifestSlot), manifest.data(), manifest.size());
+    s->size = manifest.size();
+    s->lastUsed = Util::bootMS();
+    __sync_synchronize();
+    s->seq = seq + 2;
+    __sync_bool_compare_and_swap(&(s->generator), myPid | manifestPublishing, 0);
+  }
+
+  /// Replaces all occurences of sessionPlaceholder in a cached playlist by the session token
+  void fillSession(std::string &manifest, const std::string &sessId){
+    size_t pos = manifest.find(sessionPlaceholder);
+    while (pos != std::string::npos){
+      manifest.replace(pos, sessionPlaceholder.size(), sessId);
+      pos = manifest.find(sessionPlaceholder, pos + sessId.size());
+    }
+  }
+
+  /// Returns the cache variant key of a media playlist
+  std::string mediaManifestVariant(const TrackData &trackData, const HlsSpecData &hlsSpecData){
+    std::stringstream v;
+    v << "media:" << trackData.requestTrackId << "/" << trackData.timingTrackId << trackData.mediaFormat;
+    if (trackData.noLLHLS){v << ":nollhls";}
+    if (trackData.sessionId.size()){v << ":tkn";}
+    v << ":" << calcManifestVersion(hlsSpecData.hlsSkip) << ":" << trackData.listLimit << ":"
+      << trackData.encryptMethod << ":" << trackData.urlPrefix;
+    return v.str();
+  }
+
+  /// Returns the stream state a media playlist depends on, as filled by populateFragmentData
+  ManifestVersion mediaManifestVersion(const FragmentData &fragData, const TrackData &trackData,
+                                       const DTSC::Fragments &fragments, const DTSC::Keys &keys){
+    ManifestVersion version ={fragData.currentFrag, fragData.lastFrag, 0,
+                              trackData.targetDurationMax,
+                              (int64_t)trackData.systemBoot + trackData.bootMsOffset};
+    // Partial fragments of the live edge fragment grow in between fragment boundaries
+    if (trackData.isLive && !trackData.noLLHLS && fragData.lastFrag > fragData.firstFrag){
+      uint64_t edgeStart = keys.getTime(fragments.getFirstKey(fragData.lastFrag - 1));
+      if (fragData.lastMs > edgeStart){
+        version.partNum = (fragData.lastMs - edgeStart) / partDurationMaxMs + 1;
+      }
+    }
+    return version;
+  }
+
+  /// Returns the cache variant key of a master playlist
+  std::string masterManifestVariant(const std::map<size_t, Comms::Users> &userSelect,
+                                    const MasterData &masterData){
+    std::stringstream v;
+    v << "master:" << masterData.mainTrack << (masterData.isTS ? ".ts" : ".m4s");
+    if (masterData.noLLHLS){v << ":nollhls";}
+    if (masterData.sessId.size()){v << ":tkn";}
+    v << ":" << getLiveLengthLimit(masterData);
+    for (std::map<size_t, Comms::Users>::const_iterator it = userSelect.begin(); it != userSelect.end(); ++it){
+      v << ":" << it->first;
+    }
+    return v.str();
+  }
+
+  /// Returns the stream state a master playlist depends on
+  ManifestVersion masterManifestVersion(const DTSC::Meta &M, const MasterData &masterData){
+    DTSC::Fragments fragments(M.fragments(masterData.mainTrack));
+    ManifestVersion version ={getInitFragment(M, masterData), fragments.getEndValid(), 0, 0,
+                              (int64_t)masterData.systemBoot + masterData.bootMsOffset};
+    return version;
+  }
+
 }// namespace HLS
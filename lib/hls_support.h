@@ -1,10 +1,14 @@
+#pragma once
 #include "comms.h"
 #include "dtsc.h"
+#include "shared_memory.h"
 #include <cmath>
+#include <set>
 
 namespace HLS{
   // TODO: Implement logic to detect ideal partial fragment size
   const uint32_t partDurationMaxMs = 500; ///< max partial fragment duration in ms
+  const uint32_t bprPending = 102; ///< blockPlaylistReload result: not ready yet, call again later
 
   /// A struct containing data regarding fragments in a particular track
   /// needed for media manifest generation
@@ -57,7 +61,7 @@ namespace HLS{
 
   uint32_t blockPlaylistReload(const DTSC::Meta &M, const std::map<size_t, Comms::Users> &userSelect, const TrackData &trackData,
                                const HlsSpecData &hlsSpecData, const DTSC::Fragments &fragments,
-                               const DTSC::Keys &keys);
+                               const DTSC::Keys &keys, uint64_t *bprEnd = 0);
 
   void populateFragmentData(const DTSC::Meta &M, const std::map<size_t, Comms::Users> &userSelect, FragmentData &fragData, const TrackData &trackData,
                             const DTSC::Fragments &fragments, const DTSC::Keys &keys);
@@ -79,6 +83,86 @@ namespace HLS{
                          const std::map<size_t, Comms::Users> &userSelect,
                          const MasterData &masterData);
 
+  /// Shared memory cache of pre-muxed TS segments.
+  /// The first viewer requesting a fragment muxes it into a shared page, all other viewers of the
+  /// same stream and track selection copy the finished bytes from there.
+  /// Pages are keyed by stream name, selected track set and fragment number.
+  class SegmentCache{
+  public:
+    enum State{
+      BYPASS, ///< Cache not usable for this request; mux without caching
+      WRITE,  ///< This process muxes the segment and fills the cache
+      HIT     ///< The segment is complete and can be sent from the cache
+    };
+    SegmentCache();
+    ~SegmentCache();
+    State open(const std::string &streamName, const std::set<size_t> &tracks, size_t fragNum,
+               uint64_t from, uint64_t until, int64_t instance, uint64_t maxWait = HLS_SEGMENT_WAIT);
+    bool isWriting() const;
+    void write(const char *data, size_t len);
+    void finish(const DTSC::Fragments &fragments);
+    void close();
+    const char *data() const;
+    size_t size() const;
+    static void wipe(const std::string &streamName);
+    static void wipeTrack(const std::string &streamName, size_t track);
+
+  private:
+    void expire(size_t firstValid);
+    IPC::sharedPage page;
+    std::string streamName;
+    std::string trackKey;
+    bool writing;
+  };
+
+  /// Identifies the stream state a playlist was generated from.
+  /// A cached playlist stays valid for as long as all fields equal those of the current state.
+  struct ManifestVersion{
+    uint64_t firstFrag;      ///< First fragment listed
+    uint64_t lastFrag;       ///< End of the listed fragments
+    uint64_t partNum;        ///< Partial fragments available in the live edge fragment, 0 if unused
+    uint64_t targetDuration; ///< Target duration in ms
+    int64_t instance;        ///< Stream instance, changes when the stream restarts
+  };
+
+  /// Shared memory cache of generated playlists.
+  /// All output processes of a stream share one page, divided in slots holding one playlist
+  /// variant each. A variant is anything that changes the playlist besides the stream state:
+  /// the requested track(s), URL prefix, LL-HLS flags and so on.
+  /// Session tokens are not part of the variant; playlists are cached with sessionPlaceholder in
+  /// their place, and fillSession() puts the real token in before sending.
+  class ManifestCache{
+  public:
+    ManifestCache();
+    ~ManifestCache();
+    bool get(const std::string &streamName, const std::string &variant,
+             const ManifestVersion &version, std::string &manifest,
+             uint64_t maxWait = HLS_MANIFEST_WAIT);
+    void set(const std::string &manifest);
+
+  private:
+    char *findSlot(const std::string &variant);
+    bool readSlot(char *slot, const std::string &variant, const ManifestVersion &version,
+                  std::string &manifest);
+    IPC::sharedPage page;
+    std::string streamName;
+    std::string claimVariant;   ///< Variant this process is expected to set()
+    ManifestVersion claimVersion;
+    char *claimed;              ///< Slot claimed for generation, if any
+  };
+
+  extern const std::string sessionPlaceholder;
+  void fillSession(std::string &manifest, const std::string &sessId);
+  std::string mediaManifestVariant(const TrackData &trackData, const HlsSpecData &hlsSpecData);
+  ManifestVersion mediaManifestVersion(const FragmentData &fragData, const TrackData &trackData,
+                                       const DTSC::Fragments &fragments, const DTSC::Keys &keys);
+  std::string masterManifestVariant(const std::map<size_t, Comms::Users> &userSelect,
+                                    const MasterData &masterData);
+  ManifestVersion masterManifestVersion(const DTSC::Meta &M, const MasterData &masterData);
+
+  bool partReady(const DTSC::Meta &M, const uint32_t idx, const uint32_t mTrack,
+                 const uint64_t startTime, const uint32_t part, uint64_t &waitEnd);
   uint64_t getPartTargetTime(const DTSC::Meta &M, const uint32_t idx, const uint32_t mTrack,
-                             const uint64_t startTime, const uint64_t msn, const uint32_t part);
+                             const uint64_t startTime, const uint64_t msn, const uint32_t part,
+                             bool wait = true);
 }// namespace HLS
@@ -837,11 +837,15 @@ void HTTP::Parser::Chunkify(const char *data, unsigned int size, Socket::Connect
       len[--offset] = hexa[t_size & 0xf];
       t_size >>= 4;
     }
-    conn.SendNow(len + offset, 10 - offset);
-    // send the chunk itself
-    conn.SendNow(data, size);
-    // append \r\n
-    conn.SendNow("\r\n", 2);
+    // send chunk size, the chunk itself and the trailing \r\n in a single write
+    struct iovec chunk[3];
+    chunk[0].iov_base = len + offset;
+    chunk[0].iov_len = 10 - offset;
+    chunk[1].iov_base = (void *)data;
+    chunk[1].iov_len = size;
+    chunk[2].iov_base = (void *)"\r\n";
+    chunk[2].iov_len = 2;
+    conn.SendNow(chunk, 3);
   }else{
     // just send the chunk itself
     conn.SendNow(data, size);
@@ -8,6 +8,10 @@
 #include "sdp.h"
 #include "timing.h"
 #include "g711_to_aac.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RTP_X86 1
+#endif
 #include <arpa/inet.h>
 
 namespace RTP{
@@ -68,8 +72,8 @@ namespace RTP{
     if (rows < 4 || rows > 20){
       ERROR_MSG("Rows should have a value between 4-20");
       return false;
-    } else if (columns < 1 || columns > 20){
-      ERROR_MSG("Columns should have a value between 1-20");
+    } else if (columns < 1 || columns > RTP_FEC_MAX_COLUMNS){
+      ERROR_MSG("Columns should have a value between 1-%d", RTP_FEC_MAX_COLUMNS);
       return false;
     } else if (rows * columns > 100){
       ERROR_MSG("The product of rows * columns cannot exceed 100");
@@ -94,10 +98,19 @@ namespace RTP{
     fecContext.rtpBufSize = fecContext.lengthRecovery + 28;
     // Add room for P, X, CC, M, PT, SN, TS fields
     fecContext.bitstringSize = fecContext.lengthRecovery + 8;
-    fecContext.fecBufferRows.bitstring = 0;
-    fecContext.fecBufferColumns.clear();
     fecContext.columnSN = 0;
     fecContext.rowSN = 0;
+    // One block holds the row, every column, the incoming packet and the outgoing FEC packet.
+    // Each starts on a 32-byte boundary, so the XOR kernels never split a load over two cache lines.
+    size_t stride = (std::max(fecContext.pktSize, fecContext.rtpBufSize) + 31) & ~(size_t)31;
+    fecContext.buffers.allocate(stride * (fecContext.columns + 3) + 31);
+    uint8_t *base = (uint8_t *)(((uintptr_t)(char *)fecContext.buffers + 31) & ~(uintptr_t)31);
+    fecContext.fecBufferRows.bitstring = base;
+    for (uint8_t i = 0; i < fecContext.columns; ++i){
+      fecContext.fecBufferColumns[i].bitstring = base + stride * (i + 1);
+    }
+    fecContext.scratch = base + stride * (fecContext.columns + 1);
+    fecContext.rtpBuf = base + stride * (fecContext.columns + 2);
   }
 
   /// \brief Takes an RTP packet containing TS packets and returns the modified payload
@@ -116,11 +129,91 @@ namespace RTP{
     memcpy(bitstring + 8, payload, fecContext.lengthRecovery);
   }
 
-  void Packet::applyXOR(const uint8_t *in1, const uint8_t *in2, uint8_t *out, uint64_t size){
-    uint64_t index = 0;
-    for (index = 0; index < size; index++) {
-      out[index] = in1[index] ^ in2[index];
+  static void xorScalar(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size){
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8){
+      uint64_t a, b;
+      memcpy(&a, in1 + i, 8);
+      memcpy(&b, in2 + i, 8);
+      a ^= b;
+      memcpy(out + i, &a, 8);
     }
+    for (; i < size; ++i){out[i] = in1[i] ^ in2[i];}
+  }
+
+#ifdef __SSE2__
+  static void xorSSE2(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size){
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16){
+      __m128i a = _mm_loadu_si128((const __m128i *)(in1 + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(in2 + i));
+      _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(a, b));
+    }
+    xorScalar(in1 + i, in2 + i, out + i, size - i);
+  }
+#endif
+
+#ifdef RTP_X86
+  __attribute__((target("avx2"))) static void xorAVX2(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size){
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32){
+      __m256i a = _mm256_loadu_si256((const __m256i *)(in1 + i));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(in2 + i));
+      _mm256_storeu_si256((__m256i *)(out + i), _mm256_xor_si256(a, b));
+    }
+    xorScalar(in1 + i, in2 + i, out + i, size - i);
+  }
+#endif
+
+  typedef void (*xorFunc)(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size);
+
+  /// Returns the widest XOR kernel the running CPU supports
+  static xorFunc pickXOR(){
+#ifdef RTP_X86
+    if (__builtin_cpu_supports("avx2")){return xorAVX2;}
+#endif
+#ifdef __SSE2__
+    return xorSSE2;
+#else
+    return xorScalar;
+#endif
+  }
+
+  /// The XOR kernel in use, picked for the running CPU on first use
+  static xorFunc &xorKernel(){
+    static xorFunc kernel = pickXOR();
+    return kernel;
+  }
+
+  /// Forces the named XOR kernel ("AVX2", "SSE2" or "scalar"), for benchmarking.
+  /// Returns false, leaving the current kernel in place, if this build or CPU cannot run it.
+  bool setXORKernel(const std::string &name){
+    if (name == "scalar"){
+      xorKernel() = xorScalar;
+      return true;
+    }
+#ifdef __SSE2__
+    if (name == "SSE2"){
+      xorKernel() = xorSSE2;
+      return true;
+    }
+#endif
+#ifdef RTP_X86
+    if (name == "AVX2" && __builtin_cpu_supports("avx2")){
+      xorKernel() = xorAVX2;
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  /// Sets out to in1 XOR in2, size bytes long. out may be the same buffer as either input.
+  void xorBuffer(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size){
+    xorKernel()(in1, in2, out, size);
+  }
+
+  void Packet::applyXOR(const uint8_t *in1, const uint8_t *in2, uint8_t *out, uint64_t size){
+    xorBuffer(in1, in2, out, size);
   }
 
   /// \brief Sends buffered FEC packets
@@ -129,9 +222,9 @@ namespace RTP{
   /// \param isColumn whether the buf we want to send represents a completed column or row
   void Packet::sendFec(void *socket, FecData *fecData, bool isColumn){
     uint8_t *data = fecData->bitstring;
-    // Create zero filled buffer
-    uint8_t *rtpBuf = (uint8_t *)malloc(fecContext.rtpBufSize);
-    memset(rtpBuf, 0, fecContext.rtpBufSize);
+    // Zero the FEC packet buffer
+    uint8_t *rtpBuf = fecContext.rtpBuf;
+    memset(rtpBuf, 0, 28);
     uint16_t thisSN = isColumn ? ++fecContext.columnSN : ++fecContext.rowSN;
 
     // V, P, X, CC
@@ -175,15 +268,16 @@ namespace RTP{
     ((Socket::UDPConnection *)socket)->SendNow(reinterpret_cast<char*>(rtpBuf), fecContext.rtpBufSize);
     sentPackets++;
     sentBytes += fecContext.rtpBufSize;
-    free(rtpBuf);
   }
 
   /// \brief Parses new RTP packets
-  void Packet::parseFEC(void *columnSocket, void *rowSocket, uint64_t & bytesSent, const char *payload, unsigned int payloadlen){
+  /// If the media packets are queued on mediaSocket, that queue is sent out before any FEC packet,
+  /// so FEC never reaches the receiver ahead of the packets it protects.
+  void Packet::parseFEC(void *columnSocket, void *rowSocket, uint64_t & bytesSent, const char *payload, unsigned int payloadlen,
+                        void *mediaSocket){
     if (!fecEnabled){
       return;
     }
-    uint8_t *bitstring;
     uint8_t thisColumn;
     uint8_t thisRow;
     // Check to see if we need to reinit FEC data
@@ -197,7 +291,7 @@ namespace RTP{
       return;
     }
     // Create bitstring
-    bitstring = (uint8_t *)malloc(fecContext.pktSize);
+    uint8_t *bitstring = fecContext.scratch;
     generateBitstring(payload, payloadlen, bitstring);
 
     thisColumn = fecContext.index % fecContext.columns;
@@ -211,11 +305,11 @@ namespace RTP{
         } else {
           INSANE_MSG("Sending completed FEC packet at row %u", thisRow - 1);
         }
+        if (mediaSocket){((Socket::UDPConnection *)mediaSocket)->sendQueued();}
         sendFec(rowSocket, &fecContext.fecBufferRows, false);
         bytesSent += fecContext.rtpBufSize;
       }
-      free(fecContext.fecBufferRows.bitstring);
-      fecContext.fecBufferRows.bitstring = bitstring;
+      memcpy(fecContext.fecBufferRows.bitstring, bitstring, fecContext.bitstringSize);
       // Set the SN and TS of this first packet in the sequence
       fecContext.fecBufferRows.sequence = getSequence() - 1;
       fecContext.fecBufferRows.timestamp = getTimeStamp();
@@ -225,30 +319,23 @@ namespace RTP{
       applyXOR(fecContext.fecBufferRows.bitstring, bitstring, fecContext.fecBufferRows.bitstring, fecContext.bitstringSize);
     }
     // XOR or set new bitstring
+    FecData &column = fecContext.fecBufferColumns[thisColumn];
     if (thisRow == 0){
-      // Make a copy if we are already using this bitstring for the FEC row
-      if (thisColumn == 0){
-        uint8_t *bitstringCopy;
-        bitstringCopy = (uint8_t *)malloc(fecContext.pktSize);
-        memcpy(bitstringCopy, bitstring, fecContext.pktSize);
-        fecContext.fecBufferColumns[thisColumn].bitstring = bitstringCopy;
-      } else {
-        fecContext.fecBufferColumns[thisColumn].bitstring = bitstring;
-      }
-      fecContext.fecBufferColumns[thisColumn].sequence = getSequence() - 1;
-      fecContext.fecBufferColumns[thisColumn].timestamp = getTimeStamp();
-      // fecContext.fecBufferColumns[thisColumn].timestamp = generateTimeStamp();
+      memcpy(column.bitstring, bitstring, fecContext.bitstringSize);
+      column.sequence = getSequence() - 1;
+      column.timestamp = getTimeStamp();
+      // column.timestamp = generateTimeStamp();
     } else {
       // This is an intermediate packet, apply XOR operation and continue
-      applyXOR(fecContext.fecBufferColumns[thisColumn].bitstring, bitstring, fecContext.fecBufferColumns[thisColumn].bitstring, fecContext.bitstringSize);
+      applyXOR(column.bitstring, bitstring, column.bitstring, fecContext.bitstringSize);
     }
 
     // Check for completed columns of data
     if (thisRow == fecContext.rows - 1){
       INSANE_MSG("Sending completed FEC packet at column %u", thisColumn);
-      sendFec(columnSocket, &fecContext.fecBufferColumns[thisColumn], true);
+      if (mediaSocket){((Socket::UDPConnection *)mediaSocket)->sendQueued();}
+      sendFec(columnSocket, &column, true);
       bytesSent += fecContext.rtpBufSize;
-      free(fecContext.fecBufferColumns[thisColumn].bitstring);
     }
 
     // Update variables
@@ -273,8 +360,8 @@ namespace RTP{
     INSANE_MSG("Sending RTP packet with header size %u and payload size %u", getHsize(), payloadlen);
     // Set timestamp to current time
     setTimestamp(Util::bootMS()*90);
-    // Send RTP packet itself
-    ((Socket::UDPConnection *)socket)->SendNow(data, getHsize() + payloadlen);
+    // Queue RTP packet itself; the caller sends the queue through sendQueued
+    ((Socket::UDPConnection *)socket)->queueSend(data, getHsize() + payloadlen);
     // Increment counters
     sentPackets++;
     sentBytes += payloadlen + getHsize();
@@ -453,7 +540,12 @@ namespace RTP{
 
   void Packet::sendData(void *socket, void callBack(void *, const char *, size_t, uint8_t), const char *payload,
                         unsigned int payloadlen, unsigned int channel, std::string codec){
-    if (codec == "H264"){
+    sendData(socket, callBack, payload, payloadlen, channel, DTSC::codecFromString(codec));
+  }
+
+  void Packet::sendData(void *socket, void callBack(void *, const char *, size_t, uint8_t), const char *payload,
+                        unsigned int payloadlen, unsigned int channel, DTSC::codecType codec){
+    if (codec == DTSC::CODEC_H264){
       unsigned long sent = 0;
       const char * lastPtr = 0;
       size_t lastLen = 0;
@@ -473,15 +565,15 @@ namespace RTP{
       if (lastPtr){sendH264(socket, callBack, lastPtr, lastLen, channel, true);}
       return;
     }
-    if (codec == "VP8"){
+    if (codec == DTSC::CODEC_VP8){
       sendVP8(socket, callBack, payload, payloadlen, channel);
       return;
     }
-    if (codec == "VP9"){
+    if (codec == DTSC::CODEC_VP9){
       sendVP8(socket, callBack, payload, payloadlen, channel);
       return;
     }
-    if (codec == "HEVC"){
+    if (codec == DTSC::CODEC_HEVC){
       unsigned long sent = 0;
       while (sent < payloadlen){
         unsigned long nalSize = ntohl(*((unsigned long *)(payload + sent)));
@@ -490,22 +582,22 @@ namespace RTP{
       }
       return;
     }
-    if (codec == "MPEG2"){
+    if (codec == DTSC::CODEC_MPEG2){
       sendMPEG2(socket, callBack, payload, payloadlen, channel);
       return;
     }
     /// \todo This function probably belongs in DMS somewhere.
     data[1] |= 0x80; // setting the RTP marker bit to 1
     size_t offsetLen = 0;
-    if (codec == "AAC"){
+    if (codec == DTSC::CODEC_AAC){
       Bit::htobl(data + getHsize(), ((payloadlen << 3) & 0x0010fff8) | 0x00100000);
       offsetLen = 4;
-    }else if (codec == "MP3" || codec == "MP2"){
+    }else if (codec == DTSC::CODEC_MP3 || codec == DTSC::CODEC_MP2){
       // See RFC 2250, "MPEG Audio-specific header"
       Bit::htobl(data + getHsize(), 0); // this is MBZ and Frag_Offset, which are always 0
       if (payload[0] != 0xFF){FAIL_MSG("MP2/MP3 data does not start with header?");}
       offsetLen = 4;
-    }else if (codec == "AC3"){
+    }else if (codec == DTSC::CODEC_AC3){
       Bit::htobs(data + getHsize(),
                  1); // this is 6 bits MBZ, 2 bits FT = 0 = full frames and 8 bits saying we send 1 frame
       offsetLen = 2;
@@ -746,6 +838,9 @@ namespace RTP{
     preBuffer = true;
     lastBootMS = 0;
     lastNTP = 0;
+    slots.resize(RTP_SORTER_SLOTS);
+    buffered = 0;
+    lowestSeq = 0;
   }
 
   void Sorter::setCallback(uint64_t track, void (*cb)(const uint64_t track, const Packet &p)){
@@ -756,9 +851,39 @@ namespace RTP{
   /// Calls addPacket(pack) with a newly constructed RTP::Packet from the given arguments.
   void Sorter::addPacket(const char *dat, unsigned int len){addPacket(RTP::Packet(dat, len));}
 
+  /// Returns true if the packet with the given sequence number is in the reorder buffer.
+  bool Sorter::isBuffered(uint16_t seq) const{
+    const Slot &s = slots[seq & (RTP_SORTER_SLOTS - 1)];
+    return s.used && s.seq == seq;
+  }
+
+  /// Copies the packet into its reorder buffer slot, replacing whatever was there.
+  void Sorter::bufferPacket(const Packet &pack){
+    uint16_t seq = pack.getSequence();
+    Slot &s = slots[seq & (RTP_SORTER_SLOTS - 1)];
+    if (!s.used){
+      ++buffered;
+    }else if (s.seq != seq){
+      VERYHIGH_MSG("Overwriting buffered packet #%u with #%u", s.seq, seq);
+    }
+    if (preBuffer && (buffered == 1 || (int16_t)(seq - lowestSeq) < 0)){lowestSeq = seq;}
+    s.used = true;
+    s.seq = seq;
+    s.data.assign(pack.ptr(), pack.size());
+  }
+
+  /// Outputs the packet for rtpSeq from the reorder buffer and frees its slot.
+  void Sorter::sendBuffered(){
+    Slot &s = slots[rtpSeq & (RTP_SORTER_SLOTS - 1)];
+    s.used = false;
+    --buffered;
+    outPacket(packTrack, Packet(s.data.data(), s.data.size()));
+  }
+
   /// Takes in new RTP packets for a single track.
   /// Automatically sorts them, waiting when packets come in slow or not at all.
   /// Calls the callback with packets in sorted order, whenever it becomes possible to do so.
+  /// Sequence numbers are always compared as signed 16-bit differences, so wraparound needs no special casing.
   void Sorter::addPacket(const Packet &pack){
     uint16_t pSNo = pack.getSequence();
     if (first){
@@ -769,18 +894,25 @@ namespace RTP{
     DONTEVEN_MSG("Received packet #%u, current packet is #%u", pSNo, rtpSeq);
     if (preBuffer){
       //If we've buffered the first 5 packets, assume we have the first one known
-      if (packBuffer.size() >= 5){
+      if (buffered >= 5){
         preBuffer = false;
-        rtpSeq = packBuffer.begin()->first;
+        rtpSeq = lowestSeq;
         rtpWSeq = rtpSeq;
       }
     }else{
       // packet is very early - assume dropped after PACKET_DROP_TIMEOUT packets
-      while ((int16_t)(rtpSeq - pSNo) < -(int)PACKET_DROP_TIMEOUT){
-        VERYHIGH_MSG("Giving up on track %" PRIu64 " packet %u", packTrack, rtpSeq);
+      // The reorder buffer cannot hold more than RTP_SORTER_SLOTS packets, so that is the maximum wait
+      int dropAfter = std::min(PACKET_DROP_TIMEOUT, (unsigned int)RTP_SORTER_SLOTS - 1);
+      while ((int16_t)(rtpSeq - pSNo) < -dropAfter){
+        if (isBuffered(rtpSeq)){
+          // Packets we do have are sent rather than given up on along with the missing ones
+          sendBuffered();
+        }else{
+          VERYHIGH_MSG("Giving up on track %" PRIu64 " packet %u", packTrack, rtpSeq);
+          ++lostTotal;
+          ++lostCurrent;
+        }
         ++rtpSeq;
-        ++lostTotal;
-        ++lostCurrent;
         ++packTotal;
         ++packCurrent;
       }
@@ -790,27 +922,32 @@ namespace RTP{
     // packet is somewhat early - ask for packet after PACKET_REORDER_WAIT packets
     while ((int16_t)(rtpWSeq - pSNo) < -(int)PACKET_REORDER_WAIT){
       //Only wanted if we don't already have it
-      if (!packBuffer.count(rtpWSeq)){
-        wantedSeqs.insert(rtpWSeq);
+      if (!isBuffered(rtpWSeq)){
+        // Nobody may be reading these; keep at most a window's worth
+        if (wantedSeqs.size() >= RTP_SORTER_SLOTS){wantedSeqs.pop_front();}
+        wantedSeqs.push_back(rtpWSeq);
       }
       ++rtpWSeq;
     }
     // send any buffered packets we may have
     uint16_t prertpSeq = rtpSeq;
-    while (packBuffer.count(rtpSeq)){
-      outPacket(packTrack, packBuffer[rtpSeq]);
-      packBuffer.erase(rtpSeq);
+    while (isBuffered(rtpSeq)){
+      sendBuffered();
       ++rtpSeq;
       ++packTotal;
       ++packCurrent;
     }
     if (prertpSeq != rtpSeq){
-      INFO_MSG("Sent packets %" PRIu16 "-%" PRIu16 ", now %zu in buffer", prertpSeq, rtpSeq, packBuffer.size());
+      INFO_MSG("Sent packets %" PRIu16 "-%" PRIu16 ", now %zu in buffer", prertpSeq, rtpSeq, buffered);
     }
-    // packet is slightly early - buffer it
+    // packet is slightly early - buffer it, if it fits in the reorder window
     if ((int16_t)(rtpSeq - pSNo) < 0){
-      VERYHIGH_MSG("Buffering early packet #%u->%u", rtpSeq, pack.getSequence());
-      packBuffer[pack.getSequence()] = pack;
+      if ((uint16_t)(pSNo - rtpSeq) < RTP_SORTER_SLOTS){
+        VERYHIGH_MSG("Buffering early packet #%u->%u", rtpSeq, pSNo);
+        bufferPacket(pack);
+      }else{
+        HIGH_MSG("Packet #%u is too far ahead of #%u to buffer", pSNo, rtpSeq);
+      }
     }
     // packet is late
     if ((int16_t)(rtpSeq - pSNo) > 0){
@@ -836,26 +973,37 @@ namespace RTP{
   toDTSC::toDTSC(){
     cbPack = 0;
     cbInit = 0;
+    cbData = 0;
     multiplier = 1.0;
     trackId = INVALID_TRACK_ID;
+    codecId = DTSC::CODEC_UNKNOWN;
     firstTime = 0;
     packCount = 0;
     lastSeq = 0;
     vp8BufferHasKeyframe = false;
     curPicParameterSetId = 0;
     tracksCount = 0;
+    g711Codec = G711::UNKNOWN;
+    aacTrackId = INVALID_TRACK_ID;
+    aacWorker = 0;
     milliSync = 0;
     prevVideoPktTime = 0;
     prevAudioPktTime = 0;
   }
 
+  toDTSC::~toDTSC(){
+    if (aacWorker){delete aacWorker;}
+  }
+
   void toDTSC::setProperties(const uint64_t track, const std::string &c, const std::string &t,
                              const std::string &i, const double m){
     trackId = track;
     codec = c;
+    codecId = DTSC::codecFromString(codec);
     type = t;
     init = i;
     multiplier = m;
+    g711Codec = G711::getCodec(codec);
     if (codec == "HEVC" && init.size()){
       hevcInfo = h265::initData(init);
       h265::metaInfo MI = hevcInfo.getMeta();
@@ -889,6 +1037,26 @@ namespace RTP{
     cbInit = cbI;
   }
 
+  /// Sets a callback that receives the payload of every output packet directly, instead of as a
+  /// DTSC::Packet. The data is only valid during the call. Set to null to go back to outPacket.
+  void toDTSC::setDataCallback(void (*cbD)(const uint64_t track, const uint64_t time, const int64_t offset,
+                                           const char *data, const size_t len, const bool keyframe)){
+    cbData = cbD;
+  }
+
+  /// Outputs a packet: through the data callback if one is set, so the payload can go straight
+  /// from the reassembly buffer to its destination, or as a DTSC::Packet through outPacket.
+  void toDTSC::outData(const uint64_t track, const uint64_t time, const int64_t offset, const char *data,
+                       const size_t len, const bool keyframe){
+    if (cbData){
+      cbData(track, time, offset, data, len, keyframe);
+      return;
+    }
+    DTSC::Packet nextPack;
+    nextPack.genericFill(time, offset, track, data, len, 0, keyframe);
+    outPacket(nextPack);
+  }
+
   /// Adds an RTP packet to the converter, outputting DTSC packets and/or updating init data,
   /// as-needed.
   void toDTSC::addRTP(const RTP::Packet &pkt, DTSC::Meta *meta, bool audioEncoder){
@@ -906,13 +1074,21 @@ namespace RTP{
     }
 
     // Step 3 - Set the media 'type' given the codec
-    std::string type;
-    if (codec ==  "H264" || codec == "HEVC" || codec == "MPEG2" || codec == "VP8" || codec == "VP9"){
-      type = "video";
-    }else if (codec == "AAC" || codec == "ALAW" || codec == "ULAW" || codec == "PCM" || codec == "MP2" || codec == "MP3" || codec == "opus"){
-      type = "audio";
-    }else{
-      type = "unknown";
+    DTSC::trackType type;
+    switch (codecId){
+    case DTSC::CODEC_H264:
+    case DTSC::CODEC_HEVC:
+    case DTSC::CODEC_MPEG2:
+    case DTSC::CODEC_VP8:
+    case DTSC::CODEC_VP9: type = DTSC::TYPE_VIDEO; break;
+    case DTSC::CODEC_AAC:
+    case DTSC::CODEC_ALAW:
+    case DTSC::CODEC_ULAW:
+    case DTSC::CODEC_PCM:
+    case DTSC::CODEC_MP2:
+    case DTSC::CODEC_MP3:
+    case DTSC::CODEC_OPUS: type = DTSC::TYPE_AUDIO; break;
+    default: type = DTSC::TYPE_UNKNOWN; break;
     }
 
     // Step 4 - Extract RTP packet's timestamp
@@ -928,7 +1104,7 @@ namespace RTP{
      * - Unordered RTP timestamp for video/audio
      * - RTP timestamp rollover for video/audio
     */
-    if (type == "video"){
+    if (type == DTSC::TYPE_VIDEO){
       if (0 != milliSync && pTime < prevVideoPktTime){
         FAIL_MSG("[RTMPServer] received unordered/rollover video timestamp (%u < %u) - exiting", pTime, prevVideoPktTime);
         kill(getpid(), SIGINT);
@@ -936,7 +1112,7 @@ namespace RTP{
       }
       prevVideoPktTime = pTime;
     }
-    if (type == "audio"){
+    if (type == DTSC::TYPE_AUDIO){
       if (0 != milliSync && pTime < prevAudioPktTime){
         FAIL_MSG("[RTMPServer] received unordered/rollover audio timestamp (%u < %u) - exiting", pTime, prevAudioPktTime);
         kill(getpid(), SIGINT);
@@ -1022,80 +1198,105 @@ namespace RTP{
     );
 
     // Step 12 - Do codec specific handling
-    if (type == "video"){
+    if (type == DTSC::TYPE_VIDEO){
       // Step 15/A - Handle supported video codecs
-      if (codec == "H264"){return handleH264(msTime, pl, plSize, missed, false);}
-      if (codec == "HEVC"){return handleHEVC(msTime, pl, plSize, missed, meta);}
-      if (codec == "MPEG2"){return handleMPEG2(msTime, pl, plSize);}
-      if (codec == "VP8"){return handleVP8(msTime, pl, plSize, missed, false);}
-      if (codec == "VP9"){return handleVP8(msTime, pl, plSize, missed, false);}
-    }else if (type == "audio"){
+      switch (codecId){
+      case DTSC::CODEC_H264: return handleH264(msTime, pl, plSize, missed, false);
+      case DTSC::CODEC_HEVC: return handleHEVC(msTime, pl, plSize, missed, meta);
+      case DTSC::CODEC_MPEG2: return handleMPEG2(msTime, pl, plSize);
+      case DTSC::CODEC_VP8:
+      case DTSC::CODEC_VP9: return handleVP8(msTime, pl, plSize, missed, false);
+      default: break;
+      }
+    }else if (type == DTSC::TYPE_AUDIO){
       // Step 15/B/1 - Handle supported audio codecs
-      if (codec == "AAC"){return handleAAC(msTime, pl, plSize);}
-      if (codec == "MP2" || codec == "MP3"){return handleMP2(msTime, pl, plSize);}
-      if (codec == "ALAW" || codec == "opus" || codec == "PCM" || codec == "ULAW"){
-        if (audioEncoder){
-          // Step 15/B/2 - Encode to AAC if needed
-          if (!tracksCount){ tracksCount = meta->getValidTracks().size(); }
-          static size_t aacTrackId = INVALID_TRACK_ID;
-          if (tracksCount != meta->getValidTracks().size()){
-            aacTrackId = INVALID_TRACK_ID;
-            for (uint8_t i = 0; i < meta->trackCount(); ++i){
-              if (meta->getCodec(i) == "AAC"){
-                if (!meta->getMilliSyncMs(i)){
-                  meta->setMilliSyncMs(i, milliSync);
-                }
-                if (!meta->getFirstRtpMs(i)){
-                  meta->setFirstRtpMs(i, firstTime);
-                }
-                aacTrackId = i;
-                break;
-              }
-            }
-          }
-          if (aacTrackId == INVALID_TRACK_ID){
-            FAIL_MSG("[FAAC] Failed to find AAC track for conversion!");
-          }else{
-            static AACConverter::AACConverter converter(
-              meta->getRate(trackId),       // Input sample rate
-              meta->getChannels(trackId),   // Input channel count
-              meta->getSize(aacTrackId),    // Output bit rate
-              meta->getRate(aacTrackId)     // Output sample rate
-            );
-            int32_t outPlSize;
-            unsigned char *outPl = new unsigned char[converter.maxOutAacBytes];
-            converter.transcode(codec, pl, plSize, outPl, outPlSize);
-            if (outPlSize == 0){
-              // Initial condition
-              converter.frameMsTime = msTime-750;
-              HIGH_MSG("[FAAC] Finding intial timestamp (%u)", converter.frameMsTime);
-            }
-            if (outPlSize > 0){
-              DTSC::Packet nextPack;
-              nextPack.genericFill(converter.frameMsTime, 0, aacTrackId, (const char*)outPl, outPlSize, 0, false);
-              outPacket(nextPack);
-              HIGH_MSG("[FAAC] Setting this audio frame timestamp to %u", converter.frameMsTime);
-            }
-            delete[] outPl;
-          }
-        }
+      if (codecId == DTSC::CODEC_AAC){return handleAAC(msTime, pl, plSize);}
+      if (codecId == DTSC::CODEC_MP2 || codecId == DTSC::CODEC_MP3){return handleMP2(msTime, pl, plSize);}
+      if (codecId == DTSC::CODEC_ALAW || codecId == DTSC::CODEC_OPUS || codecId == DTSC::CODEC_PCM || codecId == DTSC::CODEC_ULAW){
+        // Step 15/B/2 - Encode to AAC if needed
+        if (audioEncoder){handleG711ToAAC(msTime, pl, plSize, meta);}
         // Trivial codecs just fill a packet with raw data and continue. Easy peasy, lemon squeezy.
-        DTSC::Packet nextPack;
-        nextPack.genericFill(msTime, 0, trackId, pl, plSize, 0, false);
-        outPacket(nextPack);
+        outData(trackId, msTime, 0, pl, plSize, false);
         return;
       }
-    }else if (type == "unknown"){
+    }else if (type == DTSC::TYPE_UNKNOWN){
       // If we don't know how to handle this codec in RTP, print an error and ignore the packet.
       FAIL_MSG("Unimplemented RTP reader for codec `%s`! Throwing away packet.", codec.c_str());
     }
   }
 
+  /// Encodes G.711 audio of this track into the first AAC track of the meta.
+  /// The encoder belongs to this track and is created when the AAC track is first found,
+  /// so every source track keeps its own PCM buffer and frame timing.
+  void toDTSC::handleG711ToAAC(uint64_t msTime, char *pl, uint32_t plSize, DTSC::Meta *meta){
+    size_t trackCount = meta->trackCount();
+    if (aacTrackId == INVALID_TRACK_ID || tracksCount != trackCount){
+      tracksCount = trackCount;
+      size_t newAacTrack = INVALID_TRACK_ID;
+      std::set<size_t> validTracks = meta->getValidTracks();
+      for (std::set<size_t>::iterator it = validTracks.begin(); it != validTracks.end(); ++it){
+        if (meta->getCodec(*it) == "AAC"){
+          if (!meta->getMilliSyncMs(*it)){
+            meta->setMilliSyncMs(*it, milliSync);
+          }
+          if (!meta->getFirstRtpMs(*it)){
+            meta->setFirstRtpMs(*it, firstTime);
+          }
+          newAacTrack = *it;
+          break;
+        }
+      }
+      if (newAacTrack != aacTrackId && aacWorker){
+        drainAAC();
+        delete aacWorker;
+        aacWorker = 0;
+      }
+      aacTrackId = newAacTrack;
+    }
+    if (aacTrackId == INVALID_TRACK_ID){
+      FAIL_MSG("[FAAC] Failed to find AAC track for conversion!");
+      return;
+    }
+    if (!aacWorker){
+      aacWorker = new AACConverter::AACWorker(
+        meta->getRate(trackId),       // Input sample rate
+        meta->getChannels(trackId),   // Input channel count
+        meta->getSize(aacTrackId),    // Output bit rate
+        meta->getRate(aacTrackId)     // Output sample rate
+      );
+    }
+    // Encoding happens on the worker thread; finished frames come back out through flushAAC
+    aacWorker->push(g711Codec, msTime, pl, plSize);
+  }
+
+  /// Outputs the AAC frames the encoder thread has finished so far.
+  /// Called for every incoming packet, so frames go out on the ingest thread shortly after being encoded.
+  void toDTSC::flushAAC(){
+    if (!aacWorker){return;}
+    AACConverter::AACFrame *frame;
+    while ((frame = aacWorker->front())){
+      HIGH_MSG("[FAAC] Setting this audio frame timestamp to %" PRIu64, frame->msTime);
+      outData(aacTrackId, frame->msTime, 0, frame->data, frame->size, false);
+      aacWorker->pop();
+    }
+  }
+
+  /// Waits for the encoder thread to finish all audio handed to it so far, and outputs the result.
+  /// Called before the encoder goes away, so the last frames in flight are not lost.
+  void toDTSC::drainAAC(){
+    if (!aacWorker){return;}
+    uint64_t waitUntil = Util::bootMS() + AAC_DRAIN_WAIT;
+    while (aacWorker->busy() && Util::bootMS() < waitUntil){
+      flushAAC();
+      Util::sleep(1);
+    }
+    flushAAC();
+  }
+
   void toDTSC::handleAAC(uint64_t msTime, char *pl, uint32_t plSize){
     // assume AAC packets are single AU units
     /// \todo Support other input than single AU units
     unsigned int headLen = (Bit::btohs(pl) >> 3) + 2; // in bits, so /8, plus two for the prepended size
-    DTSC::Packet nextPack;
     uint16_t samples = aac::AudSpecConf::samples(init);
     uint32_t sampleOffset = 0;
     uint32_t offset = 0;
@@ -1111,17 +1312,9 @@ namespace RTP{
                 finalPackTime,
                 finalPackDataSize
               );
-      nextPack.genericFill( msTime + sampleOffset / multiplier,           // packTime
-                            0,                                            // packOffset
-                            trackId,                                      // packTrack
-                            pl + headLen + offset,                        // packData
-                            std::min(auSize, plSize - headLen - offset),  // packDataSize
-                            0,                                            // packBytePos
-                            false                                         // isKeyframe
-                          );
+      outData(trackId, finalPackTime, 0, pl + headLen + offset, finalPackDataSize, false);
       offset += auSize;
       sampleOffset += samples;
-      outPacket(nextPack);
     }
   }
 
@@ -1130,9 +1323,7 @@ namespace RTP{
       WARN_MSG("Empty packet ignored!");
       return;
     }
-    DTSC::Packet nextPack;
-    nextPack.genericFill(msTime, 0, trackId, pl + 4, plSize - 4, 0, false);
-    outPacket(nextPack);
+    outData(trackId, msTime, 0, pl + 4, plSize - 4, false);
   }
 
   void toDTSC::handleMPEG2(uint64_t msTime, char *pl, uint32_t plSize){
@@ -1142,9 +1333,7 @@ namespace RTP{
     }
     ///\TODO Merge packets with same timestamp together
     HIGH_MSG("Received MPEG2 packet: %s", RTP::MPEGVideoHeader(pl).toString().c_str());
-    DTSC::Packet nextPack;
-    nextPack.genericFill(msTime, 0, trackId, pl + 4, plSize - 4, 0, false);
-    outPacket(nextPack);
+    outData(trackId, msTime, 0, pl + 4, plSize - 4, false);
   }
 
   void toDTSC::handleHEVC(uint64_t msTime, char *pl, uint32_t plSize, bool missed, DTSC::Meta *meta){
@@ -1256,10 +1445,8 @@ namespace RTP{
                   isKey ? "key" : "i", packCount);
 
     // Fill the new DTSC packet, buffer it.
-    DTSC::Packet nextPack;
-    nextPack.genericFill(ts, 0, trackId, buffer, len, 0, isKey);
     packCount++;
-    outPacket(nextPack);
+    outData(trackId, ts, 0, buffer, len, isKey);
   }
 
   /// Handles common H264 packets types, but not all.
@@ -1371,10 +1558,8 @@ namespace RTP{
       VERYHIGH_MSG("Packing time %" PRIu64 " = %sframe %" PRIu64, currH264Time,
                     isKey ? "key" : "i", packCount);
       // Fill the new DTSC packet, buffer it.
-      DTSC::Packet nextPack;
-      nextPack.genericFill(ts, 0, trackId, h264OutBuffer, h264OutBuffer.size(), 0, h264BufferWasKey);
       packCount++;
-      outPacket(nextPack);
+      outData(trackId, ts, 0, h264OutBuffer, h264OutBuffer.size(), h264BufferWasKey);
 
       //Clear the buffers, reset the time to current
       h264OutBuffer.assign(0, 0);
@@ -1549,10 +1734,8 @@ namespace RTP{
     if (vp8FrameBuffer.size()){
       // new frame and nothing missed? Send.
       if (start_of_frame && !missed){
-        DTSC::Packet nextPack;
-        nextPack.genericFill(msTime, 0, trackId, vp8FrameBuffer, vp8FrameBuffer.size(), 0, vp8BufferHasKeyframe);
         packCount++;
-        outPacket(nextPack);
+        outData(trackId, msTime, 0, vp8FrameBuffer, vp8FrameBuffer.size(), vp8BufferHasKeyframe);
       }
       // Wipe the buffer clean if missed packets or we just sent data out.
       if (start_of_frame || missed){
@@ -1,5 +1,6 @@
 #pragma once
 #include "dtsc.h"
+#include "g711.h"
 #include "h264.h"
 #include "h265.h"
 #include "json.h"
@@ -20,6 +21,10 @@
 #include <signal.h>
 #include <unistd.h>
 
+namespace AACConverter{
+  class AACWorker;
+}
+
 #define PAYLOAD_TYPE_RTCP(x) ((x) >= (72) && (x) <= (76))
 #define TIME_UNTIL_ROLLOVER(pTime, multiplier) \
   ((double)((uint64_t)UINT32_MAX - (pTime)) / ((double)(multiplier) * 1000.0))
@@ -35,6 +40,13 @@ namespace RTP{
   extern unsigned int PACKET_REORDER_WAIT;
   extern unsigned int PACKET_DROP_TIMEOUT;
 
+/// Size of the RTP::Sorter reorder window, in packets. Must be a power of two.
+/// Packets further ahead than this force the sorter to give up on the missing ones, whatever PACKET_DROP_TIMEOUT is.
+#define RTP_SORTER_SLOTS 1024
+
+/// Maximum amount of columns for Pro-MPEG FEC, as accepted by Packet::configureFEC
+#define RTP_FEC_MAX_COLUMNS 20
+
     struct FecData{
     public:
       uint16_t sequence;
@@ -59,9 +71,15 @@ namespace RTP{
       uint32_t rtpBufSize;
       uint32_t bitstringSize;
       FecData fecBufferRows; // Stores intermediate results or XOR'd RTP packets
-      std::map<uint8_t, FecData> fecBufferColumns;
+      FecData fecBufferColumns[RTP_FEC_MAX_COLUMNS];
+      uint8_t *scratch; ///< Bitstring of the packet currently being added
+      uint8_t *rtpBuf; ///< FEC packet currently being sent
+      Util::ResizeablePointer buffers; ///< Backing memory of all of the above, allocated once per configuration
   };
 
+  void xorBuffer(const uint8_t *in1, const uint8_t *in2, uint8_t *out, size_t size);
+  bool setXORKernel(const std::string &name);
+
   /// This class is used to make RTP packets. Currently, H264, and AAC are supported. RTP
   /// mechanisms, like increasing sequence numbers and setting timestamps are all taken care of in
   /// here.
@@ -100,7 +118,8 @@ namespace RTP{
     void generateBitstring(const char *payload, unsigned int payloadlen, uint8_t *bitstring);
     bool configureFEC(uint8_t rows, uint8_t columns);
     void sendFec(void *socket, FecData *fecData, bool isColumn);
-    void parseFEC(void *columnSocket, void *rowSocket, uint64_t & bytesSent, const char *payload, unsigned int payloadlen);
+    void parseFEC(void *columnSocket, void *rowSocket, uint64_t & bytesSent, const char *payload, unsigned int payloadlen,
+                  void *mediaSocket = 0);
     void sendNoPacket(unsigned int payloadlen);
     void sendTS(void *socket, const char *payload, unsigned int payloadlen);
     void sendH264(void *socket, void callBack(void *, const char *, size_t, uint8_t), const char *payload,
@@ -113,6 +132,8 @@ namespace RTP{
                    const char *payload, unsigned int payloadlen, unsigned int channel);
     void sendData(void *socket, void callBack(void *, const char *, size_t, uint8_t), const char *payload,
                   unsigned int payloadlen, unsigned int channel, std::string codec);
+    void sendData(void *socket, void callBack(void *, const char *, size_t, uint8_t), const char *payload,
+                  unsigned int payloadlen, unsigned int channel, DTSC::codecType codec);
     void sendRTCP_SR(void *socket, uint8_t channel, void callBack(void *, const char *, size_t, uint8_t));
     void sendRTCP_RR(SDP::Track &sTrk, void callBack(void *, const char *, size_t, uint8_t));
 
@@ -124,6 +145,7 @@ namespace RTP{
     Packet(const char *dat, uint64_t len);
     const char *getData();
     char *ptr() const{return data;}
+    uint32_t size() const{return maxDataLen;}
     std::string toString() const;
   };
 
@@ -146,13 +168,27 @@ namespace RTP{
     bool preBuffer;
     int32_t lostTotal, lostCurrent;
     uint32_t packTotal, packCurrent;
-    std::set<uint16_t> wantedSeqs;
+    std::deque<uint16_t> wantedSeqs; ///< Sequence numbers to ask a retransmit for, oldest first
     uint32_t lastNTP; ///< Middle 32 bits of last Sender Report NTP timestamp
     uint64_t lastBootMS; ///< bootMS time of last Sender Report
   private:
+    /// Reorder buffer entry. The data buffer is kept when the slot is freed, and reused for later packets.
+    struct Slot{
+      Slot(){
+        used = false;
+        seq = 0;
+      }
+      bool used;
+      uint16_t seq;
+      std::string data;
+    };
     uint64_t packTrack;
-    std::map<uint16_t, Packet> packBuffer;
-    std::map<uint16_t, Packet> packetHistory;
+    std::vector<Slot> slots; ///< Reorder buffer, indexed by sequence number modulo RTP_SORTER_SLOTS
+    size_t buffered;         ///< Amount of used slots
+    uint16_t lowestSeq;      ///< Lowest buffered sequence number while pre-buffering
+    bool isBuffered(uint16_t seq) const;
+    void bufferPacket(const Packet &pack);
+    void sendBuffered();
     void (*callback)(const uint64_t track, const Packet &p);
   };
 
@@ -178,12 +214,14 @@ namespace RTP{
   class toDTSC{
   public:
     toDTSC();
-    virtual ~toDTSC(){}
+    virtual ~toDTSC();
     void setProperties(const uint64_t track, const std::string &codec, const std::string &type,
                        const std::string &init, const double multiplier);
     void setProperties(const DTSC::Meta &M, size_t tid);
     void setCallbacks(void (*cbPack)(const DTSC::Packet &pkt),
                       void (*cbInit)(const uint64_t track, const std::string &initData));
+    void setDataCallback(void (*cbData)(const uint64_t track, const uint64_t time, const int64_t offset,
+                                        const char *data, const size_t len, const bool keyframe));
     void addRTP(const RTP::Packet &rPkt, DTSC::Meta *meta, bool audioEncoder = false);
     virtual void outPacket(const DTSC::Packet &pkt){
       if (cbPack){cbPack(pkt);}
@@ -191,11 +229,14 @@ namespace RTP{
     virtual void outInit(const uint64_t track, const std::string &initData){
       if (cbInit){cbInit(track, initData);}
     }
+    void outData(const uint64_t track, const uint64_t time, const int64_t offset, const char *data,
+                 const size_t len, const bool keyframe);
 
   public:
     uint64_t trackId;
     double multiplier;    ///< Multiplier to convert from millis to RTP time
     std::string codec;    ///< Codec of this track
+    DTSC::codecType codecId; ///< Codec of this track, as integer for the per-packet dispatch
     std::string type;     ///< Type of this track
     std::string init;     ///< Init data of this track
     uint16_t lastSeq;     ///< Last sequence number seen
@@ -208,6 +249,8 @@ namespace RTP{
     uint32_t prevAudioPktTime;
     void (*cbPack)(const DTSC::Packet &pkt);
     void (*cbInit)(const uint64_t track, const std::string &initData);
+    void (*cbData)(const uint64_t track, const uint64_t time, const int64_t offset, const char *data,
+                   const size_t len, const bool keyframe);
     // Codec-specific handlers
     void handleAAC(uint64_t msTime, char *pl, uint32_t plSize);
     void handleMP2(uint64_t msTime, char *pl, uint32_t plSize);
@@ -231,6 +274,17 @@ namespace RTP{
                                             ///< partition; but we might be missing other partitions when they were
                                             ///< lost. (a partition is basically what's called a slice in H264).
     bool vp8BufferHasKeyframe;
-    bool tracksCount;
+    size_t tracksCount;                   ///< Track count of the meta when aacTrackId was last looked up
+    G711::Codec g711Codec;                ///< Codec of this track as G.711 codec, for AAC encoding
+    size_t aacTrackId;                    ///< Track that G.711 input is encoded into, if enabled
+    AACConverter::AACWorker *aacWorker;   ///< Encoder for aacTrackId, created on first use
+    void handleG711ToAAC(uint64_t msTime, char *pl, uint32_t plSize, DTSC::Meta *meta);
+    void flushAAC();
+    void drainAAC();
+
+  private:
+    // Owns aacWorker; copying would free it twice
+    toDTSC(const toDTSC &);
+    toDTSC &operator=(const toDTSC &);
   };
 }// namespace RTP
@@ -402,7 +402,8 @@ namespace RTP{
       }
       Packet &mediaPacket = receivedMediaPackets[seqNum];
       char *mediaData = mediaPacket.ptr() + mediaPacket.getHsize();
-      for (size_t i = 0; i < recoverPayloadSize; ++i){recoverData[12 + i] ^= mediaData[i];}
+      uint8_t *recoverPayload = (uint8_t *)(char *)recoverData + 12;
+      xorBuffer(recoverPayload, (const uint8_t *)mediaData, recoverPayload, recoverPayloadSize);
       ++protIt;
     }
 
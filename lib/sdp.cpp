@@ -462,6 +462,7 @@ namespace SDP{
 
   State::State(){
     incomingPacketCallback = 0;
+    incomingDataCallback = 0;
     myMeta = 0;
     snglState = this;
   }
@@ -901,11 +902,26 @@ namespace SDP{
   /// In case of UDP, expects packets to be pre-sorted.
   void State::handleIncomingRTP(const uint64_t track, const RTP::Packet &pkt, DTSC::Meta *meta, bool audioEncoder){
     tConv[track].setCallbacks(incomingPacketCallback, snglStateInitCallback);
+    tConv[track].setDataCallback(incomingDataCallback);
     tConv[track].addRTP(pkt, meta, audioEncoder);
+    // Pick up audio encoded in the background, whichever track this packet was for
+    if (audioEncoder){
+      for (std::map<uint64_t, RTP::toDTSC>::iterator it = tConv.begin(); it != tConv.end(); ++it){
+        it->second.flushAAC();
+      }
+    }
+  }
+
+  /// Outputs all audio still being encoded in the background, for example before tearing down.
+  void State::drainAudio(){
+    for (std::map<uint64_t, RTP::toDTSC>::iterator it = tConv.begin(); it != tConv.end(); ++it){
+      it->second.drainAAC();
+    }
   }
 
   /// Re-inits internal variables and removes all tracks from meta
   void State::reinitSDP(){
+    drainAudio();
     tConv.clear();
     size_t trackID;
 
@@ -49,6 +49,8 @@ namespace SDP{
   public:
     State();
     void (*incomingPacketCallback)(const DTSC::Packet &pkt);
+    void (*incomingDataCallback)(const uint64_t track, const uint64_t time, const int64_t offset,
+                                 const char *data, const size_t len, const bool keyframe);
     void parseSDP(const std::string &sdp);
     void parseSDPEx(const std::string &sdp);
     void updateH264Init(uint64_t trackNo);
@@ -61,6 +63,8 @@ namespace SDP{
     bool parseTransport(const std::string &sdpString);
     // Re-inits internal variables and removes all tracks from meta
     void reinitSDP();
+    // Outputs all audio still being encoded in the background
+    void drainAudio();
 
   public:
     DTSC::Meta *myMeta;
@@ -5,12 +5,14 @@
 #include "shared_memory.h"
 #include "stream.h"
 #include "timing.h"
+#include "tinythread.h"
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <map>
 #include <sys/mman.h>
 #include <sys/sem.h>
 #include <unistd.h>
@@ -365,6 +367,61 @@ namespace IPC{
   }
 #endif
 
+#ifdef SHM_ENABLED
+  bool sharePageMappings = false;
+
+#if !defined(__CYGWIN__) && !defined(_WIN32)
+  /// Mapping of a page, used by every sharedPage in this process that opened it
+  struct sharedMapping{
+    char *mapped;
+    uint64_t len;
+    size_t users;
+  };
+  /// Shared mappings by device and inode of their page, so a page that was replaced by a new one
+  /// with the same name never gets the old mapping.
+  static std::map<std::pair<dev_t, ino_t>, sharedMapping> sharedMappings;
+  /// Device and inode of the page behind each shared mapping, by mapped address
+  static std::map<char *, std::pair<dev_t, ino_t> > sharedMappingIds;
+  static tthread::mutex sharedMappingMutex;
+
+  /// Maps the page open as handle, with the given stats, reusing the existing mapping if another
+  /// sharedPage in this process has the same page mapped already.
+  static char *mapShared(int handle, const struct stat &st){
+    tthread::lock_guard<tthread::mutex> guard(sharedMappingMutex);
+    std::pair<dev_t, ino_t> id(st.st_dev, st.st_ino);
+    std::map<std::pair<dev_t, ino_t>, sharedMapping>::iterator it = sharedMappings.find(id);
+    if (it != sharedMappings.end() && it->second.len == (uint64_t)st.st_size){
+      ++it->second.users;
+      return it->second.mapped;
+    }
+    char *mapped = (char *)mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    // A page that was resized since it was first mapped gets a private mapping instead
+    if (mapped != MAP_FAILED && it == sharedMappings.end()){
+      sharedMapping &m = sharedMappings[id];
+      m.mapped = mapped;
+      m.len = st.st_size;
+      m.users = 1;
+      sharedMappingIds[mapped] = id;
+    }
+    return mapped;
+  }
+
+  /// Releases a mapping obtained through mapShared. Returns false if it is not a shared mapping,
+  /// in which case the caller should unmap it itself.
+  static bool unmapShared(char *mapped){
+    tthread::lock_guard<tthread::mutex> guard(sharedMappingMutex);
+    std::map<char *, std::pair<dev_t, ino_t> >::iterator idIt = sharedMappingIds.find(mapped);
+    if (idIt == sharedMappingIds.end()){return false;}
+    sharedMapping &m = sharedMappings[idIt->second];
+    if (--m.users){return true;}
+    munmap(m.mapped, m.len);
+    sharedMappings.erase(idIt->second);
+    sharedMappingIds.erase(idIt);
+    return true;
+  }
+#endif
+#endif
+
   /// brief Creates a shared page
   ///\param name_ The name of the page to be created
   ///\param len_ The size to make the page
@@ -411,7 +468,7 @@ namespace IPC{
       // under Cygwin, the mapped location is shifted by 4 to contain the page size.
       UnmapViewOfFile(mapped - 4);
 #else
-      munmap(mapped, len);
+      if (!sharePageMappings || !unmapShared(mapped)){munmap(mapped, len);}
 #endif
       mapped = 0;
       len = 0;
@@ -530,6 +587,14 @@ namespace IPC{
           mapped = 0;
           return;
         }
+        if (sharePageMappings){
+          mapped = mapShared(handle, buffStats);
+          if (mapped == MAP_FAILED){
+            FAIL_MSG("mmap for page %s failed: %s", name.c_str(), strerror(errno));
+            mapped = 0;
+          }
+          return;
+        }
       }
       mapped = (char *)mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
       if (mapped == MAP_FAILED){
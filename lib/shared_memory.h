@@ -96,6 +96,11 @@ namespace IPC{
 #endif
 
 #ifdef SHM_ENABLED
+  /// If true, sharedPage instances in this process that open (rather than create) the same page
+  /// share a single mapping of it. Set by processes that serve many connections to the same
+  /// streams, so their metadata and data pages are mapped once instead of once per connection.
+  extern bool sharePageMappings;
+
   ///\brief A class for managing shared memory pages.
   class sharedPage{
   public:
@@ -23,6 +23,19 @@
 #define SOCKETSIZE 51200ul
 #endif
 
+#define UDP_BATCH_SIZE 32 // datagrams per recvmmsg/sendmmsg call
+#define UDP_BATCH_BYTES 65000 // max bytes per UDP_SEGMENT send; the kernel limit is 64KiB
+#if defined(__linux__) && !defined(__CYGWIN__)
+#define UDP_BATCHING 1
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif
+
 /// Local-scope only helper function that prints address families
 static const char *addrFam(int f){
   switch (f){
@@ -579,6 +592,9 @@ void Socket::Connection::clear(){
   Error = false;
   Blocking = false;
   skipCount = 0;
+  upbuffer.clear();
+  upbufferSent = 0;
+  queueSends = false;
 #ifdef SSL
   sslConnected = false;
   server_fd = 0;
@@ -990,7 +1006,12 @@ const Socket::Buffer &Socket::Connection::Received() const{
 
 /// Will not buffer anything but always send right away. Blocks.
 /// Any data that could not be send will block until it can be send or the connection is severed.
+/// While sends are queued (see setQueued), queues what cannot be sent right away instead.
 void Socket::Connection::SendNow(const char *data, size_t len){
+  if (queueSends){
+    queueSend(data, len);
+    return;
+  }
   // Temporarily set the socket to blocking mode if it's not already
   const bool wasBlocking = isBlocking();
   if (!wasBlocking){
@@ -1027,6 +1048,65 @@ void Socket::Connection::SendNow(const char *data, size_t len, uint16_t rateLimi
   if (!bing){setBlocking(false);}
 }
 
+/// Will not buffer anything but always send right away. Blocks.
+/// Sends all given buffers in order, using as few write calls as possible.
+/// Any data that could not be send will block until it can be send or the connection is severed.
+/// While sends are queued (see setQueued), queues what cannot be sent right away instead.
+void Socket::Connection::SendNow(const struct iovec *iov, size_t iovcnt){
+  if (!iovcnt){return;}
+  if (iovcnt == 1){
+    SendNow((const char *)iov[0].iov_base, iov[0].iov_len);
+    return;
+  }
+  if (queueSends){
+    // Try a single write of the first buffers, then queue whatever is left of them
+    size_t written = 0;
+    if (upbufferSent == upbuffer.size()){written = iwritev(iov, std::min(iovcnt, (size_t)16));}
+    for (size_t i = 0; i < iovcnt; ++i){
+      if (written >= iov[i].iov_len){
+        written -= iov[i].iov_len;
+        continue;
+      }
+      queueSend((const char *)iov[i].iov_base + written, iov[i].iov_len - written);
+      written = 0;
+    }
+    return;
+  }
+  const bool wasBlocking = isBlocking();
+  if (!wasBlocking){setBlocking(true);}
+  // Current position in the list: entry index plus offset into that entry
+  size_t idx = 0;
+  size_t offset = 0;
+  struct iovec batch[16];
+  while (idx < iovcnt && connected()){
+    if (offset == iov[idx].iov_len){
+      ++idx;
+      offset = 0;
+      continue;
+    }
+    int batchCnt = 0;
+    for (size_t i = idx; i < iovcnt && batchCnt < 16; ++i){
+      batch[batchCnt].iov_base = (char *)iov[i].iov_base + (i == idx ? offset : 0);
+      batch[batchCnt].iov_len = iov[i].iov_len - (i == idx ? offset : 0);
+      ++batchCnt;
+    }
+    size_t written = iwritev(batch, batchCnt);
+    if (!written){
+      if (!connected()){break;}
+      Util::sleep(1);
+      continue;
+    }
+    written += offset;
+    offset = 0;
+    while (idx < iovcnt && written >= iov[idx].iov_len){
+      written -= iov[idx].iov_len;
+      ++idx;
+    }
+    offset = written;
+  }
+  if (!wasBlocking){setBlocking(false);}
+}
+
 /// Will not buffer anything but always send right away. Blocks.
 /// Any data that could not be send will block until it can be send or the connection is severed.
 void Socket::Connection::SendNow(const char *data){
@@ -1040,6 +1120,69 @@ void Socket::Connection::SendNow(const std::string &data){
   SendNow(data.data(), data.size());
 }
 
+/// Makes SendNow queue any data that the socket does not accept right away, instead of blocking
+/// until it does. Call flushQueue() whenever the socket becomes writable, to send the rest.
+/// The socket is made non-blocking. Turning queueing off sends anything still queued first,
+/// blocking if needed.
+void Socket::Connection::setQueued(bool queued){
+  if (queued == queueSends){return;}
+  queueSends = queued;
+  if (queued){
+    setBlocking(false);
+    return;
+  }
+  std::string pending = upbuffer.substr(upbufferSent);
+  upbuffer.clear();
+  upbufferSent = 0;
+  if (pending.size()){SendNow(pending);}
+}
+
+/// Sends what it can of the given data without blocking, and queues the rest.
+/// Data is only written directly if nothing is queued, so everything is sent in order.
+void Socket::Connection::queueSend(const char *data, size_t len){
+  if (!len || !connected()){return;}
+  if (upbufferSent == upbuffer.size()){
+    upbuffer.clear();
+    upbufferSent = 0;
+    while (len){
+      size_t written = iwrite(data, std::min(len, (size_t)SOCKETSIZE));
+      if (!written){break;}
+      data += written;
+      len -= written;
+    }
+    if (!len || !connected()){return;}
+  }
+  upbuffer.append(data, len);
+}
+
+/// Sends as much queued data as the socket accepts without blocking.
+/// Returns true if nothing is left queued afterwards; queued data is dropped if the connection
+/// is lost.
+bool Socket::Connection::flushQueue(){
+  while (upbufferSent < upbuffer.size() && connected()){
+    size_t written = iwrite(upbuffer.data() + upbufferSent,
+                            std::min(upbuffer.size() - upbufferSent, (size_t)SOCKETSIZE));
+    if (!written){break;}
+    upbufferSent += written;
+  }
+  if (upbufferSent == upbuffer.size() || !connected()){
+    upbuffer.clear();
+    upbufferSent = 0;
+    return true;
+  }
+  // Drop the sent part once it makes up most of the buffer, so appending stays cheap
+  if (upbufferSent > upbuffer.size() / 2){
+    upbuffer.erase(0, upbufferSent);
+    upbufferSent = 0;
+  }
+  return false;
+}
+
+/// Returns the amount of bytes SendNow queued that were not sent yet.
+size_t Socket::Connection::queuedBytes() const{
+  return upbuffer.size() - upbufferSent;
+}
+
 void Socket::Connection::skipBytes(uint32_t byteCount){
   INFO_MSG("Skipping first %" PRIu32 " bytes going to socket", byteCount);
   skipCount = byteCount;
@@ -1107,6 +1250,51 @@ unsigned int Socket::Connection::iwrite(const void *buffer, int len){
   return result;
 }
 
+/// Incremental scatter-gather write call. Tries to write all given buffers in a single
+/// sendmsg/writev call, returning the amount of bytes it actually wrote.
+/// Falls back to consecutive iwrite calls for SSL connections and while skipping bytes.
+/// \param iov Array of buffers to write from, in order.
+/// \param iovcnt Amount of entries in iov.
+/// \returns The amount of bytes actually written.
+size_t Socket::Connection::iwritev(const struct iovec *iov, int iovcnt){
+  if (!connected() || iovcnt <= 0){return 0;}
+#ifdef SSL
+  bool plainWrite = !sslConnected && !skipCount;
+#else
+  bool plainWrite = !skipCount;
+#endif
+  if (!plainWrite){
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i){
+      if (!iov[i].iov_len){continue;}
+      unsigned int w = iwrite(iov[i].iov_base, iov[i].iov_len);
+      total += w;
+      if (w < iov[i].iov_len){break;}
+    }
+    return total;
+  }
+  ssize_t result;
+  if (isTrueSocket){
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+    result = sendmsg(sSend, &msg, 0);
+  }else{
+    result = writev(sSend, iov, iovcnt);
+  }
+  if (result <= 0){
+    if (result == 0 || errno == EWOULDBLOCK || errno == EINTR){return 0;}
+    Error = true;
+    lastErr = strerror(errno);
+    INSANE_MSG("Could not iwritev data! Error: %s", lastErr.c_str());
+    close();
+    return 0;
+  }
+  up += result;
+  return result;
+}
+
 /// Incremental read call. This function tries to read len bytes to the buffer from the socket,
 /// returning the amount of bytes it actually read.
 /// \param buffer Location of the buffer to read to.
@@ -1617,6 +1805,10 @@ Socket::UDPConnection::UDPConnection(bool nonblock){
     if (nonblock){setBlocking(!nonblock);}
     checkRecvBuf();
   }
+  recvBufSize = 0;
+  recvCount = 0;
+  recvPos = 0;
+  noGSO = false;
   up = 0;
   down = 0;
   destAddr = 0;
@@ -1685,6 +1877,10 @@ Socket::UDPConnection::UDPConnection(const UDPConnection &o){
   }
   if (sock == -1){FAIL_MSG("Could not create UDP socket: %s", strerror(errno));}
   checkRecvBuf();
+  recvBufSize = 0;
+  recvCount = 0;
+  recvPos = 0;
+  noGSO = false;
   up = 0;
   down = 0;
   if (o.destAddr && o.destAddr_size){
@@ -1700,6 +1896,8 @@ Socket::UDPConnection::UDPConnection(const UDPConnection &o){
 
 /// Close the UDP socket
 void Socket::UDPConnection::close(){
+  recvCount = 0;
+  recvPos = 0;
   if (sock != -1){
     errno = EINTR;
     while (::close(sock) != 0 && errno == EINTR){}
@@ -1873,6 +2071,106 @@ void Socket::UDPConnection::SendNow(const char *sdata, size_t len){
   }
 }
 
+/// Queues a UDP datagram to be sent by sendQueued, together with the others queued before it.
+/// Sends the queue first when it cannot take the datagram anymore.
+void Socket::UDPConnection::queueSend(const char *sdata, size_t len){
+  if (len < 1){return;}
+  if (sendLens.size() >= UDP_BATCH_SIZE || (sendLens.size() && sendBufs.size() + len > UDP_BATCH_BYTES)){
+    sendQueued();
+  }
+  sendBufs.append(sdata, len);
+  sendLens.push_back(len);
+}
+
+/// Sends all datagrams queued by queueSend.
+/// On Linux, datagrams of equal size (the last one may be smaller) go out as a single segmentation offload send,
+/// anything else through a single sendmmsg call. Elsewhere, they are sent one by one.
+void Socket::UDPConnection::sendQueued(){
+  if (!sendLens.size()){return;}
+  const char *sdata = sendBufs;
+#ifdef UDP_BATCHING
+  if (!noGSO && sendLens.size() > 1){
+    bool uniform = true;
+    for (size_t i = 1; i + 1 < sendLens.size(); ++i){
+      if (sendLens[i] != sendLens[0]){
+        uniform = false;
+        break;
+      }
+    }
+    if (uniform && sendLens.back() <= sendLens[0]){
+      struct iovec iov;
+      iov.iov_base = (void *)sdata;
+      iov.iov_len = sendBufs.size();
+      char ctrl[CMSG_SPACE(sizeof(uint16_t))];
+      memset(ctrl, 0, sizeof(ctrl));
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = destAddr;
+      msg.msg_namelen = destAddr_size;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = ctrl;
+      msg.msg_controllen = sizeof(ctrl);
+      struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t segSize = sendLens[0];
+      memcpy(CMSG_DATA(cm), &segSize, sizeof(segSize));
+      int r = sendmsg(sock, &msg, 0);
+      if (r > 0){
+        up += r;
+        sendBufs.truncate(0);
+        sendLens.clear();
+        return;
+      }
+      if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP){
+        INFO_MSG("UDP segmentation offload not available on socket %d (%s), sending batches without it", sock, strerror(errno));
+        noGSO = true;
+      }else if (errno != ENETUNREACH){
+        FAIL_MSG("Could not send UDP data through %d: %s", sock, strerror(errno));
+        sendBufs.truncate(0);
+        sendLens.clear();
+        return;
+      }
+    }
+  }
+  struct mmsghdr msgs[UDP_BATCH_SIZE];
+  struct iovec iovs[UDP_BATCH_SIZE];
+  size_t count = sendLens.size();
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < count; ++i){
+    iovs[i].iov_base = (void *)sdata;
+    iovs[i].iov_len = sendLens[i];
+    sdata += sendLens[i];
+    msgs[i].msg_hdr.msg_name = destAddr;
+    msgs[i].msg_hdr.msg_namelen = destAddr_size;
+    msgs[i].msg_hdr.msg_iov = iovs + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  size_t sent = 0;
+  while (sent < count){
+    int r = sendmmsg(sock, msgs + sent, count - sent, 0);
+    if (r <= 0){
+      if (errno == EINTR){continue;}
+      if (errno != ENETUNREACH){
+        FAIL_MSG("Could not send UDP data through %d: %s", sock, strerror(errno));
+      }
+      break;
+    }
+    for (int i = 0; i < r; ++i){up += msgs[sent + i].msg_len;}
+    sent += r;
+  }
+#else
+  for (size_t i = 0; i < sendLens.size(); ++i){
+    SendNow(sdata, sendLens[i]);
+    sdata += sendLens[i];
+  }
+#endif
+  sendBufs.truncate(0);
+  sendLens.clear();
+}
+
 std::string Socket::UDPConnection::getBoundAddress(){
   std::string boundaddr;
   uint32_t boundport;
@@ -2076,9 +2374,71 @@ uint16_t Socket::UDPConnection::bind(int port, std::string iface, const std::str
 /// This will automatically allocate or resize the internal data buffer if needed.
 /// If a packet is received, it will be placed in the "data" member, with it's length in "data_len".
 /// \return True if a packet was received, false otherwise.
+#ifdef UDP_BATCHING
+/// Receives up to UDP_BATCH_SIZE datagrams at once into the receive batch buffers.
+/// Returns false if nothing was received.
+bool Socket::UDPConnection::fillRecvBatch(){
+  recvCount = 0;
+  recvPos = 0;
+  // Each buffer is as large as the data buffer, which grows when datagrams do not fit
+  recvBufSize = data.rsize();
+  if (!recvBufs.allocate(recvBufSize * UDP_BATCH_SIZE)){return false;}
+  if (!recvMeta.allocate(UDP_BATCH_SIZE * (sizeof(struct mmsghdr) + sizeof(struct iovec) + sizeof(struct sockaddr_storage)))){
+    return false;
+  }
+  struct mmsghdr *msgs = (struct mmsghdr *)(char *)recvMeta;
+  struct iovec *iovs = (struct iovec *)(msgs + UDP_BATCH_SIZE);
+  struct sockaddr_storage *addrs = (struct sockaddr_storage *)(iovs + UDP_BATCH_SIZE);
+  memset(msgs, 0, UDP_BATCH_SIZE * sizeof(struct mmsghdr));
+  for (size_t i = 0; i < UDP_BATCH_SIZE; ++i){
+    iovs[i].iov_base = (char *)recvBufs + i * recvBufSize;
+    iovs[i].iov_len = recvBufSize;
+    msgs[i].msg_hdr.msg_iov = iovs + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = addrs + i;
+    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  }
+  int r = recvmmsg(sock, msgs, UDP_BATCH_SIZE, MSG_TRUNC | MSG_DONTWAIT, 0);
+  if (r == -1){
+    if (errno != EAGAIN){INFO_MSG("UDP receive: %d (%s)", errno, strerror(errno));}
+    return false;
+  }
+  recvCount = r;
+  return r > 0;
+}
+#endif
+
+/// Receives a single UDP datagram into data, and sets the destination address to its sender.
+/// On Linux, datagrams are read from the socket in batches, so most calls do not need a system call.
+/// Returns false if there is no datagram waiting.
 bool Socket::UDPConnection::Receive(){
   if (sock == -1){return false;}
   data.truncate(0);
+#ifdef UDP_BATCHING
+  while (recvPos < recvCount || fillRecvBatch()){
+    struct mmsghdr *msgs = (struct mmsghdr *)(char *)recvMeta;
+    struct mmsghdr &m = msgs[recvPos];
+    char *buf = (char *)recvBufs + recvPos * recvBufSize;
+    ++recvPos;
+    size_t r = m.msg_len;
+    if (destAddr && destAddr_size){
+      memcpy(destAddr, m.msg_hdr.msg_name, std::min((size_t)destAddr_size, (size_t)m.msg_hdr.msg_namelen));
+    }
+    down += r;
+    //Handle UDP packets that are too large; they are dropped, but the next ones will fit
+    if (r > recvBufSize){
+      if (data.rsize() < r){
+        INFO_MSG("Doubling UDP socket buffer from %" PRIu32 " to %" PRIu32, data.rsize(), data.rsize()*2);
+        data.allocate(data.rsize()*2);
+      }
+      continue;
+    }
+    if (!r){continue;}
+    data.append(buf, r);
+    return true;
+  }
+  return false;
+#else
   socklen_t destsize = destAddr_size;
   int r = recvfrom(sock, data, data.rsize(), MSG_TRUNC | MSG_DONTWAIT, (sockaddr *)destAddr, &destsize);
   if (r == -1){
@@ -2093,6 +2453,7 @@ bool Socket::UDPConnection::Receive(){
     data.allocate(data.rsize()*2);
   }
   return (r > 0);
+#endif
 }
 
 int Socket::UDPConnection::getSock(){
@@ -13,8 +13,10 @@
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <vector>
 #include "util.h"
 
 #ifdef SSL
@@ -89,6 +91,10 @@ namespace Socket{
     uint64_t down;
     long long int conntime;
     Buffer downbuffer;                                ///< Stores temporary data coming in.
+    std::string upbuffer; ///< Stores outgoing data that could not be sent yet, while sends are queued.
+    size_t upbufferSent;  ///< Bytes at the start of upbuffer that were already sent.
+    bool queueSends;      ///< If true, SendNow queues what it cannot send instead of blocking.
+    void queueSend(const char *data, size_t len);
     int iread(void *buffer, int len, int flags = 0);  ///< Incremental read call.
     bool iread(Buffer &buffer, int flags = 0); ///< Incremental write call that is compatible with Socket::Buffer.
     void setBoundAddr();
@@ -152,11 +158,16 @@ namespace Socket{
     void SendNow(const char *data,
                  size_t len,
                  uint16_t rateLimit); ///< Will write at a limited rate with sleeps in between
+    void SendNow(const struct iovec *iov, size_t iovcnt); ///< Scatter-gather version of SendNow. Blocks.
+    void setQueued(bool queued); ///< Makes SendNow queue what it cannot send right away, instead of blocking.
+    bool flushQueue();           ///< Sends queued data without blocking. True if nothing is left queued.
+    size_t queuedBytes() const;  ///< Returns the amount of queued bytes that were not sent yet.
     void skipBytes(uint32_t byteCount);
     uint32_t skipCount;
     // unbuffered i/o methods
     unsigned int iwrite(const void *buffer, int len); ///< Incremental write call.
     bool iwrite(std::string &buffer); ///< Write call that is compatible with std::string.
+    size_t iwritev(const struct iovec *iov, int iovcnt); ///< Incremental scatter-gather write call.
     // stats related methods
     unsigned int connTime(); ///< Returns the time this socket has been connected.
     uint64_t dataUp();       ///< Returns total amount of bytes sent.
@@ -206,6 +217,15 @@ namespace Socket{
     std::string boundAddr, boundMulti;
     int boundPort;
     void checkRecvBuf();
+    Util::ResizeablePointer recvBufs; ///< Datagram buffers for batched receives
+    Util::ResizeablePointer recvMeta; ///< Message headers, iovecs and addresses for batched receives
+    size_t recvBufSize;               ///< Size of each buffer in recvBufs
+    size_t recvCount;                 ///< Datagrams in the current receive batch
+    size_t recvPos;                   ///< Next datagram of the current receive batch to hand out
+    bool fillRecvBatch();
+    Util::ResizeablePointer sendBufs; ///< Datagrams queued by queueSend, back to back
+    std::vector<size_t> sendLens;     ///< Sizes of the datagrams in sendBufs
+    bool noGSO;                       ///< Set when the kernel refused segmentation offload; falls back to sendmmsg
 
   public:
     Util::ResizeablePointer data;
@@ -227,6 +247,8 @@ namespace Socket{
     void SendNow(const std::string &data);
     void SendNow(const char *data);
     void SendNow(const char *data, size_t len);
+    void queueSend(const char *data, size_t len);
+    void sendQueued();
     void setSocketFamily(int AF_TYPE);
   };
 }// namespace Socket
@@ -149,8 +149,17 @@ namespace Socket{
   ///May result in socket being disconnected when connection was lost during read.
   ///Returns amount of bytes actually read
   size_t SRTConnection::Recv(){
+    size_t receivedBytes = Recv(recvbuf, 5000);
+    updateStats();
+    return receivedBytes;
+  }
+
+  ///Attempts a read into the given buffer, obeying the current blocking setting.
+  ///Unlike Recv(), does not update the statistics; call updateStats() for that.
+  ///A return value of zero with the socket still connected means no data was available.
+  size_t SRTConnection::Recv(char *buf, size_t len){
     SRT_MSGCTRL mc = srt_msgctrl_default;
-    int32_t receivedBytes = srt_recvmsg2(sock, recvbuf, 5000, &mc);
+    int32_t receivedBytes = srt_recvmsg2(sock, buf, len, &mc);
     prev_pktseq = mc.pktseq;
     if (receivedBytes == -1){
       int err = srt_getlasterror(0);
@@ -175,10 +184,14 @@ namespace Socket{
     }else{
       lastGood = Util::bootMS();
     }
-    srt_bstats(sock, &performanceMonitor, false);
     return receivedBytes;
   }
 
+  ///Refreshes the statistics returned by dataUp(), dataDown() and the packet counters.
+  void SRTConnection::updateStats(){
+    if (sock != -1){srt_bstats(sock, &performanceMonitor, false);}
+  }
+
   void SRTConnection::connect(const std::string &_host, int _port, const std::string &_direction,
                               const std::map<std::string, std::string> &_params){
     initializeEmpty();
@@ -521,6 +534,46 @@ namespace Socket{
 
   int SRTServer::getSocket(){return conn.getSocket();}
 
+  SRTPoller::SRTPoller(){
+    eid = srt_epoll_create();
+    if (eid < 0){
+      ERROR_MSG("Could not create SRT poller: %s", srt_getlasterror_str());
+      eid = -1;
+    }
+  }
+
+  SRTPoller::~SRTPoller(){
+    if (eid != -1){srt_epoll_release(eid);}
+  }
+
+  /// Starts watching the given socket for incoming data (or incoming connections, for listeners)
+  bool SRTPoller::add(SRTSOCKET sock){
+    if (eid == -1){return false;}
+    int events = SRT_EPOLL_IN | SRT_EPOLL_ERR;
+    if (srt_epoll_add_usock(eid, sock, &events) < 0){
+      ERROR_MSG("Could not add SRT socket %d to poller: %s", sock, srt_getlasterror_str());
+      return false;
+    }
+    return true;
+  }
+
+  void SRTPoller::remove(SRTSOCKET sock){
+    if (eid != -1){srt_epoll_remove_usock(eid, sock);}
+  }
+
+  /// Waits up to timeoutMs for sockets to become readable or fail.
+  /// Writes up to maxReady of them to ready and returns how many were written, or -1 on error.
+  int SRTPoller::wait(SRTSOCKET *ready, int maxReady, int64_t timeoutMs){
+    if (eid == -1){return -1;}
+    int readyCount = maxReady;
+    if (srt_epoll_wait(eid, ready, &readyCount, 0, 0, timeoutMs, 0, 0, 0, 0) < 0){
+      if (srt_getlasterror(0) == SRT_ETIMEOUT){return 0;}
+      ERROR_MSG("Error while waiting for SRT sockets: %s", srt_getlasterror_str());
+      return -1;
+    }
+    return readyCount < maxReady ? readyCount : maxReady;
+  }
+
   inline int SocketOption::setSo(int socket, int proto, int sym, const void *data, size_t size, bool isSrtOpt){
     if (isSrtOpt){return srt_setsockopt(socket, 0, SRT_SOCKOPT(sym), data, (int)size);}
     return ::setsockopt(socket, proto, sym, (const char *)data, (int)size);
@@ -34,6 +34,7 @@ namespace Socket{
     void connect(const std::string &_host, int _port, const std::string &_direction = "input",
                  const paramList &_params = paramList());
     void close();
+    void drop(){sock = -1;} ///< Forgets the socket without closing it, for when another owner closes it.
     bool connected() const{return sock != -1;}
     operator bool() const{return connected();}
 
@@ -42,6 +43,7 @@ namespace Socket{
 
     size_t RecvNow();
     size_t Recv();
+    size_t Recv(char *buf, size_t len);
     char recvbuf[5000]; ///< Buffer where received data is stored in
 
     void SendNow(const std::string &data);
@@ -50,6 +52,7 @@ namespace Socket{
     SRTSOCKET getSocket(){return sock;}
 
     int postConfigureSocket();
+    void updateStats();
 
     std::string getStreamName();
 
@@ -110,6 +113,23 @@ namespace Socket{
     std::string direction;
   };
 
+  /// Waits for incoming data on many SRT sockets at once, using srt_epoll.
+  /// Sockets that are closed are removed from the poller automatically by the SRT library.
+  class SRTPoller{
+  public:
+    SRTPoller();
+    ~SRTPoller();
+    operator bool() const{return eid != -1;}
+    bool add(SRTSOCKET sock);
+    void remove(SRTSOCKET sock);
+    int wait(SRTSOCKET *ready, int maxReady, int64_t timeoutMs);
+
+  private:
+    SRTPoller(const SRTPoller &);
+    SRTPoller &operator=(const SRTPoller &);
+    int eid;
+  };
+
   struct OptionValue{
     std::string s;
     int i;
@@ -124,6 +124,7 @@ namespace Database{
       FAIL_MSG("SQL error, unable to create table, %s", errMsg);
       sqlite3_free(errMsg);
     }
+    createRollupTables(db);
   }
 
   std::map<std::string, std::string> getColumn(sqlite3* &db, const std::string &streamname){
@@ -192,6 +193,32 @@ namespace Database{
     return resultData;
   }
 
+  /// Returns the traffic of all feeds in a single query, in the same format as getColumn2, by feed name
+  std::map<std::string, JSON::Value> getAllColumns2(sqlite3* &db){
+    std::map<std::string, JSON::Value> result;
+    if (db == nullptr){
+      FAIL_MSG("SQL error, database connection does not exist");
+      return result;
+    }
+    const std::string query = "SELECT feed_name, user_id, date, hls, ws, ndvr FROM trafficConsumption";
+    sqlite3_stmt* stmt = nullptr;
+    std::lock_guard<std::mutex> lock(Database::mtx);
+    if (sqlite3_prepare_v2(db, query.c_str(), query.length(), &stmt, nullptr) != SQLITE_OK){
+      FAIL_MSG("SQL error, unable to prepare statement, %s", sqlite3_errmsg(db));
+      return result;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+      JSON::Value &data = result[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))]
+                                [reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))]
+                                [reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))];
+      data["hls"] = sqlite3_column_double(stmt, 3);
+      data["ws"] = sqlite3_column_double(stmt, 4);
+      data["ndvr"] = sqlite3_column_double(stmt, 5);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+  }
+
   void injectInDB(sqlite3* &db, const std::string &streamname, const std::string &trafficData){
     if (db == nullptr){
       WARN_MSG("SQL error, database connection does not exist");
@@ -353,4 +380,246 @@ namespace Database{
     }
     return true;
   }
+
+  /// Intervals of the traffic rollup tables, in seconds, by table name
+  static const std::pair<const char *, uint64_t> rollups[] ={
+      std::pair<const char *, uint64_t>("trafficMinute", 60),
+      std::pair<const char *, uint64_t>("trafficHour", 3600),
+      std::pair<const char *, uint64_t>("trafficDay", 86400)};
+  static const size_t rollupCount = 3;
+
+  /// @brief Create the traffic rollup tables, one row per feed, user and time bucket, with byte counters.
+  /// The primary key doubles as the (feed, user, bucket) index; an extra index serves per-user queries.
+  void createRollupTables(sqlite3* &db){
+    if (db == nullptr){
+      FAIL_MSG("SQL error, database connection does not exist");
+      return;
+    }
+    for (size_t i = 0; i < rollupCount; ++i){
+      std::string table = rollups[i].first;
+      runQuery(db, "CREATE TABLE IF NOT EXISTS " + table + "("
+                   "feed_name TEXT NOT NULL,"
+                   "user_id TEXT NOT NULL,"
+                   "bucket INTEGER NOT NULL,"
+                   "hls INTEGER NOT NULL DEFAULT 0,"
+                   "ws INTEGER NOT NULL DEFAULT 0,"
+                   "PRIMARY KEY(feed_name, user_id, bucket)) WITHOUT ROWID;");
+      runQuery(db, "CREATE INDEX IF NOT EXISTS " + table + "_user ON " + table + "(user_id, bucket);");
+    }
+  }
+
+  /// @brief Returns traffic in bytes from a rollup table, as feed name -> bucket start -> {hls, ws}.
+  /// @param interval One of "minute", "hour" or "day". Empty userId or feedName match all.
+  /// Buckets are included if they start at or after \b from and before \b to (unix seconds).
+  JSON::Value getTrafficRollup(sqlite3* &db, const std::string &interval, const std::string &userId,
+                               const std::string &feedName, uint64_t from, uint64_t to){
+    JSON::Value result;
+    if (db == nullptr){
+      FAIL_MSG("SQL error, database connection does not exist");
+      return result;
+    }
+    std::string table;
+    if (interval == "minute"){table = "trafficMinute";}
+    if (interval == "hour"){table = "trafficHour";}
+    if (interval == "day" || interval.empty()){table = "trafficDay";}
+    if (table.empty()){
+      WARN_MSG("Unknown traffic interval: %s", interval.c_str());
+      return result;
+    }
+    std::string query = "SELECT feed_name, bucket, SUM(hls), SUM(ws) FROM " + table + " WHERE bucket >= ? AND bucket < ?";
+    if (userId.size()){query += " AND user_id = ?";}
+    if (feedName.size()){query += " AND feed_name = ?";}
+    query += " GROUP BY feed_name, bucket";
+    sqlite3_stmt* stmt = nullptr;
+    std::lock_guard<std::mutex> lock(Database::mtx);
+    if (sqlite3_prepare_v2(db, query.c_str(), query.length(), &stmt, nullptr) != SQLITE_OK){
+      FAIL_MSG("SQL error, unable to prepare statement, %s", sqlite3_errmsg(db));
+      return result;
+    }
+    int col = 1;
+    sqlite3_bind_int64(stmt, col++, from);
+    sqlite3_bind_int64(stmt, col++, to);
+    if (userId.size()){sqlite3_bind_text(stmt, col++, userId.c_str(), userId.length(), SQLITE_STATIC);}
+    if (feedName.size()){sqlite3_bind_text(stmt, col++, feedName.c_str(), feedName.length(), SQLITE_STATIC);}
+    while (sqlite3_step(stmt) == SQLITE_ROW){
+      JSON::Value &data = result[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))]
+                                [JSON::Value((int64_t)sqlite3_column_int64(stmt, 1)).asString()];
+      data["hls"] = (int64_t)sqlite3_column_int64(stmt, 2);
+      data["ws"] = (int64_t)sqlite3_column_int64(stmt, 3);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+  }
+
+  /// Switches the database to WAL journaling, so flushes do not block readers and need fewer syncs.
+  TrafficWriter::TrafficWriter(sqlite3* &db) : db(db){
+    upsert = nullptr;
+    for (size_t i = 0; i < 3; ++i){rollupUpsert[i] = nullptr;}
+    lastFlushMs = 0;
+    lastFlushRows = 0;
+    totalRows = 0;
+    if (db == nullptr){
+      FAIL_MSG("SQL error, database connection does not exist");
+      return;
+    }
+    runQuery(db, "PRAGMA journal_mode=WAL;");
+    runQuery(db, "PRAGMA synchronous=NORMAL;");
+  }
+
+  TrafficWriter::~TrafficWriter(){
+    std::lock_guard<std::mutex> lock(Database::mtx);
+    if (upsert){sqlite3_finalize(upsert);}
+    for (size_t i = 0; i < rollupCount; ++i){
+      if (rollupUpsert[i]){sqlite3_finalize(rollupUpsert[i]);}
+    }
+  }
+
+  /// Prepares the upsert statements, if not prepared yet. Expects Database::mtx to be locked.
+  bool TrafficWriter::prepare(){
+    if (upsert){return true;}
+    const std::string query = "INSERT INTO trafficConsumption (feed_name, user_id, date, hls, ws, ndvr) VALUES (?, ?, ?, ?, ?, 0) "
+                              "ON CONFLICT(feed_name, user_id, date) DO UPDATE SET hls = excluded.hls, ws = excluded.ws";
+    if (sqlite3_prepare_v2(db, query.c_str(), query.length(), &upsert, nullptr) != SQLITE_OK){
+      FAIL_MSG("SQL error, unable to prepare statement, %s", sqlite3_errmsg(db));
+      upsert = nullptr;
+      return false;
+    }
+    for (size_t i = 0; i < rollupCount; ++i){
+      std::string table = rollups[i].first;
+      const std::string rQuery = "INSERT INTO " + table + " (feed_name, user_id, bucket, hls, ws) VALUES (?, ?, ?, ?, ?) "
+                                 "ON CONFLICT(feed_name, user_id, bucket) DO UPDATE SET hls = hls + excluded.hls, ws = ws + excluded.ws";
+      if (sqlite3_prepare_v2(db, rQuery.c_str(), rQuery.length(), &rollupUpsert[i], nullptr) != SQLITE_OK){
+        FAIL_MSG("SQL error, unable to prepare statement, %s", sqlite3_errmsg(db));
+        rollupUpsert[i] = nullptr;
+      }
+    }
+    return true;
+  }
+
+  /// Returns the row for the given feed, user and date, creating it if needed
+  TrafficWriter::Row &TrafficWriter::getRow(const std::string &feedName, const std::string &userId, const std::string &date){
+    std::string key = feedName;
+    key.append(1, '\0');
+    key.append(userId);
+    key.append(1, '\0');
+    key.append(date);
+    std::map<std::string, Row>::iterator it = rows.find(key);
+    if (it != rows.end()){return it->second;}
+    Row &R = rows[key];
+    R.hls = R.ws = R.flushedHls = R.flushedWs = 0;
+    R.dirty = false;
+    return R;
+  }
+
+  /// Stores the total traffic in bytes of a user on a feed for the given date.
+  /// Marks the row for writing if it changed.
+  void TrafficWriter::set(const std::string &feedName, const std::string &userId, const std::string &date,
+                          uint64_t hlsBytes, uint64_t wsBytes){
+    Row &R = getRow(feedName, userId, date);
+    if (R.hls == hlsBytes && R.ws == wsBytes){return;}
+    R.hls = hlsBytes;
+    R.ws = wsBytes;
+    R.dirty = true;
+  }
+
+  /// Stores the total traffic in bytes of a user on a feed for the given date, as already written.
+  /// Used for totals loaded from the database, so they are not rolled up a second time.
+  void TrafficWriter::seed(const std::string &feedName, const std::string &userId, const std::string &date,
+                           uint64_t hlsBytes, uint64_t wsBytes){
+    Row &R = getRow(feedName, userId, date);
+    R.hls = R.flushedHls = hlsBytes;
+    R.ws = R.flushedWs = wsBytes;
+    R.dirty = false;
+  }
+
+  /// Writes all changed rows in a single transaction, and adds the traffic since the previous flush
+  /// to the current minute, hour and day buckets. Returns the amount of rows written.
+  /// If feeds is given, the written rows are applied to it, in the layout of getAllColumns2(), and
+  /// the names of the feeds that changed are added to changed (if given).
+  size_t TrafficWriter::flush(std::map<std::string, JSON::Value> *feeds, std::set<std::string> *changed){
+    if (db == nullptr){return 0;}
+    uint64_t startTime = Util::getMS();
+    uint64_t now = Util::epoch();
+    size_t written = 0;
+    {
+      std::lock_guard<std::mutex> lock(Database::mtx);
+      if (!prepare()){return 0;}
+      if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        FAIL_MSG("SQL error, unable to start transaction, %s", sqlite3_errmsg(db));
+        return 0;
+      }
+      std::deque<std::map<std::string, Row>::iterator> done;
+      for (std::map<std::string, Row>::iterator it = rows.begin(); it != rows.end(); ++it){
+        Row &R = it->second;
+        if (!R.dirty){continue;}
+        const std::string &key = it->first;
+        size_t userStart = key.find('\0') + 1;
+        size_t dateStart = key.find('\0', userStart) + 1;
+        sqlite3_bind_text(upsert, 1, key.data(), userStart - 1, SQLITE_STATIC);
+        sqlite3_bind_text(upsert, 2, key.data() + userStart, dateStart - userStart - 1, SQLITE_STATIC);
+        sqlite3_bind_text(upsert, 3, key.data() + dateStart, key.size() - dateStart, SQLITE_STATIC);
+        sqlite3_bind_double(upsert, 4, (double)R.hls / TRAFFIC_BYTES_PER_MB);
+        sqlite3_bind_double(upsert, 5, (double)R.ws / TRAFFIC_BYTES_PER_MB);
+        bool ok = (sqlite3_step(upsert) == SQLITE_DONE);
+        if (!ok){FAIL_MSG("SQL error, unable to insert/update data, %s", sqlite3_errmsg(db));}
+        sqlite3_reset(upsert);
+        sqlite3_clear_bindings(upsert);
+        // Counters only go down when they were reset; count everything since then
+        uint64_t hlsDelta = (R.hls >= R.flushedHls) ? R.hls - R.flushedHls : R.hls;
+        uint64_t wsDelta = (R.ws >= R.flushedWs) ? R.ws - R.flushedWs : R.ws;
+        for (size_t i = 0; ok && i < rollupCount && (hlsDelta || wsDelta); ++i){
+          sqlite3_stmt *rUpsert = rollupUpsert[i];
+          if (!rUpsert){continue;}
+          sqlite3_bind_text(rUpsert, 1, key.data(), userStart - 1, SQLITE_STATIC);
+          sqlite3_bind_text(rUpsert, 2, key.data() + userStart, dateStart - userStart - 1, SQLITE_STATIC);
+          sqlite3_bind_int64(rUpsert, 3, now - (now % rollups[i].second));
+          sqlite3_bind_int64(rUpsert, 4, hlsDelta);
+          sqlite3_bind_int64(rUpsert, 5, wsDelta);
+          if (sqlite3_step(rUpsert) != SQLITE_DONE){
+            FAIL_MSG("SQL error, unable to roll up traffic into %s, %s", rollups[i].first, sqlite3_errmsg(db));
+            ok = false;
+          }
+          sqlite3_reset(rUpsert);
+          sqlite3_clear_bindings(rUpsert);
+        }
+        if (ok){done.push_back(it);}
+      }
+      if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        FAIL_MSG("SQL error, unable to commit transaction, %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+      }else{
+        for (std::deque<std::map<std::string, Row>::iterator>::iterator it = done.begin(); it != done.end(); ++it){
+          Row &R = (*it)->second;
+          R.flushedHls = R.hls;
+          R.flushedWs = R.ws;
+          R.dirty = false;
+          if (!feeds){continue;}
+          const std::string &key = (*it)->first;
+          size_t userStart = key.find('\0') + 1;
+          size_t dateStart = key.find('\0', userStart) + 1;
+          std::string feedName = key.substr(0, userStart - 1);
+          JSON::Value &data = (*feeds)[feedName][key.substr(dateStart)][key.substr(userStart, dateStart - userStart - 1)];
+          data["hls"] = (double)R.hls / TRAFFIC_BYTES_PER_MB;
+          data["ws"] = (double)R.ws / TRAFFIC_BYTES_PER_MB;
+          if (!data.isMember("ndvr")){data["ndvr"] = 0.0;}
+          if (changed){changed->insert(feedName);}
+        }
+        written = done.size();
+      }
+    }
+    lastFlushMs = Util::getMS() - startTime;
+    lastFlushRows = written;
+    totalRows += written;
+    if (written){HIGH_MSG("Wrote %zu traffic row(s) to database in %" PRIu64 "ms", written, lastFlushMs);}
+    return written;
+  }
+
+  /// Forgets all known rows, for example at the start of a new day
+  void TrafficWriter::clear(){rows.clear();}
+
+  /// Returns the write rate of the last flush in rows per second
+  double TrafficWriter::getRowsPerSec() const{
+    if (!lastFlushRows){return 0;}
+    return (double)lastFlushRows * 1000 / (lastFlushMs ? lastFlushMs : 1);
+  }
 }// namespace Database
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <chrono>
 #include <utility>
 #include <queue>
+#include <deque>
+#include <set>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
@@ -86,8 +88,51 @@ namespace Database {
 
   std::set<std::string> getUsersFromDB (sqlite3* &db);
   JSON::Value getColumn2 (sqlite3* &db, const std::string &feedName);
+  std::map<std::string, JSON::Value> getAllColumns2 (sqlite3* &db);
+
+  /// @brief Create the minute, hour and day traffic rollup tables.
+  void createRollupTables (sqlite3* &db);
+  JSON::Value getTrafficRollup (sqlite3* &db, const std::string &interval, const std::string &userId,
+                                const std::string &feedName, uint64_t from, uint64_t to);
   bool runQuery (sqlite3* &db, const std::string &query);
 
+  /// @brief Write-behind persistence for the trafficConsumption table.
+  /// Rows are collected with \b set and only written by \b flush if they changed since they were last written.
+  /// Each flush runs as a single transaction using a prepared statement that is kept for the lifetime of the writer.
+  /// The ndvr column is left untouched, so it does not need to be read back before writing.
+  /// The traffic added since the previous flush is also rolled up into the minute, hour and day tables.
+  class TrafficWriter {
+  public:
+    TrafficWriter (sqlite3* &db);
+    ~TrafficWriter ();
+    void set (const std::string &feedName, const std::string &userId, const std::string &date, uint64_t hlsBytes, uint64_t wsBytes);
+    void seed (const std::string &feedName, const std::string &userId, const std::string &date, uint64_t hlsBytes, uint64_t wsBytes);
+    size_t flush (std::map<std::string, JSON::Value> *feeds = 0, std::set<std::string> *changed = 0);
+    void clear ();
+    uint64_t getFlushTime () const {return lastFlushMs;}    ///< Duration of the last flush in milliseconds
+    uint64_t getFlushRows () const {return lastFlushRows;}  ///< Rows written by the last flush
+    uint64_t getTotalRows () const {return totalRows;}      ///< Rows written since the writer was created
+    double getRowsPerSec () const;
+
+  private:
+    struct Row {
+      uint64_t hls;
+      uint64_t ws;
+      uint64_t flushedHls; ///< Value of hls as of the last successful flush
+      uint64_t flushedWs;  ///< Value of ws as of the last successful flush
+      bool dirty;
+    };
+    sqlite3* &db;
+    sqlite3_stmt *upsert;
+    sqlite3_stmt *rollupUpsert[3]; ///< Upserts for the minute, hour and day tables
+    std::map<std::string, Row> rows; ///< Last known values, by feed name, user ID and date
+    uint64_t lastFlushMs;
+    uint64_t lastFlushRows;
+    uint64_t totalRows;
+    bool prepare ();
+    Row &getRow (const std::string &feedName, const std::string &userId, const std::string &date);
+  };
+
 }// namespace Database
 
 #endif // SQL_H
@@ -0,0 +1,195 @@
+#include "traffic.h"
+#include "timing.h"
+#include <string.h>
+
+namespace Traffic{
+  /// FNV-1a hash, continuing from h
+  static uint32_t fnv(const std::string &str, uint32_t h = 2166136261u){
+    for (size_t i = 0; i < str.size(); ++i){h = (h ^ (uint8_t)str[i]) * 16777619u;}
+    return h;
+  }
+
+  /// Hash of stream and user name, never zero
+  static uint32_t keyHash(const std::string &stream, const std::string &user){
+    uint32_t h = fnv(stream) * 16777619u; // zero byte between the names
+    h = fnv(user, h);
+    return h ? h : 1;
+  }
+
+  /// Opens the traffic page. If create is true, the page is created if it does not exist yet.
+  Counters::Counters(bool create){
+    slots = 0;
+    page.init(TRAFFIC_COUNTERS, TRAFFIC_COUNTER_SLOTS * sizeof(Slot), false, false);
+    if (!page.mapped && create){
+      page.init(TRAFFIC_COUNTERS, TRAFFIC_COUNTER_SLOTS * sizeof(Slot), true, false);
+      page.master = false;
+    }
+    if (page.mapped){slots = (Slot *)page.mapped;}
+  }
+
+  Counters::operator bool() const{return slots;}
+
+  /// Replaces the traffic page by a new, empty one.
+  /// Processes that still have the old page open keep counting into it until they reopen.
+  void Counters::recreate(){
+    if (page.mapped){
+      page.master = true;
+      page.close();
+    }
+    page.init(TRAFFIC_COUNTERS, TRAFFIC_COUNTER_SLOTS * sizeof(Slot), true, false);
+    page.master = false;
+    slots = 0;
+    if (!page.mapped){return;}
+    memset(page.mapped, 0, TRAFFIC_COUNTER_SLOTS * sizeof(Slot));
+    slots = (Slot *)page.mapped;
+  }
+
+  /// Returns the slot for the given stream and user, claiming a free one if needed.
+  /// Returns null if the page is full.
+  Slot *Counters::findSlot(const std::string &stream, const std::string &user){
+    if (!slots){return 0;}
+    std::string sName = stream.substr(0, TRAFFIC_NAME_LEN - 1);
+    std::string uName = user.substr(0, TRAFFIC_NAME_LEN - 1);
+    uint32_t h = keyHash(sName, uName);
+    for (size_t i = 0; i < TRAFFIC_COUNTER_SLOTS; ++i){
+      Slot *s = slots + ((h + i) % TRAFFIC_COUNTER_SLOTS);
+      if (!s->hash && __sync_bool_compare_and_swap(&s->hash, 0, h)){
+        memcpy(s->stream, sName.c_str(), sName.size() + 1);
+        memcpy(s->user, uName.c_str(), uName.size() + 1);
+        __sync_synchronize();
+        s->ready = 1;
+        return s;
+      }
+      if (s->hash != h){continue;}
+      // Same hash: wait for the claiming process to finish writing the names, then compare
+      for (size_t tries = 0; !s->ready && tries < 100; ++tries){Util::sleep(1);}
+      if (!s->ready){continue;}
+      __sync_synchronize();
+      if (sName == s->stream && uName == s->user){return s;}
+    }
+    return 0;
+  }
+
+  /// Atomically adds bytes to the counter of the given stream, user and protocol.
+  /// Returns false if no slot could be found or claimed.
+  bool Counters::add(const std::string &stream, const std::string &user, Protocol proto, uint64_t bytes){
+    Slot *s = findSlot(stream, user);
+    if (!s){return false;}
+    if (bytes){__sync_fetch_and_add(&s->bytes[proto], bytes);}
+    return true;
+  }
+
+  size_t Counters::getSlotCount() const{return slots ? TRAFFIC_COUNTER_SLOTS : 0;}
+
+  bool Counters::isUsed(size_t slot) const{return slots[slot].hash && slots[slot].ready;}
+
+  const char *Counters::getStream(size_t slot) const{return slots[slot].stream;}
+
+  const char *Counters::getUser(size_t slot) const{return slots[slot].user;}
+
+  uint64_t Counters::getBytes(size_t slot, Protocol proto) const{return slots[slot].bytes[proto];}
+
+  /// Atomically sets the given counter to zero, returning the value it had.
+  uint64_t Counters::reset(size_t slot, Protocol proto){
+    return __sync_lock_test_and_set(&slots[slot].bytes[proto], 0);
+  }
+
+  Snapshot::Snapshot(){publisher = false;}
+
+  /// Marks the snapshot as closed when the publisher goes away, so readers know to reopen it
+  Snapshot::~Snapshot(){
+    if (publisher && page.mapped){
+      ((SnapshotHeader *)page.mapped)->closed = 1;
+      page.master = true;
+    }
+  }
+
+  /// Maps the snapshot page if not mapped yet, or if the mapped one was closed by its publisher
+  bool Snapshot::open(){
+    if (page.mapped && !((SnapshotHeader *)page.mapped)->closed){return true;}
+    page.init(TRAFFIC_SNAPSHOT, TRAFFIC_SNAPSHOT_SIZE, false, false);
+    return page.mapped && !((SnapshotHeader *)page.mapped)->closed;
+  }
+
+  /// Replaces the published snapshot by the given name/data pairs.
+  /// Entries that do not fit in the page are left out.
+  void Snapshot::publish(const std::map<std::string, std::string> &entries){
+    if (!publisher){
+      page.init(TRAFFIC_SNAPSHOT, TRAFFIC_SNAPSHOT_SIZE, true, false);
+      page.master = false;
+      if (!page.mapped){return;}
+      memset(page.mapped, 0, sizeof(SnapshotHeader));
+      publisher = true;
+    }
+    if (!page.mapped){return;}
+    // Build the new contents locally, so the page is only marked as changing for a single copy
+    std::string data;
+    std::map<uint32_t, uint32_t> buckets;
+    size_t maxData = TRAFFIC_SNAPSHOT_SIZE - sizeof(SnapshotHeader);
+    size_t skipped = 0;
+    for (std::map<std::string, std::string>::const_iterator it = entries.begin(); it != entries.end(); ++it){
+      if (data.size() + 12 + it->first.size() + it->second.size() > maxData){
+        ++skipped;
+        continue;
+      }
+      uint32_t bucket = fnv(it->first) % TRAFFIC_SNAPSHOT_BUCKETS;
+      uint32_t rec[3];
+      rec[0] = buckets.count(bucket) ? buckets[bucket] : 0;
+      rec[1] = it->first.size();
+      rec[2] = it->second.size();
+      buckets[bucket] = data.size() + 1;
+      data.append((char *)rec, 12);
+      data.append(it->first);
+      data.append(it->second);
+    }
+    if (skipped){WARN_MSG("Traffic snapshot page full, left out %zu stream(s)", skipped);}
+
+    SnapshotHeader *H = (SnapshotHeader *)page.mapped;
+    __sync_add_and_fetch(&H->seq, 1);
+    for (size_t i = 0; i < TRAFFIC_SNAPSHOT_BUCKETS; ++i){H->buckets[i] = 0;}
+    for (std::map<uint32_t, uint32_t>::iterator it = buckets.begin(); it != buckets.end(); ++it){
+      H->buckets[it->first] = it->second;
+    }
+    memcpy(page.mapped + sizeof(SnapshotHeader), data.data(), data.size());
+    H->used = data.size();
+    __sync_add_and_fetch(&H->seq, 1);
+  }
+
+  /// Looks up the data published for the given name. Returns false if there is none.
+  bool Snapshot::get(const std::string &name, std::string &data){
+    if (!open()){return false;}
+    SnapshotHeader *H = (SnapshotHeader *)page.mapped;
+    const char *recs = page.mapped + sizeof(SnapshotHeader);
+    uint32_t bucket = fnv(name) % TRAFFIC_SNAPSHOT_BUCKETS;
+    for (size_t tries = 0; tries < 10; ++tries){
+      uint64_t seq = H->seq;
+      if (seq & 1){
+        Util::sleep(1);
+        continue;
+      }
+      __sync_synchronize();
+      bool found = false;
+      uint32_t used = H->used;
+      uint32_t off = H->buckets[bucket];
+      // Bounds are checked against used, since a concurrent rewrite may leave torn offsets behind.
+      // Records only link to records written before them, so a valid chain strictly moves back;
+      // anything else is torn, and the sequence check below retries the lookup.
+      while (off && off - 1 + 12 <= used){
+        uint32_t rec[3];
+        memcpy(rec, recs + off - 1, 12);
+        uint32_t next = rec[0], nameLen = rec[1], dataLen = rec[2];
+        if (off - 1 + 12 + (uint64_t)nameLen + dataLen > used){break;}
+        if (next >= off){break;}
+        if (nameLen == name.size() && !memcmp(recs + off - 1 + 12, name.data(), nameLen)){
+          data.assign(recs + off - 1 + 12 + nameLen, dataLen);
+          found = true;
+          break;
+        }
+        off = next;
+      }
+      __sync_synchronize();
+      if (H->seq == seq){return found;}
+    }
+    return false;
+  }
+}// namespace Traffic
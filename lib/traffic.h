@@ -0,0 +1,67 @@
+#pragma once
+#include "defines.h"
+#include "shared_memory.h"
+#include <map>
+#include <stdint.h>
+#include <string>
+
+namespace Traffic{
+  /// Protocols traffic is counted for, in slot counter order
+  enum Protocol{HLS = 0, WS, PROTOCOL_COUNT};
+
+  /// A single counter slot in the traffic page, keyed by stream and user name.
+  /// Slots are claimed once by compare-and-swap on the hash and never released while the page exists.
+  struct Slot{
+    volatile uint32_t hash;  ///< Hash of stream and user name, zero if the slot is free
+    volatile uint32_t ready; ///< Non-zero once the names have been written
+    char stream[TRAFFIC_NAME_LEN];
+    char user[TRAFFIC_NAME_LEN];
+    volatile uint64_t bytes[PROTOCOL_COUNT]; ///< Total bytes per protocol
+  };
+
+  /// Lock-free byte counters per stream, user and protocol, shared between all processes.
+  /// Updates are atomic additions on 64-bit counters; no semaphore is needed to write or read.
+  class Counters{
+  public:
+    Counters(bool create = false);
+    operator bool() const;
+    void recreate();
+    bool add(const std::string &stream, const std::string &user, Protocol proto, uint64_t bytes);
+    size_t getSlotCount() const;
+    bool isUsed(size_t slot) const;
+    const char *getStream(size_t slot) const;
+    const char *getUser(size_t slot) const;
+    uint64_t getBytes(size_t slot, Protocol proto) const;
+    uint64_t reset(size_t slot, Protocol proto);
+
+  private:
+    IPC::sharedPage page;
+    Slot *slots;
+    Slot *findSlot(const std::string &stream, const std::string &user);
+  };
+
+  /// Header of the traffic snapshot page, followed by the records.
+  /// Each record is a uint32 next offset, uint32 name length, uint32 data length, the name and the data.
+  /// Offsets are relative to the end of the header, plus one; zero means none.
+  struct SnapshotHeader{
+    volatile uint64_t seq;    ///< Odd while the snapshot is being rewritten
+    volatile uint32_t closed; ///< Set when the publisher is gone; readers should reopen the page
+    volatile uint32_t used;   ///< Bytes in use after the header
+    volatile uint32_t buckets[TRAFFIC_SNAPSHOT_BUCKETS]; ///< Offset of the first record per name hash
+  };
+
+  /// Read-only snapshot of the traffic totals per stream, published by the controller.
+  /// Readers keep the page mapped, so looking up a stream does not need any system calls.
+  class Snapshot{
+  public:
+    Snapshot();
+    ~Snapshot();
+    void publish(const std::map<std::string, std::string> &entries);
+    bool get(const std::string &name, std::string &data);
+
+  private:
+    IPC::sharedPage page;
+    bool publisher;
+    bool open();
+  };
+}// namespace Traffic
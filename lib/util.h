@@ -67,6 +67,50 @@ namespace Util{
     size_t maxSize;
   };
 
+  /// Fixed-size lock-free queue between exactly one producer and one consumer thread.
+  /// Slots are used in place: the producer fills back() and calls push(), the consumer reads front() and calls pop().
+  template <class T> class SPSCQueue{
+  public:
+    SPSCQueue(size_t slots){
+      size = slots;
+      items = new T[size];
+      head = 0;
+      tail = 0;
+    }
+    ~SPSCQueue(){delete[] items;}
+    /// Returns the slot to fill next, or null if the queue is full. Producer only.
+    T *back(){
+      if (head - tail >= size){return 0;}
+      return items + (head % size);
+    }
+    /// Makes the slot returned by back() available to the consumer. Producer only.
+    void push(){
+      __sync_synchronize();
+      ++head;
+    }
+    /// Returns the oldest filled slot, or null if the queue is empty. Consumer only.
+    T *front(){
+      if (tail == head){return 0;}
+      __sync_synchronize();
+      return items + (tail % size);
+    }
+    /// Hands the slot returned by front() back to the producer. Consumer only.
+    void pop(){
+      __sync_synchronize();
+      ++tail;
+    }
+    /// Returns true if the consumer has handed back every slot pushed so far. Either side.
+    bool empty() const{return tail == head;}
+
+  private:
+    SPSCQueue(const SPSCQueue &);
+    SPSCQueue &operator=(const SPSCQueue &);
+    T *items;
+    size_t size;
+    volatile size_t head; ///< Total slots pushed, only written by the producer
+    volatile size_t tail; ///< Total slots popped, only written by the consumer
+  };
+
   void logParser(int in, int out, bool colored,
                  void callback(const std::string &, const std::string &, const std::string &, uint64_t, bool) = 0);
   void redirectLogsIfNeeded();
@@ -226,4 +270,42 @@ namespace Util{
     RelAccX *src;
     RelAccXFieldData field;
   };
+
+  /// Name, type and (max) length of a single RelAccX field, as declared in a RelAccXSchema.
+  struct RelAccXFieldDef{
+    const char *name;
+    uint8_t type;
+    uint32_t len;
+  };
+
+  /// Fixed list of N fields for a RelAccX-backed structure, declared once as a static array of
+  /// RelAccXFieldDef indexed by an enum.
+  /// The field handles are resolved once when attaching to (or creating) a structure, after which
+  /// fields are accessed by enum value: an array index instead of a std::map string lookup.
+  /// String lookups on the RelAccX itself remain available for dynamic and debug access.
+  template <size_t N> class RelAccXSchema{
+  public:
+    RelAccXSchema(const RelAccXFieldDef *_defs) : defs(_defs){}
+    /// Adds all fields to a new structure, then resolves their handles.
+    void create(RelAccX &src){
+      for (size_t i = 0; i < N; ++i){src.addField(defs[i].name, defs[i].type, defs[i].len);}
+      attach(src);
+    }
+    /// Resolves the field handles for an existing structure.
+    /// Returns false if any field is missing; those have type zero and read as zero.
+    bool attach(const RelAccX &src){
+      bool ret = true;
+      for (size_t i = 0; i < N; ++i){
+        handles[i] = src.getFieldData(defs[i].name);
+        if (!handles[i].type){ret = false;}
+      }
+      return ret;
+    }
+    const RelAccXFieldData &operator[](size_t field) const{return handles[field];}
+    const char *getName(size_t field) const{return defs[field].name;}
+
+  private:
+    const RelAccXFieldDef *defs;
+    RelAccXFieldData handles[N];
+  };
 }// namespace Util
@@ -0,0 +1,58 @@
+/// \file bench_fec.cpp
+/// Measures the XOR kernels used for FEC, and Pro-MPEG FEC generation as done for TS over RTP.
+/// Usage: MistBenchFEC [packets per run, default 1000000]
+#include <mist/rtp.h>
+#include <mist/socket.h>
+#include <mist/timing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Seven TS packets per RTP packet, plus the 8 byte FEC bitstring header
+#define BENCH_FEC_PAYLOAD 1316
+
+/// XORs total packets into an accumulator with the current kernel.
+/// Returns the throughput in GB/s.
+static double runXOR(uint64_t total){
+  std::vector<uint8_t> acc(BENCH_FEC_PAYLOAD + 8, 0);
+  std::vector<uint8_t> in(acc.size(), 0x5A);
+  uint64_t start = Util::getMicros();
+  for (uint64_t i = 0; i < total; ++i){RTP::xorBuffer(&acc[0], &in[0], &acc[0], acc.size());}
+  uint64_t took = Util::getMicros(start);
+  return (double)total * acc.size() / 1000 / (took ? took : 1);
+}
+
+/// Generates row and column FEC for total packets in a rows x columns matrix.
+/// FEC packets are sent to the discard port on localhost. Returns thousands of media packets per second.
+static double runFEC(uint64_t total, uint8_t rows, uint8_t columns){
+  Socket::UDPConnection colSock, rowSock;
+  colSock.SetDestination("127.0.0.1", 9);
+  rowSock.SetDestination("127.0.0.1", 9);
+  std::vector<char> payload(BENCH_FEC_PAYLOAD, 0x47);
+  RTP::Packet pkt(33, 1, 0, 0);
+  pkt.configureFEC(rows, columns);
+  uint64_t bytesSent = 0;
+  uint64_t start = Util::getMicros();
+  for (uint64_t i = 0; i < total; ++i){
+    payload[4] = (char)i;
+    pkt.parseFEC(&colSock, &rowSock, bytesSent, &payload[0], payload.size());
+    pkt.increaseSequence();
+  }
+  uint64_t took = Util::getMicros(start);
+  return (double)total * 1000 / (took ? took : 1);
+}
+
+int main(int argc, char **argv){
+  uint64_t total = argc > 1 ? atoll(argv[1]) : 1000000;
+
+  const char *kernels[] = {"scalar", "SSE2", "AVX2"};
+  for (size_t k = 0; k < 3; ++k){
+    if (!RTP::setXORKernel(kernels[k])){
+      printf("%-6s  not supported here\n", kernels[k]);
+      continue;
+    }
+    printf("%-6s  XOR %6.2f GB/s  FEC 10x10 %6.0f kpkt/s  FEC 5x20 %6.0f kpkt/s\n", kernels[k],
+           runXOR(total * 10), runFEC(total, 10, 10), runFEC(total, 5, 20));
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+/// \file bench_g711.cpp
+/// Measures G.711 decoding throughput for every decode kernel this CPU can run.
+/// Usage: MistBenchG711 [megasamples per run, default 64]
+#include <mist/g711.h>
+#include <mist/timing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/// Decodes the input with the current kernel until total samples are done.
+/// Returns the throughput in millions of samples per second.
+static double run(G711::Codec codec, const std::vector<char> &in, std::vector<int16_t> &out, uint64_t total){
+  uint64_t start = Util::getMicros();
+  for (uint64_t done = 0; done < total; done += in.size()){
+    G711::decode(codec, &in[0], &out[0], in.size());
+  }
+  uint64_t took = Util::getMicros(start);
+  return (double)total / (took ? took : 1);
+}
+
+/// Returns true if the current kernel matches the reference tables for all 256 inputs
+static bool verify(){
+  char in[256];
+  int16_t out[256];
+  for (size_t i = 0; i < 256; ++i){in[i] = (char)i;}
+  G711::decode(G711::ALAW, in, out, 256);
+  for (size_t i = 0; i < 256; ++i){
+    if (out[i] != G711::alawToPcm(i)){return false;}
+  }
+  G711::decode(G711::ULAW, in, out, 256);
+  for (size_t i = 0; i < 256; ++i){
+    if (out[i] != G711::ulawToPcm(i)){return false;}
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  uint64_t total = (argc > 1 ? atoll(argv[1]) : 64) * 1000000;
+  // 20ms of 8kHz audio per RTP packet is 160 samples; decode in batches of a few packets
+  std::vector<char> in(1280);
+  std::vector<int16_t> out(in.size());
+  uint32_t seed = 0x12345678;
+  for (size_t i = 0; i < in.size(); ++i){
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    in[i] = (char)seed;
+  }
+
+  const char *kernels[] = {"scalar", "SSE2", "AVX2"};
+  for (size_t k = 0; k < 3; ++k){
+    if (!G711::setKernel(kernels[k])){
+      printf("%-6s  not supported here\n", kernels[k]);
+      continue;
+    }
+    if (!verify()){
+      printf("%-6s  MISMATCH against the reference tables\n", kernels[k]);
+      return 1;
+    }
+    double alaw = run(G711::ALAW, in, out, total);
+    double ulaw = run(G711::ULAW, in, out, total);
+    printf("%-6s  A-law %8.1f Msamples/s  mu-law %8.1f Msamples/s\n", kernels[k], alaw, ulaw);
+  }
+  return 0;
+}
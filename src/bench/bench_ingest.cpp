@@ -0,0 +1,75 @@
+/// \file bench_ingest.cpp
+/// Measures live packet ingest into shared data pages: building an intermediate DTSC::Packet and
+/// buffering that, against reserving room on the page and writing the payload there directly.
+/// Usage: MistBenchIngest [megabytes per run, default 256]
+#include "../io.h"
+#include <mist/bitfields.h>
+#include <mist/timing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#define BENCH_FRAMES_PER_KEY 50
+#define BENCH_FRAME_MS 40
+
+/// Ingests into a throwaway live stream, one fresh track per run
+class IngestBench : public Mist::InOutBase{
+public:
+  IngestBench(){
+    char name[64];
+    snprintf(name, sizeof(name), "benchingest%d", (int)getpid());
+    streamName = name;
+    meta.reInit(streamName, true);
+  }
+
+  /// Buffers total bytes of payloadSize byte packets and returns the throughput in MB/s.
+  /// If direct is false, every packet is first built as a DTSC::Packet, as parsers did before.
+  double run(uint64_t total, size_t payloadSize, bool direct){
+    size_t idx = meta.addTrack();
+    meta.setType(idx, "video");
+    meta.setCodec(idx, "H264");
+    meta.setID(idx, idx + 1);
+    // A single NAL unit with a 4-byte size prefix, as H264 packets are stored
+    std::vector<char> payload(payloadSize, 0x5A);
+    Bit::htobl(&payload[0], payloadSize - 4);
+    payload[4] = 0x65;
+    DTSC::Packet pkt;
+    uint64_t count = total / payloadSize;
+    uint64_t start = Util::getMicros();
+    for (uint64_t i = 0; i < count; ++i){
+      // Stands in for the parser producing the payload, e.g. reassembling a NAL unit
+      payload[5] = (char)i;
+      uint64_t time = i * BENCH_FRAME_MS;
+      bool key = !(i % BENCH_FRAMES_PER_KEY);
+      if (direct){
+        char *dest = bufferLiveReserve(time, 0, idx, payloadSize, 0, key, meta);
+        if (!dest){continue;}
+        memcpy(dest, &payload[0], payloadSize);
+        bufferCommit(payloadSize);
+      }else{
+        pkt.genericFill(time, 0, idx + 1, &payload[0], payloadSize, 0, key);
+        bufferLivePacket(pkt);
+      }
+    }
+    uint64_t took = Util::getMicros(start);
+    liveFinalize(idx);
+    // Unlinks the data pages, so every run starts from the same amount of free memory
+    meta.removeTrack(idx);
+    return (double)count * payloadSize / (took ? took : 1);
+  }
+};
+
+int main(int argc, char **argv){
+  uint64_t total = (argc > 1 ? atoll(argv[1]) : 256) * 1024 * 1024;
+  IngestBench bench;
+  // A TS over RTP packet, and a reassembled video frame
+  const size_t sizes[] = {1316, 16384};
+  for (size_t s = 0; s < 2; ++s){
+    double viaPacket = bench.run(total, sizes[s], false);
+    double direct = bench.run(total, sizes[s], true);
+    printf("payload %5zub  via DTSC::Packet %7.0f MB/s  direct to page %7.0f MB/s\n", sizes[s], viaPacket, direct);
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+/// \file bench_relaccx.cpp
+/// Measures RelAccX field access by name against access through handles resolved once on attach,
+/// for the DTSC data page records and for Comms-style connection statistics.
+/// Usage: MistBenchRelAccX [operations per run, default 5000000]
+#include <mist/comms.h>
+#include <mist/dtsc.h>
+#include <mist/timing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define BENCH_PAGES 64
+#define BENCH_KEYS_PER_PAGE 10
+#define BENCH_CONNECTIONS 1000
+
+/// Fields of the connection records, as Comms::Connections creates them, indexed by connField
+enum connField{CONN_STATUS, CONN_NOW, CONN_TIME, CONN_LASTSECOND, CONN_DOWN, CONN_UP, CONN_PKTCOUNT, CONN_FIELDS};
+static const Util::RelAccXFieldDef connFieldDefs[CONN_FIELDS] ={
+    {"status", RAX_UINT, 0},     {"now", RAX_64UINT, 0}, {"time", RAX_64UINT, 0},
+    {"lastsecond", RAX_64UINT, 0}, {"down", RAX_64UINT, 0}, {"up", RAX_64UINT, 0},
+    {"pktcount", RAX_64UINT, 0}};
+
+/// Creates a structure with the given schema in a heap buffer, with room for records records
+template <size_t N>
+static Util::RelAccX create(std::vector<char> &buf, Util::RelAccXSchema<N> &schema, size_t records){
+  buf.assign(4096, 0);
+  Util::RelAccX A(&buf[0], false);
+  schema.create(A);
+  size_t needed = A.getOffset() + A.getRSize() * records;
+  buf.resize(needed, 0);
+  A = Util::RelAccX(&buf[0], false);
+  schema.attach(A);
+  A.setRCount(records);
+  A.setEndPos(records);
+  A.setReady();
+  return A;
+}
+
+/// Runs total iterations of the page lookup done for every buffered packet: find the page holding
+/// a key by searching backwards from the last page, then read and update its fill level.
+#define BENCH_PAGES_LOOP(FIELD)                                                                    \
+  for (uint64_t i = 0; i < total; ++i){                                                            \
+    uint32_t key = (uint32_t)(i % (BENCH_PAGES * BENCH_KEYS_PER_PAGE));                            \
+    size_t p = BENCH_PAGES;                                                                        \
+    while (p && pages.getInt(FIELD(DTSC::PAGE_FIRSTKEY, "firstkey"), p - 1) > key){--p;}           \
+    if (!p){continue;}                                                                             \
+    --p;                                                                                           \
+    uint64_t avail = pages.getInt(FIELD(DTSC::PAGE_AVAIL, "avail"), p);                            \
+    if (avail + 100 > pages.getInt(FIELD(DTSC::PAGE_SIZE, "size"), p)){avail = 0;}                 \
+    pages.setInt(FIELD(DTSC::PAGE_AVAIL, "avail"), avail + 100, p);                                \
+  }
+
+/// Runs total iterations of the per-connection statistics update done by every output
+#define BENCH_CONNS_LOOP(FIELD)                                                                    \
+  for (uint64_t i = 0; i < total; ++i){                                                            \
+    size_t c = i % BENCH_CONNECTIONS;                                                              \
+    if (!conns.getInt(FIELD(CONN_STATUS, "status"), c)){continue;}                                 \
+    conns.setInt(FIELD(CONN_NOW, "now"), i, c);                                                    \
+    conns.setInt(FIELD(CONN_TIME, "time"), i / 1000, c);                                           \
+    conns.setInt(FIELD(CONN_DOWN, "down"), conns.getInt(FIELD(CONN_DOWN, "down"), c) + 1316, c);   \
+    conns.setInt(FIELD(CONN_UP, "up"), conns.getInt(FIELD(CONN_UP, "up"), c) + 40, c);             \
+    conns.setInt(FIELD(CONN_PKTCOUNT, "pktcount"), conns.getInt(FIELD(CONN_PKTCOUNT, "pktcount"), c) + 1, c); \
+  }
+
+#define BY_NAME(field, name) name
+#define BY_PAGE_HANDLE(field, name) P[field]
+#define BY_CONN_HANDLE(field, name) C[field]
+
+/// Prints the operations per second for both variants of one workload
+static void report(const char *name, uint64_t total, uint64_t byName, uint64_t byHandle){
+  printf("%-12s by name %8.2f Mops/s  by handle %8.2f Mops/s  (%.1fx)\n", name,
+         (double)total / (byName ? byName : 1), (double)total / (byHandle ? byHandle : 1),
+         (double)byName / (byHandle ? byHandle : 1));
+}
+
+int main(int argc, char **argv){
+  uint64_t total = argc > 1 ? atoll(argv[1]) : 5000000;
+
+  std::vector<char> pageBuf;
+  DTSC::PageSchema P(DTSC::pageFieldDefs);
+  Util::RelAccX pages = create(pageBuf, P, BENCH_PAGES);
+  for (size_t p = 0; p < BENCH_PAGES; ++p){
+    pages.setInt(P[DTSC::PAGE_FIRSTKEY], p * BENCH_KEYS_PER_PAGE, p);
+    pages.setInt(P[DTSC::PAGE_KEYCOUNT], BENCH_KEYS_PER_PAGE, p);
+    pages.setInt(P[DTSC::PAGE_SIZE], 25 * 1024 * 1024, p);
+  }
+
+  std::vector<char> connBuf;
+  Util::RelAccXSchema<CONN_FIELDS> C(connFieldDefs);
+  Util::RelAccX conns = create(connBuf, C, BENCH_CONNECTIONS);
+  for (size_t c = 0; c < BENCH_CONNECTIONS; ++c){conns.setInt(C[CONN_STATUS], COMM_STATUS_ACTIVE, c);}
+
+  uint64_t start = Util::getMicros();
+  BENCH_PAGES_LOOP(BY_NAME);
+  uint64_t byName = Util::getMicros(start);
+  start = Util::getMicros();
+  BENCH_PAGES_LOOP(BY_PAGE_HANDLE);
+  report("meta pages", total, byName, Util::getMicros(start));
+
+  start = Util::getMicros();
+  BENCH_CONNS_LOOP(BY_NAME);
+  byName = Util::getMicros(start);
+  start = Util::getMicros();
+  BENCH_CONNS_LOOP(BY_CONN_HANDLE);
+  report("comms stats", total, byName, Util::getMicros(start));
+  return 0;
+}
@@ -0,0 +1,88 @@
+/// \file bench_seek.cpp
+/// Measures DTSC::Meta key, fragment and page lookups on a VoD track with many keys.
+/// Usage: MistBenchSeek [key count, default 50000]
+#include <mist/dtsc.h>
+#include <mist/timing.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_FRAMES_PER_KEY 50
+#define BENCH_FRAME_MS 40
+#define BENCH_KEYS_PER_PAGE 100
+#ifndef BENCH_LOOKUPS
+#define BENCH_LOOKUPS 1000000
+#endif
+
+static uint32_t seed = 0x12345678;
+static uint32_t nextRandom(){
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/// Times BENCH_LOOKUPS calls of one lookup over the given inputs, prints lookups per second.
+#define BENCH_LOOKUP(name, call)                                                                   \
+  {                                                                                                \
+    uint64_t start = Util::getMicros();                                                            \
+    for (size_t i = 0; i < BENCH_LOOKUPS; ++i){                                                    \
+      uint64_t in = inputs[i];                                                                     \
+      sink += call;                                                                                \
+    }                                                                                              \
+    uint64_t took = Util::getMicros(start);                                                        \
+    printf("%-24s %10.0f lookups/s\n", name, (double)BENCH_LOOKUPS * 1000000 / (took ? took : 1)); \
+  }
+
+int main(int argc, char **argv){
+  size_t keyCount = argc > 1 ? atoll(argv[1]) : 50000;
+  size_t pageCount = keyCount / BENCH_KEYS_PER_PAGE + 1;
+
+  uint64_t setupStart = Util::getMicros();
+  DTSC::Meta M;
+  size_t idx = M.addTrack(keyCount + 16, keyCount + 16, keyCount * BENCH_FRAMES_PER_KEY + 16, pageCount + 16);
+  M.setType(idx, "video");
+  M.setCodec(idx, "H264");
+  M.setVod(true);
+  uint64_t time = 0;
+  uint64_t bpos = 0;
+  for (size_t k = 0; k < keyCount; ++k){
+    for (size_t f = 0; f < BENCH_FRAMES_PER_KEY; ++f){
+      M.update(time, 0, idx, 1000, bpos, f == 0);
+      time += BENCH_FRAME_MS;
+      bpos += 1000;
+    }
+  }
+  // Fixed size pages, as an input would create them for a VoD file
+  Util::RelAccX &pages = M.pages(idx);
+  for (size_t p = 0; p < pageCount; ++p){
+    size_t firstKey = p * BENCH_KEYS_PER_PAGE;
+    pages.setInt("firstkey", firstKey, p);
+    pages.setInt("keycount", BENCH_KEYS_PER_PAGE, p);
+    pages.setInt("firsttime", firstKey * BENCH_FRAMES_PER_KEY * BENCH_FRAME_MS, p);
+    pages.setInt("size", 1, p);
+    pages.setInt("avail", 1, p);
+  }
+  pages.addRecords(pageCount);
+  printf("%zu keys, %zu fragments, %zu pages, %" PRIu64 "ms of media, set up in %" PRIu64 "ms\n", keyCount,
+         (size_t)M.fragments(idx).getEndPos(), pageCount, M.getLastms(idx), Util::getMicros(setupStart) / 1000);
+
+  std::vector<uint64_t> times(BENCH_LOOKUPS);
+  std::vector<uint64_t> keys(BENCH_LOOKUPS);
+  for (size_t i = 0; i < BENCH_LOOKUPS; ++i){
+    times[i] = nextRandom() % M.getLastms(idx);
+    keys[i] = nextRandom() % keyCount;
+  }
+
+  uint64_t sink = 0;
+  const uint64_t *inputs = &times[0];
+  BENCH_LOOKUP("getKeyNumForTime", M.getKeyNumForTime(idx, in));
+  BENCH_LOOKUP("getKeyIndexForTime", M.getKeyIndexForTime(idx, in));
+  BENCH_LOOKUP("getFragmentIndexForTime", M.getFragmentIndexForTime(idx, in));
+  BENCH_LOOKUP("getPageNumberForTime", M.getPageNumberForTime(idx, in));
+  inputs = &keys[0];
+  BENCH_LOOKUP("getPageNumberForKey", M.getPageNumberForKey(idx, in));
+  BENCH_LOOKUP("nextPageAvailable", M.nextPageAvailable(idx, (in / BENCH_KEYS_PER_PAGE) * BENCH_KEYS_PER_PAGE));
+  return sink == 42 ? 1 : 0;
+}
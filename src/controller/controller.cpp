@@ -15,6 +15,7 @@
 #include <mist/auth.h>
 #include <mist/config.h>
 #include <mist/defines.h>
+#include <mist/dtsc.h>
 #include <mist/http_parser.h>
 #include <mist/procs.h>
 #include <mist/shared_memory.h>
@@ -31,6 +32,8 @@
 #include <sys/wait.h>
 #include <vector>
 #include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <unistd.h>
 /*LTS-START*/
 #include <mist/triggers.h>
@@ -108,31 +111,98 @@ void nukeStream(const std::string &streamName){
   Util::Procs::StartPiped(command, &stdIn, &stdOut, &stdErr);
 }
 
-bool checkStreamHealth(std::string &streamName, std::string &streamSource){
-  if (streamSource.substr(0, 7) != "rtsp://"){
-    // We do not check for input sources other than rtsp
-    return true;
-  }
-  std::string cmdString = "ps aux | grep " + streamName;
-  const char* cmdStringCStr = cmdString.c_str();
-  char* cmd[] = {"/bin/bash", "-c", const_cast<char*>(cmdStringCStr), nullptr};
-  std::string cmdOutput = Util::Procs::getOutputOf(cmd);
-  uint8_t countMistInRTSP = 0;
-  uint8_t countMistInBuffer = 0;
-  // Split cmdOutput into lines
-  std::istringstream iss(cmdOutput);
-  std::string line;
-  std::string rtspMatchString = "MistInRTSP -s " + streamName;
-  std::string bufferMatchString = "MistInBuffer -s " + streamName;
-  while (std::getline(iss, line)){
-    DEVEL_MSG("[RTMPServer] %s", line.c_str());
-    if (line.find(rtspMatchString) != std::string::npos){
-      countMistInRTSP++;
-    } else if (line.find(bufferMatchString) != std::string::npos){
-      countMistInBuffer++;
-    }
-  }
-  return (countMistInRTSP == 2 && countMistInBuffer == 2);
+#define STREAM_HEALTH_INTERVAL 5   // Seconds between stream health checks
+#define STREAM_HEALTH_STALE_MS 10000 // Time without new packets after which a ready stream counts as stalled
+#define STREAM_HEALTH_NUKE_MS 20000  // Time a stream must be unhealthy for before it is restarted
+#define STREAM_HEALTH_RESTART_MS 30000 // Time a restarted stream gets to come back up before it is checked again
+
+/// Reads the PID stored in the given per-stream PID page, or 0 if there is none
+static uint64_t getStreamPid(const char *pagePattern, const std::string &streamName){
+  char pageName[NAME_BUFFER_SIZE];
+  snprintf(pageName, NAME_BUFFER_SIZE, pagePattern, streamName.c_str());
+  IPC::sharedPage pidPage(pageName, 8, false, false);
+  if (!pidPage){return 0;}
+  return *(uint64_t *)(pidPage.mapped);
+}
+
+/// Checks if the given PID is alive and running the given binary.
+/// The executable name is read from /proc, so a recycled PID is not mistaken for our process.
+/// Without /proc, only checks if the process is alive.
+static bool isProcessOf(uint64_t pid, const char *binary){
+  static bool hasProc = !access("/proc/self/cmdline", R_OK);
+  if (pid < 2){return false;}
+  if (!hasProc){return Util::Procs::isRunning(pid);}
+  char path[40];
+  snprintf(path, 40, "/proc/%" PRIu64 "/cmdline", pid);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1){return false;}
+  char cmd[256];
+  ssize_t len = read(fd, cmd, sizeof(cmd) - 1);
+  close(fd);
+  if (len <= 0){return false;}
+  cmd[len] = 0;
+  // cmdline is NUL-separated; the first entry is the (path to the) executable
+  const char *exe = strrchr(cmd, '/');
+  return !strcmp(exe ? exe + 1 : cmd, binary);
+}
+
+/// State kept between health checks of a single stream
+struct StreamHealthState{
+  StreamHealthState(){
+    meta = 0;
+    bufferPid = 0;
+    generation = 0;
+    lastChange = 0;
+    unhealthySince = 0;
+    skipUntil = 0;
+  }
+  ~StreamHealthState(){closeMeta();}
+  void closeMeta(){
+    delete meta;
+    meta = 0;
+    bufferPid = 0;
+  }
+  DTSC::Meta *meta;       ///< Kept open for as long as the same buffer process runs
+  uint64_t bufferPid;     ///< Buffer process meta was opened for
+  uint32_t generation;    ///< Last seen meta update generation
+  uint64_t lastChange;    ///< Util::bootMS() of the last seen change in generation
+  uint64_t unhealthySince; ///< Util::bootMS() of the first failed check in a row, or 0
+  uint64_t skipUntil;     ///< Checks are skipped until this Util::bootMS(), after a restart
+
+private:
+  // Owns meta; copying would delete it twice
+  StreamHealthState(const StreamHealthState &);
+  StreamHealthState &operator=(const StreamHealthState &);
+};
+
+/// Checks if an RTSP stream has both its pull input and buffer running, and is receiving data.
+/// Only looks at shared memory pages and /proc, so it is cheap enough to run often for many streams.
+bool checkStreamHealth(const std::string &streamName, StreamHealthState &H, uint64_t now){
+  if (Util::getStreamStatus(streamName) != STRMSTAT_READY){
+    H.closeMeta();
+    return false;
+  }
+  uint64_t bufferPid = getStreamPid(SHM_STREAM_IPID, streamName);
+  if (!isProcessOf(bufferPid, "MistInBuffer") || !isProcessOf(getStreamPid(SHM_STREAM_PPID, streamName), "MistInRTSP")){
+    H.closeMeta();
+    return false;
+  }
+  // (Re)open the metadata when the buffer has been replaced, or has gone away
+  if (!H.meta || H.bufferPid != bufferPid || !*H.meta){
+    H.closeMeta();
+    H.meta = new DTSC::Meta(streamName, false, false);
+    H.bufferPid = bufferPid;
+    H.generation = H.meta->getUpdateGeneration();
+    H.lastChange = now;
+    return *H.meta;
+  }
+  // The update generation changes with every buffered packet
+  uint32_t generation = H.meta->getUpdateGeneration();
+  if (generation != H.generation){
+    H.generation = generation;
+    H.lastChange = now;
+  }
+  return now - H.lastChange < STREAM_HEALTH_STALE_MS;
 }
 
 void streamHealth(void *np){
@@ -140,37 +210,46 @@ void streamHealth(void *np){
     pthread_setname_np(pthread_self(), "streamHealthMon");
   #endif
   /*
-    A thread which runs every 20 minutes,
-      - checks if there are not exactly (i.e. invalid state) 2 MistInRTSP and 2 MistInBuffer running for every always on stream in the config.
-      - maintains a memory of streams that were not running during the previous check as well.
-      - nukes those repeatedly invalid streams one-by-one.
+    A thread which runs every few seconds,
+      - checks if every always on RTSP stream in the config has its input and buffer running, and is receiving data.
+      - restarts streams that have been unhealthy for a while.
+      - gives restarted streams time to come back up before checking them again.
   */
+  std::map<std::string, StreamHealthState> states;
   while (Controller::conf.is_active){
-    // Check every ~20 minutes
-    Controller::sleepInSteps(1800);
-    static std::unordered_set<std::string> reCheckList;
-    static std::vector<std::string> nukeList;
-    JSON::Value allStreams = Controller::Storage["streams"];
-    jsonForEach(allStreams, jit){
-      if (!Controller::conf.is_active){return;}
-      // Check if this stream has an RTSP source
-      if (!(*jit).isMember("source") ||  ((*jit).isMember("source") && (!((*jit)["source"].asString().substr(0, 7) == "rtsp://")))){
+    Controller::sleepInSteps(STREAM_HEALTH_INTERVAL);
+    if (!Controller::conf.is_active){return;}
+    Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
+    uint64_t now = Util::bootMS();
+    std::vector<std::string> nukeList;
+    for (std::set<std::string>::const_iterator strm = config->alwaysOn.begin(); strm != config->alwaysOn.end(); ++strm){
+      // Only always on streams with an RTSP source are checked
+      if (!config->rtspSources.count(*strm)){continue;}
+      const std::string &streamName = *strm;
+      StreamHealthState &H = states[streamName];
+      if (now < H.skipUntil){continue;}
+      if (checkStreamHealth(streamName, H, now)){
+        H.unhealthySince = 0;
         continue;
       }
-      // Check if this stream has always_on set to true
-      if (!(*jit).isMember("always_on") || ((*jit).isMember("always_on") && !(*jit)["always_on"].asBool())){
+      if (!H.unhealthySince){
+        H.unhealthySince = now;
         continue;
       }
-      std::string streamName = jit.key();
-      std::string streamSource = std::string((*jit)["source"]);
-      bool isStreamHealthy = checkStreamHealth(streamName, streamSource);
-      if (!isStreamHealthy){
-        if (reCheckList.find(streamName) == reCheckList.end()){ // 'streamName' not found
-          reCheckList.insert(streamName);
-        }else{ // If found, remove from 'reCheckList' and append in 'nukeList'
-          nukeList.push_back(streamName);
-          reCheckList.erase(streamName);
-        }
+      if (now - H.unhealthySince >= STREAM_HEALTH_NUKE_MS){
+        nukeList.push_back(streamName);
+        H.closeMeta();
+        H.unhealthySince = 0;
+        H.skipUntil = now + STREAM_HEALTH_RESTART_MS;
+      }
+    }
+    // Forget about streams that are no longer configured as always on RTSP streams
+    std::map<std::string, StreamHealthState>::iterator it = states.begin();
+    while (it != states.end()){
+      if (config->alwaysOn.count(it->first) && config->rtspSources.count(it->first)){
+        ++it;
+      }else{
+        states.erase(it++);
       }
     }
 
@@ -180,7 +259,6 @@ void streamHealth(void *np){
       nukeStream(nukeList[i]);
       Util::sleep(10);
     }
-    nukeList.clear();
   }
 }
 
@@ -215,27 +293,71 @@ static unsigned long mix(unsigned long a, unsigned long b, unsigned long c){
   return c;
 }
 
+/// Adds the inodes of all sockets in the given /proc/net table that are bound to one of the given ports.
+/// For TCP tables only listening sockets are considered.
+static void findSocketInodes(const char *table, bool tcp, const std::set<int> &ports, std::set<uint64_t> &inodes){
+  FILE *f = fopen(table, "r");
+  if (!f){return;}
+  char line[512];
+  // Skip the header line
+  if (!fgets(line, sizeof(line), f)){
+    fclose(f);
+    return;
+  }
+  while (fgets(line, sizeof(line), f)){
+    // sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode
+    char local[64];
+    unsigned int state;
+    unsigned long long inode;
+    if (sscanf(line, "%*s %63s %*s %x %*s %*s %*s %*s %*s %llu", local, &state, &inode) != 3){continue;}
+    if (tcp && state != 0x0A){continue;}
+    char *portStr = strrchr(local, ':');
+    if (!portStr || !inode){continue;}
+    if (ports.count(strtol(portStr + 1, 0, 16))){inodes.insert(inode);}
+  }
+  fclose(f);
+}
+
+/// Kills all processes (other than ourselves) that have a socket bound to one of the given ports.
+/// Sockets are looked up in /proc/net and matched to processes through /proc/*/fd, in a single pass over all ports.
 static void killProcessesOnPorts(const std::vector<int>& ports){
-  for (int port : ports){
-    std::stringstream cmd;
-    cmd << "lsof -t -i :" << port;
-    FILE* pipe = popen(cmd.str().c_str(), "r");
+  std::set<int> portSet(ports.begin(), ports.end());
+  std::set<uint64_t> inodes;
+  findSocketInodes("/proc/net/tcp", true, portSet, inodes);
+  findSocketInodes("/proc/net/tcp6", true, portSet, inodes);
+  findSocketInodes("/proc/net/udp", false, portSet, inodes);
+  findSocketInodes("/proc/net/udp6", false, portSet, inodes);
+  if (inodes.empty()){return;}
 
-    char buffer[128];
-    std::string result = "";
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr){
-      result += buffer;
+  DIR *procDir = opendir("/proc");
+  if (!procDir){return;}
+  pid_t myPid = getpid();
+  std::set<pid_t> killed;
+  struct dirent *procEnt;
+  while ((procEnt = readdir(procDir))){
+    char *end;
+    pid_t pid = strtol(procEnt->d_name, &end, 10);
+    if (*end || pid < 2 || pid == myPid){continue;}
+    std::string fdPath = std::string("/proc/") + procEnt->d_name + "/fd/";
+    DIR *fdDir = opendir(fdPath.c_str());
+    if (!fdDir){continue;}
+    struct dirent *fdEnt;
+    while ((fdEnt = readdir(fdDir))){
+      if (fdEnt->d_name[0] == '.'){continue;}
+      char target[64];
+      ssize_t len = readlink((fdPath + fdEnt->d_name).c_str(), target, sizeof(target) - 1);
+      if (len <= 8 || strncmp(target, "socket:[", 8)){continue;}
+      target[len] = 0;
+      if (!inodes.count(strtoull(target + 8, 0, 10))){continue;}
+      if (!kill(pid, SIGKILL)){killed.insert(pid);}
+      break;
     }
+    closedir(fdDir);
+  }
+  closedir(procDir);
 
-    pclose(pipe);
-
-    if (!result.empty()){
-      std::stringstream killCmd;
-      killCmd << "echo \"" << result << "\" | xargs kill -9";
-      if (system(killCmd.str().c_str()) == 0){
-        std::cout << "\x1b[33m[RTMPServer] [Recovery] Killed processes on reserved port " << port << "\x1b[0m\n";
-      }
-    }
+  if (killed.size()){
+    std::cout << "\x1b[33m[RTMPServer] [Recovery] Killed " << killed.size() << " process(es) on reserved ports\x1b[0m\n";
   }
 }
 
@@ -1269,14 +1269,36 @@ void Controller::handleAPICommands(JSON::Value &Request, JSON::Value &Response){
       if (!isLoaded){ERROR_MSG("[RTMPServer] Could not open SQL DB on bandwidth_data API call");}
       if (isLoaded && db){
         JSON::Value streams = Controller::Storage["streams"];
+        std::map<std::string, JSON::Value> feeds = Database::getAllColumns2(db);
         jsonForEach(streams, jit){
-          JSON::Value columnData = Database::getColumn2(db, jit.key());
-          EXTREME_MSG("[RTMPServer] columnData = %s", columnData.asString());
-          json_resp[jit.key()] = columnData;
+          JSON::Value &columnData = json_resp[jit.key()];
+          if (feeds.count(jit.key())){columnData = feeds[jit.key()];}
+          EXTREME_MSG("[RTMPServer] columnData = %s", columnData.asString().c_str());
         }
         Database::closeDatabase(db);
       }
     }
     Response["traffic"] = json_resp;
   }
+
+  // Traffic in bytes from the minute/hour/day rollup tables, optionally filtered by user and stream
+  // Example: {"bandwidth_usage":{"interval":"day","user":"someUser","from":1700000000,"to":1702592000}}
+  if (Request.isMember("bandwidth_usage")){
+    JSON::Value json_resp;
+    json_resp.null();
+    if (Controller::conf.trafficConsumption){
+      const JSON::Value &req = Request["bandwidth_usage"];
+      sqlite3 *db = nullptr;
+      if (Database::loadDatabase(db) && db){
+        uint64_t to = req.isMember("to") ? req["to"].asInt() : Util::epoch();
+        uint64_t from = req.isMember("from") ? req["from"].asInt() : to - 86400;
+        json_resp = Database::getTrafficRollup(db, req["interval"].asString(), req["user"].asString(),
+                                               req["stream"].asString(), from, to);
+        Database::closeDatabase(db);
+      }else{
+        ERROR_MSG("[RTMPServer] Could not open SQL DB on bandwidth_usage API call");
+      }
+    }
+    Response["bandwidth_usage"] = json_resp;
+  }
 }
@@ -192,8 +192,8 @@ namespace Controller{
     while (Controller::conf.is_active){
       std::set<std::string> activeStreams = Controller::getActiveStreams();
       if (activeStreams.size()){
-        JSON::Value allAutopushes = Controller::Storage["autopushes"];
-        jsonForEach(allAutopushes, it){
+        Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
+        jsonForEachConst(config->autopushes, it){
           std::string stream = (*it)[0u];
           std::string target = (*it)[1u];
           if ((it->size() >= 2) && (activeStreams.count(stream))){
@@ -367,7 +367,8 @@ namespace Controller{
 
   /// Starts all configured auto pushes for the given stream.
   void doAutoPush(std::string &streamname){
-    jsonForEach(Controller::Storage["autopushes"], it){
+    Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
+    jsonForEachConst(config->autopushes, it){
       if (it->size() > 2 && (*it)[2u].asInt() < Util::epoch()){continue;}
       const std::string &pStr = (*it)[0u].asStringRef();
       if (pStr == streamname || (*pStr.rbegin() == '+' && streamname.substr(0, pStr.size()) == pStr)){
@@ -11,6 +11,7 @@
 #include <mist/procs.h>
 #include <mist/shared_memory.h>
 #include <mist/stream.h>
+#include <mist/traffic.h>
 #include <mist/url.h>
 #include <sys/statvfs.h> //for fstatvfs
 #include <mist/triggers.h>
@@ -60,9 +61,11 @@ tthread::recursive_mutex statsMutex;
 uint64_t Controller::statDropoff = 0;
 static uint64_t cpu_use = 0;
 
-/* User list for bandwidth statistics */
-std::set<std::string> usersList;
 bool streamPage = true;
+/* Traffic database flush metrics */
+static uint64_t trafficFlushMs = 0;
+static uint64_t trafficRowsTotal = 0;
+static double trafficRowsPerSec = 0;
 bool UserPage = true;
 int DBRegulator = 3600;
 
@@ -371,7 +374,7 @@ void Controller::SharedMemStats(void *config){
       cpustat.close();
     }
     {
-      tthread::lock_guard<tthread::mutex> guard(Controller::configMutex);
+      // Autopushes started from streamStarted() come from the config snapshot, so only statsMutex is needed
       tthread::lock_guard<tthread::recursive_mutex> guard2(statsMutex);
       // parse current users
       statLeadIn();
@@ -1806,6 +1809,16 @@ void Controller::handlePrometheus(HTTP::Parser &H, Socket::Connection &conn, int
     response << "mist_packets_total{pkttype=\"lost\"}" << servPackLoss << "\n";
     response << "mist_packets_total{pkttype=\"retrans\"}" << servPackRetrans << "\n";
 
+    response << "\n# HELP mist_traffic_db_flush_ms Duration of the last traffic database flush in milliseconds.\n";
+    response << "# TYPE mist_traffic_db_flush_ms gauge\n";
+    response << "mist_traffic_db_flush_ms " << trafficFlushMs << "\n";
+    response << "# HELP mist_traffic_db_rows_per_sec Rows per second written by the last traffic database flush.\n";
+    response << "# TYPE mist_traffic_db_rows_per_sec gauge\n";
+    response << "mist_traffic_db_rows_per_sec " << trafficRowsPerSec << "\n";
+    response << "# HELP mist_traffic_db_rows_total Count of traffic rows written to the database since server start.\n";
+    response << "# TYPE mist_traffic_db_rows_total counter\n";
+    response << "mist_traffic_db_rows_total " << trafficRowsTotal << "\n";
+
     if (outputs.size()){
       response << "# HELP mist_outputs Number of viewers active right now, server-wide, by output type.\n";
       response << "# TYPE mist_outputs gauge\n";
@@ -1919,6 +1932,9 @@ void Controller::handlePrometheus(HTTP::Parser &H, Socket::Connection &conn, int
     resp["pkts"].append(servPackLoss);
     resp["pkts"].append(servPackRetrans);
     resp["bwlimit"] = bwLimit;
+    resp["traffic_db"]["flush_ms"] = trafficFlushMs;
+    resp["traffic_db"]["rows_per_sec"] = trafficRowsPerSec;
+    resp["traffic_db"]["rows"] = trafficRowsTotal;
     {// Scope for shortest possible blocking of statsMutex
       tthread::lock_guard<tthread::recursive_mutex> guard(statsMutex);
       if (!Controller::conf.is_active){return;}
@@ -2204,163 +2220,34 @@ void Controller::trafficThread(void *np){
   Database::closeDatabase(db);
 }
 
-void Controller::addUserInStreamCol(std::string userName, std::string streamName, std::set<std::string> &usersList){
-  streamName = Controller::refactorStream(streamName);
-  IPC::sharedPage trafficSharedPage;
-  IPC::semaphore writeLock;
-  std::set<std::string> streams = Controller::getStreamPageFields();
-  writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-  if (!writeLock){
-    FAIL_MSG("[Statistics], Could not open writelock to add user in SHM!");
-  }
-  trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, false, false);
-  if (!trafficSharedPage || !trafficSharedPage.mapped){
-    trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-  }
-  if (!trafficSharedPage.mapped){
+/// Prepares the traffic counters page on boot: the page is recreated and filled with today's traffic
+/// from the database.
+void Controller::addStreamInSHM2(){
+  Traffic::Counters counters(true);
+  counters.recreate();
+  if (!counters){
     FAIL_MSG("Could not open memory page for traffic stats");
     return;
   }
-  if (trafficSharedPage.mapped){
-    Util::RelAccX tempTrafficAccX(trafficSharedPage.mapped, false);
-    /* Gather the SHM data in-memory RAM {Local vars} */
-    std::map<std::string, std::vector<std::pair<std::string, std::vector<std::string>>>> temporaryData;
-    for (auto &jit : streams){
-      if (tempTrafficAccX.getFieldAccX(jit) && tempTrafficAccX.getPointer(jit)){
-        Util::RelAccX trafficStreamRow = Util::RelAccX(tempTrafficAccX.getPointer(jit), false);
-        for (auto& user : usersList){
-          std::vector<std::string> consumedData;
-          if (trafficStreamRow.getFieldAccX(user) && trafficStreamRow.getPointer(user.c_str())){
-            JSON::Value userStreamRow = JSON::fromString(trafficStreamRow.getPointer(user.c_str()));
-            std::string hls = userStreamRow["hls"];
-            std::string ws = userStreamRow["ws"];
-            std::string ndvr = userStreamRow["ndvr"];
-            consumedData.push_back(hls);
-            consumedData.push_back(ws);
-            consumedData.push_back(ndvr);
-            temporaryData[jit].push_back({user, consumedData});
-          }
-          else if (streamName == jit and user == userName){
-            std::string hls = "0.0";
-            std::string ws = "0.0";
-            std::string ndvr = "0.0";
-            consumedData.push_back(hls);
-            consumedData.push_back(ws);
-            consumedData.push_back(ndvr);
-            temporaryData[jit].push_back({user, consumedData});
-          }
-        }
-      }
-    }
-    if (writeLock){
-      writeLock.wait();
-      tempTrafficAccX.setReload();
-      trafficSharedPage.master = true;
-      trafficSharedPage.close();
-      trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-      writeLock.post();
-    }
-    Util::RelAccX trafficAccX(trafficSharedPage.mapped, false);
-    if (!trafficAccX.isReady()){
-      for (auto &jit : streams){
-        trafficAccX.addField(jit, RAX_NESTED, DEFAULT_ROW_CAPACITY);
-      }
-      trafficAccX.setRCount(1);
-      trafficAccX.setEndPos(1);
-      trafficAccX.setReady();
-    }
-    for (auto &jit : streams){
-      std::vector<std::pair<std::string, std::vector<std::string>>> usersData = temporaryData[jit];
-      Util::RelAccX streamAccX = Util::RelAccX(trafficAccX.getPointer(jit), false);
-      for (auto &userRow:usersData){
-        streamAccX.addField(userRow.first, RAX_STRING, 512);
-      }
-      streamAccX.setRCount(1);
-      streamAccX.setEndPos(1);
-      streamAccX.setReady();
-      for (auto &userRow:usersData){
-        JSON::Value userData;
-        userData["hls"] = userRow.second[0];
-        userData["ws"] = userRow.second[1];
-        userData["ndvr"] = userRow.second[2];
-        streamAccX.setString((userRow.first), userData.toString());
-      }
-    }
-  trafficSharedPage.master = false;
-  }
-}
-
-void Controller::addStreamInSHM2(bool regulate){
-  Controller::trafficProtocol trafficProtocol;
-  IPC::sharedPage trafficSharedPage;
-  IPC::semaphore writeLock;
+  Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
+  if (!config->refactored.size()){return;}
   sqlite3 *db = nullptr;
-  JSON::Value streams = Controller::Storage["streams"];
-  if (Controller::Storage["streams"].size() == 0){return;}
   Database::loadDatabase(db);
-  writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-  if (!writeLock){
-    FAIL_MSG("[addStreamInSHM], Could not open writelock to add stream in SHM!");
-  }
-  trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, false, false);
-  if (!trafficSharedPage || !trafficSharedPage.mapped){
-    trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-  }
-  if (!trafficSharedPage.mapped){
-    FAIL_MSG("Could not open memory page for traffic stats");
-    Database::closeDatabase(db);
-    return;
-  }
-  if (trafficSharedPage.mapped){
-    Util::RelAccX tempTrafficAccX(trafficSharedPage.mapped, false);
-    if (writeLock){
-      writeLock.wait();
-      tempTrafficAccX.setReload();
-      trafficSharedPage.master = true;
-      trafficSharedPage.close();
-      trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-      writeLock.post();
-    }
-    Util::RelAccX trafficAccX(trafficSharedPage.mapped, false);
-    if (!trafficAccX.isReady()){
-      /** Append all the streams as primary row, @brief add null user in all stream to maintain the SHM capacity */
-      std::string nullUser = "nullUser";
-      jsonForEach(streams, jit){
-        std::string modifiedStream = Controller::refactorStream(jit.key());
-        trafficAccX.addField(modifiedStream, RAX_NESTED, DEFAULT_ROW_CAPACITY);
-      }
-      trafficAccX.setRCount(1);
-      trafficAccX.setEndPos(1);
-      trafficAccX.setReady();
-      jsonForEach(streams, jit){
-        std::string streamName = jit.key();
-        std::string modifiedStream = Controller::refactorStream(jit.key());
-        Util::RelAccX trafficStreamRow = Util::RelAccX(trafficAccX.getPointer(modifiedStream), false);
-        std::map<std::string, std::vector<std::string>> usersData = Database::getDatabaseDump(db, streamName);
-        for (auto &userRow : usersData){
-          trafficStreamRow.addField(userRow.first, RAX_STRING, 512);
-        }
-        trafficStreamRow.setRCount(1);
-        trafficStreamRow.setEndPos(1);
-        trafficStreamRow.setReady();
-        for (auto &userRow : usersData){
-          JSON::Value userData;
-          userData["hls"] = (regulate) ? "0.0" : userRow.second[0];
-          userData["ws"] = (regulate) ? "0.0" : userRow.second[1];
-          userData["ndvr"] = (regulate) ? "0.0" : userRow.second[2];
-          trafficStreamRow.setString((userRow.first), userData.toString());
-        }
-      }
+  for (std::map<std::string, std::string>::const_iterator it = config->refactored.begin(); it != config->refactored.end(); ++it){
+    const std::string &modifiedStream = it->first;
+    std::map<std::string, std::vector<std::string>> usersData = Database::getDatabaseDump(db, it->second);
+    for (auto &userRow : usersData){
+      counters.add(modifiedStream, userRow.first, Traffic::HLS, (uint64_t)(std::stod(userRow.second[0]) * TRAFFIC_BYTES_PER_MB));
+      counters.add(modifiedStream, userRow.first, Traffic::WS, (uint64_t)(std::stod(userRow.second[1]) * TRAFFIC_BYTES_PER_MB));
     }
   }
   Database::closeDatabase(db);
-  trafficSharedPage.master = false;
 }
 
 void Controller::createUserStreamPage(){
   /* create shm for users list */
   IPC::sharedPage userSharedPage;
-  JSON::Value streams = Controller::Storage["streams"];
+  Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
   std::set<std::string> streamsSet;
   sqlite3 *db = nullptr;
   Database::loadDatabase(db);
@@ -2388,7 +2275,7 @@ void Controller::createUserStreamPage(){
 
   /* create shm for streams */
   IPC::sharedPage streamSharedPage;
-  if (Controller::Storage["streams"].size() == 0) {
+  if (config->refactored.size() == 0) {
     streamPage = false;
     return;
   }
@@ -2404,9 +2291,8 @@ void Controller::createUserStreamPage(){
   if (streamSharedPage.mapped){
     Util::RelAccX streamAccX(streamSharedPage.mapped, false);
     if (!streamAccX.isReady()){
-      jsonForEach(streams, jit){
-        std::string modifiedStream = Controller::refactorStream(jit.key());
-        streamAccX.addField(modifiedStream, RAX_512STRING);
+      for (std::map<std::string, std::string>::const_iterator it = config->refactored.begin(); it != config->refactored.end(); ++it){
+        streamAccX.addField(it->first, RAX_512STRING);
       }
       streamAccX.setRCount(1);
       streamAccX.setEndPos(1);
@@ -2510,6 +2396,45 @@ std::set<std::string> Controller::getStreamPageFields(){
   return streamsList;
 }
 
+/// Passes the traffic counters of all configured streams to the database writer for the given date.
+/// If seed is true, the totals are stored as already written. Returns false if the counters are unavailable.
+static bool collectTraffic(Database::TrafficWriter &writer, const Controller::StreamsSnapshot &config, const std::string &date, bool seed){
+  Traffic::Counters counters;
+  if (!counters){return false;}
+  const std::map<std::string, std::string> &refactorMap = config.refactored;
+  for (size_t i = 0; i < counters.getSlotCount(); ++i){
+    if (!counters.isUsed(i)){continue;}
+    std::map<std::string, std::string>::const_iterator feed = refactorMap.find(counters.getStream(i));
+    if (feed == refactorMap.end()){continue;}
+    uint64_t hlsBytes = counters.getBytes(i, Traffic::HLS);
+    uint64_t wsBytes = counters.getBytes(i, Traffic::WS);
+    if (!hlsBytes && !wsBytes){continue;}
+    if (seed){
+      writer.seed(feed->second, counters.getUser(i), date, hlsBytes, wsBytes);
+    }else{
+      // Only rows that changed since the last flush are written
+      writer.set(feed->second, counters.getUser(i), date, hlsBytes, wsBytes);
+    }
+  }
+  return true;
+}
+
+/// Starts a new day in the traffic counters. Every counter is reset atomically, and the value it held
+/// right up to the reset is written as the final total of the previous day, so no traffic is lost.
+static void rollOverTraffic(Database::TrafficWriter &writer, const Controller::StreamsSnapshot &config, const std::string &prevDate){
+  Traffic::Counters counters;
+  if (!counters){return;}
+  const std::map<std::string, std::string> &refactorMap = config.refactored;
+  for (size_t i = 0; i < counters.getSlotCount(); ++i){
+    if (!counters.isUsed(i)){continue;}
+    uint64_t hlsBytes = counters.reset(i, Traffic::HLS);
+    uint64_t wsBytes = counters.reset(i, Traffic::WS);
+    std::map<std::string, std::string>::const_iterator feed = refactorMap.find(counters.getStream(i));
+    if (feed == refactorMap.end() || (!hlsBytes && !wsBytes)){continue;}
+    writer.set(feed->second, counters.getUser(i), prevDate, hlsBytes, wsBytes);
+  }
+}
+
 void Controller::trafficThread2(void *np){
   sqlite3 *db = nullptr;
   std::string prevDate = Util::getDateOnlyString();
@@ -2522,76 +2447,68 @@ void Controller::trafficThread2(void *np){
     }
   }while(!isDbOpen);
   Controller::createUserStreamPage();
-  Controller::addStreamInSHM2(false);
+  Controller::addStreamInSHM2();
+  Database::TrafficWriter writer(db);
+  // The counters now hold today's totals from the database; don't roll those up again
+  collectTraffic(writer, *Controller::getStreamsSnapshot(), prevDate, true);
+  // The traffic thread is the only writer of trafficConsumption. The snapshot is built from the
+  // database once, and after that only the feeds with written rows are updated and re-serialized.
+  // It is rebuilt from the database only when rows were written outside of the incremental
+  // path: at the day rollover and after old rows were deleted.
+  Traffic::Snapshot snapshot;
+  std::map<std::string, JSON::Value> feeds;
+  std::map<std::string, std::string> entries;
+  bool rebuildSnapshot = true;
   int regCounter = 0;
   while (Controller::conf.is_active){
-    IPC::sharedPage trafficSharedPage;
-    IPC::semaphore writeLock;
-    JSON::Value allStreams = Controller::Storage["streams"];
+    Controller::StreamsSnapshotPtr config = Controller::getStreamsSnapshot();
 
     /* Regulate the SHM page after day */
-    std::string curTime = Util::getDateOnlyString2();
     std::string date = Util::getDateOnlyString();
     if (prevDate != date){
+      rollOverTraffic(writer, *config, prevDate);
+      writer.flush();
       WARN_MSG("Traffic page regulated successfully");
-      Controller::addStreamInSHM2(true);
+      writer.clear();
       prevDate = Util::getDateOnlyString();
-    }
-
-    writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-    if (!writeLock){
-      FAIL_MSG("[Statistics], Could not open writelock to add traffic from SHM to DB!");
-    }
-    trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, false, false);
-    if (trafficSharedPage.mapped){
-      Util::RelAccX tempTrafficAccX(trafficSharedPage.mapped, false);
-      std::set<std::string> streams = Controller::getStreamPageFields();
-
-      /** Getting the refactor string */
-      std::map<std::string, std::string> refactorMap;
-      jsonForEach(allStreams, it){
-        std::string modifiedStream = Controller::refactorStream(it.key());
-        refactorMap[modifiedStream] = it.key();
-      }
-
-      usersList = Controller::getUserPageFields(USER_LIST, "");
-      for (const std::string& jit : streams){
-        if (tempTrafficAccX.getFieldAccX(jit) && tempTrafficAccX.getPointer(jit)){
-          Util::RelAccX trafficStreamRow = Util::RelAccX(tempTrafficAccX.getPointer(jit), false);
-          std::map<std::string, std::vector<std::string>> dbDump;
-          if (refactorMap[jit].size() != 0){
-            dbDump = Database::getDatabaseDump(db, refactorMap[jit]);
-          }
-          for (const std::string& user : usersList){
-            JSON::Value userStreamRow;
-            if (trafficStreamRow.getFieldAccX(user) && trafficStreamRow.getPointer(user.c_str())){
-              userStreamRow = JSON::fromString(trafficStreamRow.getPointer(user.c_str()));
-            }
-            std::string hls = userStreamRow.isMember("hls") ? userStreamRow["hls"] : "0.0";
-            std::string ndvr = userStreamRow.isMember("ndvr") ? userStreamRow["ndvr"] : "0.0";
-            std::string ws = userStreamRow.isMember("ws") ? userStreamRow["ws"] : "0.0";
-            // std::string date = Util::getDateOnlyString();
-
-            if (dbDump.find(user) != dbDump.end()){ndvr = dbDump[user][2];}
-
-            if (hls != "0.0" || ws != "0.0" || ndvr != "0.0"){
-              if (refactorMap[jit].size() != 0){
-                  Database::injectInDB2(db, refactorMap[jit], user, date, std::stod(hls), std::stod(ndvr), std::stod(ws));
-              }else{
-                  FAIL_MSG("Empty feed name : %s, not inject in database yet", refactorMap[jit].c_str());
-              }
-            }
-          }
+      rebuildSnapshot = true;
+    }
+
+    if (collectTraffic(writer, *config, date, false)){
+      // Refresh the snapshot viewer-facing processes read from
+      std::set<std::string> changed;
+      writer.flush(rebuildSnapshot ? 0 : &feeds, &changed);
+      if (rebuildSnapshot){
+        feeds = Database::getAllColumns2(db);
+        entries.clear();
+        for (std::map<std::string, JSON::Value>::iterator it = feeds.begin(); it != feeds.end(); ++it){
+          entries[it->first] = it->second.toString();
+        }
+        snapshot.publish(entries);
+        rebuildSnapshot = false;
+      }else if (changed.size()){
+        for (std::set<std::string>::iterator it = changed.begin(); it != changed.end(); ++it){
+          entries[*it] = feeds[*it].toString();
         }
+        snapshot.publish(entries);
       }
+      trafficFlushMs = writer.getFlushTime();
+      trafficRowsTotal = writer.getTotalRows();
+      trafficRowsPerSec = writer.getRowsPerSec();
     }
 
     /** Regulating the db @brief delete 7 days previous data on hourly basis,  @todo use \b DATABASE_REGULATION */
     if (regCounter > DBRegulator){
       std::string query = "DELETE FROM trafficConsumption WHERE date < date('now', '-7 days');";
       bool res = Database::runQuery(db, query);
+      // Keep fine-grained rollups for a limited time; daily rollups are kept for billing
+      query = "DELETE FROM trafficMinute WHERE bucket < " + JSON::Value(Util::epoch() - TRAFFIC_MINUTE_RETENTION).asString() + ";";
+      res &= Database::runQuery(db, query);
+      query = "DELETE FROM trafficHour WHERE bucket < " + JSON::Value(Util::epoch() - TRAFFIC_HOUR_RETENTION).asString() + ";";
+      res &= Database::runQuery(db, query);
       if (res == false){FAIL_MSG("Unable to regulate the database [7 days rotator]");}
       else{WARN_MSG("Database is successfully regulated");}
+      rebuildSnapshot = true;
       regCounter = 0;
     }
     regCounter += SHM_TO_DB_TIMEOUT;
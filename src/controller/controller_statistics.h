@@ -190,8 +190,7 @@ namespace Controller{
     std::string ndvrBandwidth = "0.0";
   };
   void addStreamInSHM(bool appendMode, std::vector<std::string> &olderStreams, std::string pageName);  // Add the stream info in SHM on boot as well as addStream API
-  void addStreamInSHM2(bool regulate); // Add the stream info in SHM on boot as well as addStream API. [USER LEVEL INTEGRATION]
-  void addUserInStreamCol(std::string userName, std::string streamName, std::set<std::string> &usersList);
+  void addStreamInSHM2(); // Add the stream info in SHM on boot as well as addStream API. [USER LEVEL INTEGRATION]
   void createUserStreamPage();
   std::set<std::string> getUserPageFields(std::string pageName, std::string userName);
   std::set<std::string> getStreamPageFields();
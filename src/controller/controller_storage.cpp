@@ -1,6 +1,7 @@
 #include "controller_capabilities.h"
 #include "controller_storage.h"
 #include "controller_push.h" //LTS
+#include "controller_statistics.h"
 #include "controller_streams.h" //LTS
 #include <algorithm>
 #include <fstream>
@@ -37,6 +38,42 @@ namespace Controller{
   uint64_t systemBoot = Util::unixMS() - Util::bootMS();
   uint64_t lastBootTime;
   bool isAgentMode = false;
+  tthread::mutex snapshotMutex; ///< Only guards swapping streamsSnapshot
+  StreamsSnapshotPtr streamsSnapshot;
+
+  /// Returns the most recently published stream configuration snapshot.
+  /// Returns an empty snapshot (version 0) if none was published yet.
+  StreamsSnapshotPtr getStreamsSnapshot(){
+    tthread::lock_guard<tthread::mutex> guard(snapshotMutex);
+    if (!streamsSnapshot){
+      StreamsSnapshot *S = new StreamsSnapshot();
+      S->version = 0;
+      streamsSnapshot.reset(S);
+    }
+    return streamsSnapshot;
+  }
+
+  /// Publishes a new stream configuration snapshot, if the streams or autopushes differ from the current one.
+  /// Must be called with configMutex held, or before any other threads are started.
+  void publishStreamsSnapshot(){
+    StreamsSnapshotPtr current = getStreamsSnapshot();
+    if (current->version && current->streams == Storage["streams"] && current->autopushes == Storage["autopushes"]){
+      return;
+    }
+    StreamsSnapshot *S = new StreamsSnapshot();
+    S->version = current->version + 1;
+    S->streams = Storage["streams"];
+    S->autopushes = Storage["autopushes"];
+    jsonForEachConst(S->streams, it){
+      S->refactored[refactorStream(it.key())] = it.key();
+      if (it->isMember("source") && (*it)["source"].asStringRef().substr(0, 7) == "rtsp://"){
+        S->rtspSources[it.key()] = (*it)["source"].asStringRef();
+      }
+      if (it->isMember("always_on") && (*it)["always_on"].asBool()){S->alwaysOn.insert(it.key());}
+    }
+    tthread::lock_guard<tthread::mutex> guard(snapshotMutex);
+    streamsSnapshot.reset(S);
+  }
 
   Util::RelAccX *logAccessor(){return rlxLogs;}
 
@@ -442,6 +479,7 @@ namespace Controller{
       it->removeNullMembers();
       writeStream(it.key(), *it);
     }
+    publishStreamsSnapshot();
 
     {
       // Global configuration options, if any
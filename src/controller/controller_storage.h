@@ -2,6 +2,9 @@
 #include <mist/json.h>
 #include <mist/tinythread.h>
 #include <mist/util.h>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 
 namespace Controller{
@@ -20,6 +23,20 @@ namespace Controller{
   extern uint64_t lastBootTime;      ///< Unix time in milliseconds of last system boot/reboot
   extern bool isAgentMode;           ///< Global switch to check if running in agent mode
 
+  /// Immutable copy of the stream configuration, plus indexes derived from it.
+  /// writeConfig() publishes a new one whenever the streams or autopushes change; readers keep using the one they hold.
+  struct StreamsSnapshot{
+    uint64_t version;                               ///< Goes up by one for every published snapshot
+    JSON::Value streams;                            ///< Copy of Storage["streams"]
+    std::map<std::string, std::string> refactored;  ///< Refactored stream name to stream name
+    std::map<std::string, std::string> rtspSources; ///< Stream name to source, for streams with an RTSP source
+    std::set<std::string> alwaysOn;                 ///< Names of streams with always_on set
+    JSON::Value autopushes;                         ///< Copy of Storage["autopushes"]
+  };
+  typedef std::shared_ptr<const StreamsSnapshot> StreamsSnapshotPtr;
+  StreamsSnapshotPtr getStreamsSnapshot();
+  void publishStreamsSnapshot();
+
   Util::RelAccX *logAccessor();
   Util::RelAccX *accesslogAccessor();
   Util::RelAccX *streamsAccessor();
@@ -411,13 +411,10 @@ namespace Controller{
       /** \b [RTMPServer] : ading streams in DB and shared page of traffic only if \b TRAFFIC_CONSUMPTION = ON */
       if (Controller::conf.trafficConsumption){
         // Database::insertIfNotExists(db, jit.key());
-        // Append the newStreams in SHM page also for calculating traffic statistics
+        // Append the newStreams in the stream list SHM page; traffic counters need no preparation
         if (prevStreamCount < Storage["streams"].size()){
           HIGH_MSG("Stream adding in SHM");
-          std::set<std::string> usersList = Controller::getUserPageFields(USER_LIST, "");
-          /** \todo fix crash after this when adding first stream **/
           Controller::updateStreamInSHM();
-          Controller::addUserInStreamCol("", "", usersList);
         }
       }
       Database::closeDatabase(db);
@@ -43,16 +43,15 @@ namespace Mist{
     DONTEVEN_MSG("User with ID:%zu is on %zu:%zu -> %zu (timestamp %" PRIu64 ")", id, track, key, endKey, time);
     for (size_t i = key; i <= endKey; ){
       const Util::RelAccX &tPages = M.pages(track);
-      Util::RelAccXFieldData firstkeyEntry = tPages.getFieldData("firstkey");
-      Util::RelAccXFieldData keyCountEntry = tPages.getFieldData("keycount");
+      const DTSC::PageSchema &P = M.pageFields(track);
       if (!tPages.getEndPos()){return;}
       DTSC::Keys keys(M.keys(track));
       if (i > keys.getEndValid()){return;}
       bool found = false;
       uint64_t cnt = 1, pageNumber = 0;
       for (uint64_t j = tPages.getDeleted(); j < tPages.getEndPos(); j++){
-        pageNumber = tPages.getInt(firstkeyEntry, j);
-        cnt = tPages.getInt(keyCountEntry, j);
+        pageNumber = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], j);
+        cnt = tPages.getInt(P[DTSC::PAGE_KEYCOUNT], j);
         if (pageNumber <= i && pageNumber + cnt > i){
           found = true;
           break;
@@ -1268,8 +1267,9 @@ namespace Mist{
     std::map<size_t, std::set<uint32_t> > checkedPages;
     for (std::set<size_t>::iterator it = validTracks.begin(); it != validTracks.end(); ++it){
       Util::RelAccX &tPages = meta.pages(*it);
+      const DTSC::PageSchema &P = meta.pageFields(*it);
       for (size_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-        uint64_t pageNum = tPages.getInt("firstkey", i);
+        uint64_t pageNum = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i);
         checkedPages[*it].insert(pageNum);
         if (pageCounter[*it].count(pageNum)){
           // If the page is still being written to, reset the counter rather than potentially unloading it
@@ -1362,6 +1362,7 @@ namespace Mist{
       uint32_t endKey = keys.getEndValid();
 
       Util::RelAccX &tPages = meta.pages(*it);
+      const DTSC::PageSchema &P = meta.pageFields(*it);
       // Generate page data only if not set yet (might be crash-recovering here)
       if (!tPages.getEndPos()){
         int32_t pageNum = -1;
@@ -1373,18 +1374,18 @@ namespace Mist{
             }
             tPages.addRecords(1);
             ++pageNum;
-            tPages.setInt("firsttime", keyTime, pageNum);
-            tPages.setInt("firstkey", j, pageNum);
+            tPages.setInt(P[DTSC::PAGE_FIRSTTIME], keyTime, pageNum);
+            tPages.setInt(P[DTSC::PAGE_FIRSTKEY], j, pageNum);
 
             newData = false;
           }
-          tPages.setInt("keycount", tPages.getInt("keycount", pageNum) + 1, pageNum);
-          tPages.setInt("parts", tPages.getInt("parts", pageNum) + keys.getParts(j), pageNum);
-          tPages.setInt("size", tPages.getInt("size", pageNum) + keys.getSize(j), pageNum);
-          tPages.setInt("lastkeytime", keyTime, pageNum);
-          if ((tPages.getInt("size", pageNum) > FLIP_DATA_PAGE_SIZE ||
-               keyTime - tPages.getInt("firsttime", pageNum) > FLIP_TARGET_DURATION) &&
-              keyTime - tPages.getInt("firsttime", pageNum) > FLIP_MIN_DURATION){
+          tPages.setInt(P[DTSC::PAGE_KEYCOUNT], tPages.getInt(P[DTSC::PAGE_KEYCOUNT], pageNum) + 1, pageNum);
+          tPages.setInt(P[DTSC::PAGE_PARTS], tPages.getInt(P[DTSC::PAGE_PARTS], pageNum) + keys.getParts(j), pageNum);
+          tPages.setInt(P[DTSC::PAGE_SIZE], tPages.getInt(P[DTSC::PAGE_SIZE], pageNum) + keys.getSize(j), pageNum);
+          tPages.setInt(P[DTSC::PAGE_LASTKEYTIME], keyTime, pageNum);
+          if ((tPages.getInt(P[DTSC::PAGE_SIZE], pageNum) > FLIP_DATA_PAGE_SIZE ||
+               keyTime - tPages.getInt(P[DTSC::PAGE_FIRSTTIME], pageNum) > FLIP_TARGET_DURATION) &&
+              keyTime - tPages.getInt(P[DTSC::PAGE_FIRSTTIME], pageNum) > FLIP_MIN_DURATION){
             newData = true;
           }
         }
@@ -1421,15 +1422,16 @@ namespace Mist{
 
     for (std::set<size_t>::iterator it = validTracks.begin(); it != validTracks.end(); ++it){
       const Util::RelAccX &tPages = meta.pages(*it);
+      const DTSC::PageSchema &P = meta.pageFields(*it);
       if (!tPages.getEndPos()){
         WARN_MSG("No pages for track %zu found", *it);
         continue;
       }
       MEDIUM_MSG("Track %zu (%s) split into %" PRIu64 " pages", *it, M.getCodec(*it).c_str(), tPages.getEndPos());
       for (size_t j = tPages.getDeleted(); j < tPages.getEndPos(); j++){
-        size_t pageNumber = tPages.getInt("firstkey", j);
-        size_t pageKeys = tPages.getInt("keycount", j);
-        size_t pageSize = tPages.getInt("size", j);
+        size_t pageNumber = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], j);
+        size_t pageKeys = tPages.getInt(P[DTSC::PAGE_KEYCOUNT], j);
+        size_t pageSize = tPages.getInt(P[DTSC::PAGE_SIZE], j);
 
         HIGH_MSG("  Page %zu-%zu, (%zu bytes)", pageNumber, pageNumber + pageKeys - 1, pageSize);
       }
@@ -1523,6 +1525,7 @@ namespace Mist{
     if (sourceIdx == INVALID_TRACK_ID){sourceIdx = idx;}
 
     const Util::RelAccX &tPages = M.pages(idx);
+    const DTSC::PageSchema &P = M.pageFields(idx);
     DTSC::Keys keys(M.keys(idx));
     uint32_t keyCount = keys.getValidCount();
     if (!tPages.getEndPos()){
@@ -1540,10 +1543,10 @@ namespace Mist{
     }
     uint64_t pageIdx = 0;
     for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      if (tPages.getInt("firstkey", i) > keyNum) break;
+      if (tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i) > keyNum) break;
       pageIdx = i;
     }
-    uint32_t pageNumber = tPages.getInt("firstkey", pageIdx);
+    uint32_t pageNumber = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], pageIdx);
     if (isBuffered(idx, pageNumber, meta)){
       // Mark the page as still actively requested
       pageCounter[idx][pageNumber] = Util::bootSecs();
@@ -1573,7 +1576,7 @@ namespace Mist{
     }
     uint64_t stopTime = M.getLastms(idx) + 1;
     if (pageIdx != tPages.getEndPos() - 1){
-      stopTime = keys.getTime(pageNumber + tPages.getInt("keycount", pageIdx));
+      stopTime = keys.getTime(pageNumber + tPages.getInt(P[DTSC::PAGE_KEYCOUNT], pageIdx));
     }
     HIGH_MSG("Playing from %" PRIu64 " to %" PRIu64, keyTime, stopTime);
     if (isSrt){
@@ -1635,7 +1638,7 @@ namespace Mist{
           }
           //Sanity check: are we matching the key's data size?
           if (thisPacket.getFlag("keyframe")){
-            size_t currPos = tPages.getInt("avail", pageIdx);
+            size_t currPos = tPages.getInt(P[DTSC::PAGE_AVAIL], pageIdx);
             if (currPos){
               size_t keySize = keys.getSize(keyNum);
               if (currPos-prevPos == keySize){
@@ -1667,7 +1670,7 @@ namespace Mist{
       }
       //Sanity check: are we matching the key's data size?
       if (isVideo){
-        size_t currPos = tPages.getInt("avail", pageIdx);
+        size_t currPos = tPages.getInt(P[DTSC::PAGE_AVAIL], pageIdx);
         if (currPos){
           size_t keySize = keys.getSize(keyNum);
           if (currPos-prevPos == keySize){
@@ -1685,9 +1688,9 @@ namespace Mist{
     bufferFinalize(idx, page);
     bufferTimer = Util::bootMS() - bufferTimer;
     INFO_MSG("Track %zu, page %" PRIu32 " (%" PRIu64 " - %" PRIu64 " ms) buffered in %" PRIu64 "ms",
-             idx, pageNumber, tPages.getInt("firsttime", pageIdx), thisTime, bufferTimer);
+             idx, pageNumber, tPages.getInt(P[DTSC::PAGE_FIRSTTIME], pageIdx), thisTime, bufferTimer);
     INFO_MSG("  (%" PRIu32 "/%" PRIu64 " parts, %" PRIu64 " bytes)", packCounter,
-             tPages.getInt("parts", pageIdx), byteCounter);
+             tPages.getInt(P[DTSC::PAGE_PARTS], pageIdx), byteCounter);
     pageCounter[idx][pageNumber] = Util::bootSecs();
     return true;
   }
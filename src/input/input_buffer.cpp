@@ -8,6 +8,7 @@
 #include <iostream>
 #include <mist/bitfields.h>
 #include <mist/defines.h>
+#include <mist/hls_support.h>
 #include <mist/langcodes.h>
 #include <mist/procs.h>
 #include <mist/stream.h>
@@ -164,6 +165,7 @@ namespace Mist{
       delete liveMeta;
       liveMeta = 0;
     }
+    HLS::SegmentCache::wipe(streamName);
   }
 
   /// Cleans up any left-over data for the current stream
@@ -186,6 +188,7 @@ namespace Mist{
       cleanMeta.setMaster(true);
     }
     removeUnused(true);
+    HLS::SegmentCache::wipe(streamName);
   }
 
   /*LTS-START*/
@@ -332,6 +335,7 @@ namespace Mist{
     INFO_MSG("Should remove track %zu", tid);
     meta.reloadReplacedPagesIfNeeded();
     meta.removeTrack(tid);
+    HLS::SegmentCache::wipeTrack(streamName, tid);
     /*LTS-START*/
     if (!M.getValidTracks().size()){
       if (Triggers::shouldTrigger("STREAM_BUFFER")){
@@ -7,6 +7,10 @@ Socket::Connection *mainConn = 0;
 void incomingPacket(const DTSC::Packet &pkt){
   classPointer->incoming(pkt);
 }
+void incomingData(const uint64_t track, const uint64_t time, const int64_t offset, const char *data,
+                  const size_t len, const bool keyframe){
+  classPointer->incomingData(track, time, offset, data, len, keyframe);
+}
 void insertRTP(const uint64_t track, const RTP::Packet &p){
   classPointer->incomingRTP(track, p);
 }
@@ -35,6 +39,7 @@ namespace Mist{
     TCPmode = true;
     sdpState.myMeta = &meta;
     sdpState.incomingPacketCallback = incomingPacket;
+    sdpState.incomingDataCallback = ::incomingData;
     classPointer = this;
     standAlone = false;
     seenSDP = false;
@@ -281,6 +286,8 @@ namespace Mist{
   }
 
   void InputRTSP::closeStreamSource(){
+    // Don't lose the tail end of audio that is still being transcoded
+    sdpState.drainAudio();
     std::map<std::string, std::string> extraHeaders;
     DEVEL_MSG("[RTMPServer] Sending TEARDOWN on RTSP and closing TCP connection");
     extraHeaders["Connection"] = "close";
@@ -525,25 +532,29 @@ namespace Mist{
   }
 
   void InputRTSP::incoming(const DTSC::Packet &pkt){
+    char *pktData;
+    size_t pktDataLen;
+    pkt.getString("data", pktData, pktDataLen);
+    incomingData(pkt.getTrackId(), pkt.getTime(), pkt.getInt("offset"), pktData, pktDataLen, pkt.getFlag("keyframe"));
+  }
+
+  void InputRTSP::incomingData(const uint64_t track, const uint64_t time, const int64_t offset,
+                               const char *data, const size_t len, const bool keyframe){
     if (!M.getBootMsOffset()){
-      meta.setBootMsOffset(Util::bootMS() - pkt.getTime());
+      meta.setBootMsOffset(Util::bootMS() - time);
       packetOffset = 0;
       setPacketOffset = true;
     }else if (!setPacketOffset){
-      packetOffset = (Util::bootMS() - pkt.getTime()) - M.getBootMsOffset();
+      packetOffset = (Util::bootMS() - time) - M.getBootMsOffset();
       setPacketOffset = true;
     }
-    static DTSC::Packet newPkt;
-    char *pktData;
-    size_t pktDataLen;
-    pkt.getString("data", pktData, pktDataLen);
-    size_t idx = M.trackIDToIndex(pkt.getTrackId(), getpid());
+    size_t idx = M.trackIDToIndex(track, getpid());
 
     if (idx == INVALID_TRACK_ID){
-      INFO_MSG("Invalid index for track number %zu", pkt.getTrackId());
+      INFO_MSG("Invalid index for track number %zu", track);
     }else{
       if (!userSelect.count(idx)){
-        WARN_MSG("Reloading track %zu, index %zu", pkt.getTrackId(), idx);
+        WARN_MSG("Reloading track %zu, index %zu", track, idx);
         userSelect[idx].reload(streamName, idx, COMM_STATUS_ACTIVE | COMM_STATUS_SOURCE | COMM_STATUS_DONOTTRACK);
       }
       if (userSelect[idx].getStatus() & COMM_STATUS_REQDISCONNECT){
@@ -552,8 +563,7 @@ namespace Mist{
       }
     }
 
-    bufferLivePacket(pkt.getTime() + packetOffset, pkt.getInt("offset"), idx, pktData,
-                     pktDataLen, 0, pkt.getFlag("keyframe"));
+    bufferLivePacket(time + packetOffset, offset, idx, data, len, 0, keyframe);
   }
 
 }// namespace Mist
@@ -7,6 +7,10 @@ size_t bytesUp = 0;
 void incomingPacket(const DTSC::Packet &pkt){
   classPointer->incoming(pkt);
 }
+void incomingData(const uint64_t track, const uint64_t time, const int64_t offset, const char *data,
+                  const size_t len, const bool keyframe){
+  classPointer->incomingData(track, time, offset, data, len, keyframe);
+}
 void insertRTP(const uint64_t track, const RTP::Packet &p){
   classPointer->incomingRTP(track, p);
 }
@@ -31,6 +35,7 @@ namespace Mist{
     packetOffset = 0;
     sdpState.myMeta = &meta;
     sdpState.incomingPacketCallback = incomingPacket;
+    sdpState.incomingDataCallback = ::incomingData;
     classPointer = this;
     standAlone = false;
     hasBork = false;
@@ -115,6 +120,8 @@ namespace Mist{
   }
 
   void InputSDP::closeStreamSource(){
+    // Don't lose the tail end of audio that is still being transcoded
+    sdpState.drainAudio();
     if (reader){
       reader.close();
     }
@@ -288,27 +295,31 @@ namespace Mist{
 
   // Buffers incoming DTSC packets (from SDP tracks -> RTP sorter)
   void InputSDP::incoming(const DTSC::Packet &pkt){
+    char *pktData;
+    size_t pktDataLen;
+    pkt.getString("data", pktData, pktDataLen);
+    incomingData(pkt.getTrackId(), pkt.getTime(), pkt.getInt("offset"), pktData, pktDataLen, pkt.getFlag("keyframe"));
+  }
+
+  void InputSDP::incomingData(const uint64_t track, const uint64_t time, const int64_t offset,
+                              const char *data, const size_t len, const bool keyframe){
     if (!M.getBootMsOffset()){
-      meta.setBootMsOffset(Util::bootMS() - pkt.getTime());
+      meta.setBootMsOffset(Util::bootMS() - time);
       packetOffset = 0;
       setPacketOffset = true;
     }else if (!setPacketOffset){
-      packetOffset = (Util::bootMS() - pkt.getTime()) - M.getBootMsOffset();
+      packetOffset = (Util::bootMS() - time) - M.getBootMsOffset();
       setPacketOffset = true;
     }
-    static DTSC::Packet newPkt;
-    char *pktData;
-    size_t pktDataLen;
-    pkt.getString("data", pktData, pktDataLen);
-    size_t idx = M.trackIDToIndex(pkt.getTrackId(), getpid());
+    size_t idx = M.trackIDToIndex(track, getpid());
 
-    HIGH_MSG("Buffering new pkt for track %zu->%zu at offset %" PRId64 " and time %" PRIu64, pkt.getTrackId(), idx, packetOffset, pkt.getTime());
+    HIGH_MSG("Buffering new pkt for track %zu->%zu at offset %" PRId64 " and time %" PRIu64, track, idx, packetOffset, time);
 
     if (idx == INVALID_TRACK_ID){
-      INFO_MSG("Invalid index for track number %zu", pkt.getTrackId());
+      INFO_MSG("Invalid index for track number %zu", track);
     }else{
       if (!userSelect.count(idx)){
-        WARN_MSG("Reloading track %zu, index %zu", pkt.getTrackId(), idx);
+        WARN_MSG("Reloading track %zu, index %zu", track, idx);
         userSelect[idx].reload(streamName, idx, COMM_STATUS_ACTIVE | COMM_STATUS_SOURCE | COMM_STATUS_DONOTTRACK);
       }
       if (userSelect[idx].getStatus() == COMM_STATUS_REQDISCONNECT){
@@ -316,7 +327,6 @@ namespace Mist{
       }
     }
 
-    bufferLivePacket(pkt.getTime() + packetOffset, pkt.getInt("offset"), idx, pktData,
-                     pktDataLen, 0, pkt.getFlag("keyframe"));
+    bufferLivePacket(time + packetOffset, offset, idx, data, len, 0, keyframe);
   }
 }// namespace Mist
@@ -15,6 +15,8 @@ namespace Mist{
 
     // Buffers incoming DTSC packets (from SDP tracks -> RTP sorter)
     void incoming(const DTSC::Packet &pkt);
+    void incomingData(const uint64_t track, const uint64_t time, const int64_t offset,
+                      const char *data, const size_t len, const bool keyframe);
 
     void incomingRTP(const uint64_t track, const RTP::Packet &p);
 
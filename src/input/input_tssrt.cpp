@@ -46,10 +46,75 @@ static void callThreadCallbackSRT(void *socknum){
   inp.run();
 }
 
+// In multi-caller mode, the caller's input thread gets its data from the shared receive thread
+static void callThreadCallbackSRTShared(void *c){
+  Mist::SRTCaller *C = (Mist::SRTCaller *)c;
+  {
+    Mist::inputTSSRT inp(cfgPointer, C->conn.getSocket(), C);
+    inp.setSingular(false);
+    inp.run();
+  }
+  C->done = true;
+}
+
+/// Reads all data waiting on the socket of the given caller into its free blocks.
+/// Called from the shared receive thread only.
+static void fillCaller(Mist::SRTCaller &C){
+  static char dropBuf[SRT_MSG_MAX];
+  bool drained = false;
+  while (C.conn && !drained){
+    Mist::SRTBlock *B = C.blocks.back();
+    if (!B){
+      // The input thread fell behind; drop data rather than hold up all other callers
+      size_t dropSize = C.conn.Recv(dropBuf, SRT_MSG_MAX);
+      if (!dropSize){break;}
+      if (!C.dropped){WARN_MSG("Input thread for SRT socket %d is not keeping up, dropping data", C.conn.getSocket());}
+      C.dropped += dropSize;
+      continue;
+    }
+    size_t blockSize = 0;
+    while (C.conn && blockSize + SRT_MSG_MAX <= SRT_BLOCK_SIZE){
+      size_t recvSize = C.conn.Recv(B->data + blockSize, SRT_MSG_MAX);
+      if (!recvSize){
+        drained = true;
+        break;
+      }
+      blockSize += recvSize;
+    }
+    if (!blockSize){break;}
+    B->size = blockSize;
+    C.blocks.push();
+    C.wake();
+  }
+  if (!C.conn){
+    C.closed = true;
+    C.wake();
+  }
+}
+
 namespace Mist{
+  SRTCaller::SRTCaller(const Socket::SRTConnection &c) : conn(c), blocks(SRT_BLOCKS){
+    idle = false;
+    closed = false;
+    done = false;
+    dropped = 0;
+  }
+
+  /// Wakes up the input thread if it is waiting for data.
+  /// The input thread sets idle before its final check for data, so either it sees the new data or we see idle.
+  void SRTCaller::wake(){
+    __sync_synchronize();
+    if (idle){
+      tthread::lock_guard<tthread::mutex> guard(waitMutex);
+      waitCond.notify_one();
+    }
+  }
+
   /// Constructor of TS Input
   /// \arg cfg Util::Config that contains all current configurations.
-  inputTSSRT::inputTSSRT(Util::Config *cfg, SRTSOCKET s) : Input(cfg){
+  inputTSSRT::inputTSSRT(Util::Config *cfg, SRTSOCKET s, SRTCaller *c) : Input(cfg){
+    caller = c;
+    popBlock = false;
     rawIdx = INVALID_TRACK_ID;
     lastRawPacket = 0;
     capa["name"] = "TSSRT";
@@ -116,6 +181,17 @@ namespace Mist{
     option["short"] = "R";
     option["help"] = "Enable raw MPEG-TS passthrough mode";
     config->addOption("raw", option);
+
+    capa["optional"]["multi"]["name"] = "Shared receive thread";
+    capa["optional"]["multi"]["help"] = "In listener mode, receive the data of all callers from a single thread "
+                                        "using srt_epoll, instead of a blocking receive per caller";
+    capa["optional"]["multi"]["option"] = "--multi";
+
+    option.null();
+    option["long"] = "multi";
+    option["short"] = "M";
+    option["help"] = "In listener mode, receive the data of all callers from a single thread";
+    config->addOption("multi", option);
     
     // Setup if we are called form with a thread for push-based input.
     if (s != -1){
@@ -128,7 +204,7 @@ namespace Mist{
       }else if(acc == 2){
         if (streamName != streamid){
           FAIL_MSG("Stream ID '%s' does not match stream name, push blocked", streamid.c_str());
-          srtConn.close();
+          closeConn();
         }
       }
       Util::setStreamName(streamName);
@@ -196,11 +272,16 @@ namespace Mist{
     bool hasPacket = tsStream.hasPacket();
     while (!hasPacket && srtConn && config->is_active){
 
-      size_t recvSize = srtConn.RecvNow();
+      char *recvData = srtConn.recvbuf;
+      size_t recvSize = caller ? receive(recvData) : srtConn.RecvNow();
+      if (caller && !recvSize){
+        closeConn();
+        break;
+      }
       if (recvSize){
         if (rawMode){
           keepAlive();
-          rawBuffer.append(srtConn.recvbuf, recvSize);
+          rawBuffer.append(recvData, recvSize);
           if (rawBuffer.size() >= 1316 && (lastRawPacket == 0 || lastRawPacket != Util::bootMS())){
             if (rawIdx == INVALID_TRACK_ID){
               rawIdx = meta.addTrack();
@@ -217,7 +298,7 @@ namespace Mist{
           }
           continue;
         }
-        if (assembler.assemble(tsStream, srtConn.recvbuf, recvSize, true)){hasPacket = tsStream.hasPacket();}
+        if (assembler.assemble(tsStream, recvData, recvSize, true)){hasPacket = tsStream.hasPacket();}
       }else if (srtConn){
         // This should not happen as the SRT socket is read blocking and won't return until there is
         // data. But if it does, wait before retry
@@ -250,13 +331,111 @@ namespace Mist{
     thisPacket.setTime(adjustTime);
   }
 
+  /// Waits for the next block of data from the shared receive thread.
+  /// The block stays valid until the next call. Returns zero if the caller is gone.
+  size_t inputTSSRT::receive(char *&data){
+    if (popBlock){
+      caller->blocks.pop();
+      popBlock = false;
+    }
+    SRTBlock *B = caller->blocks.front();
+    if (!B){
+      tthread::lock_guard<tthread::mutex> guard(caller->waitMutex);
+      caller->idle = true;
+      __sync_synchronize();
+      while (!(B = caller->blocks.front()) && !caller->closed && config->is_active){
+        caller->waitCond.wait(caller->waitMutex);
+      }
+      caller->idle = false;
+    }
+    if (!B){return 0;}
+    popBlock = true;
+    data = B->data;
+    return B->size;
+  }
+
   bool inputTSSRT::openStreamSource(){return true;}
 
+  /// Accepts callers and receives the data for all of them from this thread, using a single srt_epoll.
+  /// Each caller still gets its own input thread, which is handed the received data in blocks.
+  void inputTSSRT::multiCallerLoop(){
+    Socket::SRTPoller poller;
+    if (!poller || !poller.add(sSock.getSocket())){
+      FAIL_MSG("Could not poll SRT listener socket, closing it");
+      sSock.close();
+      return;
+    }
+    INFO_MSG("Receiving all SRT callers from a single thread");
+    std::map<SRTSOCKET, SRTCaller *> callers;
+    SRTSOCKET ready[SRT_POLL_SOCKETS];
+    while (config->is_active && sSock.connected()){
+      // Clean up after callers whose input thread has ended
+      std::map<SRTSOCKET, SRTCaller *>::iterator it = callers.begin();
+      while (it != callers.end()){
+        if (!it->second->done){
+          ++it;
+          continue;
+        }
+        poller.remove(it->first);
+        it->second->conn.close();
+        delete it->second;
+        callers.erase(it++);
+      }
+
+      int readyCount = poller.wait(ready, SRT_POLL_SOCKETS, 1000);
+      if (readyCount < 0){break;}
+      for (int i = 0; i < readyCount; ++i){
+        if (ready[i] == sSock.getSocket()){
+          Socket::SRTConnection S = sSock.accept(true);
+          if (!S.connected()){continue;}
+          SRTCaller *C = new SRTCaller(S);
+          callers[S.getSocket()] = C;
+          if (!poller.add(S.getSocket())){C->closed = true;}
+          tthread::thread T(callThreadCallbackSRTShared, (void *)C);
+          T.detach();
+          HIGH_MSG("Spawned new thread for socket %i", S.getSocket());
+          continue;
+        }
+        it = callers.find(ready[i]);
+        if (it == callers.end() || it->second->closed){
+          poller.remove(ready[i]);
+          continue;
+        }
+        fillCaller(*(it->second));
+      }
+    }
+
+    // Tell the input threads no more data is coming, and give them some time to finish
+    for (std::map<SRTSOCKET, SRTCaller *>::iterator it = callers.begin(); it != callers.end(); ++it){
+      it->second->closed = true;
+      it->second->wake();
+    }
+    uint64_t waitUntil = Util::bootMS() + 5000;
+    while (callers.size() && Util::bootMS() < waitUntil){
+      std::map<SRTSOCKET, SRTCaller *>::iterator it = callers.begin();
+      while (it != callers.end()){
+        if (!it->second->done){
+          ++it;
+          continue;
+        }
+        it->second->conn.close();
+        delete it->second;
+        callers.erase(it++);
+      }
+      if (callers.size()){Util::sleep(50);}
+    }
+    if (callers.size()){WARN_MSG("%zu SRT input thread(s) did not shut down in time", callers.size());}
+  }
+
   void inputTSSRT::streamMainLoop(){
     // If we do not have a srtConn here, we are the main thread and should start accepting pushes.
-    if (srtConn.getSocket() == -1){
+    if (srtConn.getSocket() == -1 && !caller){
       cfgPointer = config;
       baseStreamName = streamName;
+      if (config->getBool("multi")){
+        multiCallerLoop();
+        return;
+      }
       while (config->is_active && sSock.connected()){
         Socket::SRTConnection S = sSock.accept();
         if (S.connected()){// check if the new connection is valid
@@ -272,7 +451,17 @@ namespace Mist{
     }
     // If we are here: we have a proper connection (either accepted or pull input) and should start parsing it as such
     Input::streamMainLoop();
-    srtConn.close();
+    closeConn();
+  }
+
+  /// Stops using the SRT connection. In multi-caller mode the socket belongs to the shared receive
+  /// thread, which closes it once this input thread is done; closing it here as well would race.
+  void inputTSSRT::closeConn(){
+    if (caller){
+      srtConn.drop();
+    }else{
+      srtConn.close();
+    }
   }
 
   bool inputTSSRT::needsLock(){return false;}
@@ -280,6 +469,8 @@ namespace Mist{
   void inputTSSRT::setSingular(bool newSingular){singularFlag = newSingular;}
 
   void inputTSSRT::connStats(Comms::Connections &statComm){
+    // Data is received on the shared receive thread, so our own statistics are not updated by receiving
+    if (caller){srtConn.updateStats();}
     statComm.setUp(srtConn.dataUp());
     statComm.setDown(srtConn.dataDown());
     statComm.setHost(getConnectedBinHost());
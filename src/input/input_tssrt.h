@@ -2,16 +2,42 @@
 #include <mist/dtsc.h>
 #include <mist/nal.h>
 #include <mist/socket_srt.h>
+#include <mist/tinythread.h>
 #include <mist/ts_packet.h>
 #include <mist/ts_stream.h>
 #include <set>
 #include <string>
 
+#define SRT_BLOCK_SIZE 32768   // Bytes per block of received data handed to a caller's input thread
+#define SRT_BLOCKS 16          // Blocks that can be queued per caller
+#define SRT_MSG_MAX 5000       // Space that must be left in a block to receive another message into it
+#define SRT_POLL_SOCKETS 256   // Max sockets handled per wakeup of the receive thread
+
 namespace Mist{
+  /// A block of received data, holding one or more whole SRT messages
+  struct SRTBlock{
+    size_t size;
+    char data[SRT_BLOCK_SIZE];
+  };
+
+  /// A caller accepted in multi-caller listener mode.
+  /// The receive thread fills the blocks, the caller's input thread consumes them.
+  struct SRTCaller{
+    SRTCaller(const Socket::SRTConnection &c);
+    Socket::SRTConnection conn; ///< Only used by the receive thread, which is also the only one to close it
+    Util::SPSCQueue<SRTBlock> blocks;
+    tthread::mutex waitMutex;
+    tthread::condition_variable waitCond;
+    volatile bool idle;   ///< True while the input thread is (about to be) waiting for data
+    volatile bool closed; ///< Set by the receive thread when no more data will come
+    volatile bool done;   ///< Set by the input thread when it no longer uses this caller
+    uint64_t dropped;     ///< Bytes dropped because the input thread fell behind
+    void wake();
+  };
 
   class inputTSSRT : public Input{
   public:
-    inputTSSRT(Util::Config *cfg, SRTSOCKET s = -1);
+    inputTSSRT(Util::Config *cfg, SRTSOCKET s = -1, SRTCaller *c = 0);
     ~inputTSSRT();
     void setSingular(bool newSingular);
     virtual bool needsLock();
@@ -32,6 +58,9 @@ namespace Mist{
 
     bool openStreamSource();
     void streamMainLoop();
+    void multiCallerLoop();
+    size_t receive(char *&data);
+    void closeConn();
     TS::Stream tsStream; ///< Used for parsing the incoming ts stream
     TS::Packet tsBuf;
     TS::Assembler assembler;
@@ -39,6 +68,8 @@ namespace Mist{
     uint64_t lastTimeStamp;
 
     Socket::SRTConnection srtConn;
+    SRTCaller *caller; ///< Set if our data comes from the shared receive thread
+    bool popBlock;     ///< True if the front block of caller has been handed out by receive()
     bool singularFlag;
     virtual void connStats(Comms::Connections &statComm);
 
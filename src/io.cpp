@@ -11,7 +11,7 @@
 #include <mist/config.h>
 
 namespace Mist{
-  InOutBase::InOutBase() : M(meta){}
+  InOutBase::InOutBase() : M(meta){pending.page = 0;}
 
   /// Returns the ID of the main selected track, or 0 if no tracks are selected.
   /// The main track is the first video track, if any, and otherwise the first other track.
@@ -57,10 +57,11 @@ namespace Mist{
     }
 
     Util::RelAccX &tPages = aMeta.pages(idx);
+    const DTSC::PageSchema &P = aMeta.pageFields(idx);
 
     uint32_t pageIdx = INVALID_KEY_NUM;
     for (uint32_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      if (tPages.getInt("firstkey", i) == pageNumber){
+      if (tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i) == pageNumber){
         pageIdx = i;
         break;
       }
@@ -71,7 +72,7 @@ namespace Mist{
       WARN_MSG("Aborting page buffer start: %" PRIu32 " is not a valid page number on track %zu.", pageNumber, idx);
       std::stringstream test;
       for (uint32_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-        test << tPages.getInt("firstkey", i) << " ";
+        test << tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i) << " ";
       }
       INFO_MSG("Valid page numbers: %s", test.str().c_str());
       ///\return false if the pagenumber is not valid for this track
@@ -88,7 +89,7 @@ namespace Mist{
     // Open the correct page for the data
     char pageId[NAME_BUFFER_SIZE];
     snprintf(pageId, NAME_BUFFER_SIZE, SHM_TRACK_DATA, streamName.c_str(), idx, pageNumber);
-    uint64_t pageSize = tPages.getInt("size", pageIdx);
+    uint64_t pageSize = tPages.getInt(P[DTSC::PAGE_SIZE], pageIdx);
     std::string pageName(pageId);
     page.init(pageName, pageSize, true);
 
@@ -101,7 +102,7 @@ namespace Mist{
     page.master = false;
 
     // Set the current offset to 0, to allow for using it in bufferNext()
-    tPages.setInt("avail", 0, pageIdx);
+    tPages.setInt(P[DTSC::PAGE_AVAIL], 0, pageIdx);
 
     HIGH_MSG("Start buffering page %" PRIu32 " on track %zu successful", pageNumber, idx);
     return true;
@@ -132,10 +133,11 @@ namespace Mist{
       return;
     }
     Util::RelAccX &tPages = meta.pages(idx);
+    const DTSC::PageSchema &P = meta.pageFields(idx);
 
     uint32_t pageIdx = INVALID_KEY_NUM;
     for (uint32_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      if (tPages.getInt("firstkey", i) == pageNumber){
+      if (tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i) == pageNumber){
         pageIdx = i;
         break;
       }
@@ -147,7 +149,7 @@ namespace Mist{
     }
 
     HIGH_MSG("Removing page %" PRIu32 " on track %zu from the corresponding metaPage", pageNumber, idx);
-    tPages.setInt("avail", 0, pageIdx);
+    tPages.setInt(P[DTSC::PAGE_AVAIL], 0, pageIdx);
 
     // Open the correct page
     char pageId[NAME_BUFFER_SIZE];
@@ -157,7 +159,7 @@ namespace Mist{
 #ifdef __CYGWIN__
     toErase.init(pageName, 26 * 1024 * 1024, false, false);
 #else
-    toErase.init(pageName, tPages.getInt("size", pageIdx), false, false);
+    toErase.init(pageName, tPages.getInt(P[DTSC::PAGE_SIZE], pageIdx), false, false);
 #endif
     // Set the master flag so that the page will be destroyed once it leaves scope
 #if defined(__CYGWIN__) || defined(_WIN32)
@@ -181,14 +183,15 @@ namespace Mist{
   ///\param keyNum The number of the keyframe to find
   uint32_t InOutBase::bufferedOnPage(size_t idx, uint32_t keyNum, DTSC::Meta & aMeta){
     Util::RelAccX &tPages = aMeta.pages(idx);
+    const DTSC::PageSchema &P = aMeta.pageFields(idx);
 
     for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      uint64_t pageNum = tPages.getInt("firstkey", i);
+      uint64_t pageNum = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i);
       if (pageNum > keyNum) continue;
-      uint64_t keyCount = tPages.getInt("keycount", i);
+      uint64_t keyCount = tPages.getInt(P[DTSC::PAGE_KEYCOUNT], i);
       if (pageNum + keyCount - 1 < keyNum) continue;
       if (keyCount && pageNum + keyCount - 1 < keyNum) continue;
-      uint64_t avail = tPages.getInt("avail", i);
+      uint64_t avail = tPages.getInt(P[DTSC::PAGE_AVAIL], i);
       return avail ? pageNum : INVALID_KEY_NUM;
     }
     return INVALID_KEY_NUM;
@@ -205,14 +208,28 @@ namespace Mist{
   ///\param pack The packet to buffer
   void InOutBase::bufferNext(uint64_t packTime, int64_t packOffset, uint32_t packTrack, const char *packData,
                              size_t packDataSize, uint64_t packBytePos, bool isKeyframe, IPC::sharedPage & page, DTSC::Meta & aMeta){
+    char *dest = bufferReserve(packTime, packOffset, packTrack, packDataSize, packBytePos, isKeyframe, page, aMeta);
+    if (!dest){return;}
+    if (packDataSize){memcpy(dest, packData, packDataSize);}
+    bufferCommit(packDataSize);
+  }
+
+  /// Reserves room for a packet with up to packDataSize bytes of payload on the currently opened
+  /// page, and writes its DTSC headers there.
+  /// Returns where the payload is to be written, or null if the packet cannot be buffered.
+  /// Readers will not see the packet until bufferCommit is called; only one reservation can be
+  /// outstanding at any time, and nothing else may be buffered in the meantime.
+  char *InOutBase::bufferReserve(uint64_t packTime, int64_t packOffset, uint32_t packTrack, size_t packDataSize,
+                                 uint64_t packBytePos, bool isKeyframe, IPC::sharedPage & page, DTSC::Meta & aMeta){
     size_t packDataLen =
         24 + (packOffset ? 17 : 0) + (packBytePos ? 15 : 0) + (isKeyframe ? 19 : 0) + packDataSize + 11;
+    pending.page = 0;
 
     static bool multiWrong = false;
     // Save the trackid of the track for easier access
     if (packTrack == INVALID_TRACK_ID){
       WARN_MSG("Packet with id %" PRIu32 " has an invalid track", packTrack);
-      return;
+      return 0;
     }
 
     // these checks were already done in bufferLivePacket, but we check again just to be sure
@@ -221,28 +238,29 @@ namespace Mist{
                 "Wrong order on track %" PRIu32 " ignored: %" PRIu64 " < %" PRIu64, packTrack,
                 packTime, aMeta.getLastms(packTrack));
       multiWrong = true;
-      return;
+      return 0;
     }
     // Do nothing if no page is opened for this track
     if (!page){
       INFO_MSG("Trying to buffer a packet on track %" PRIu32 ", but no page is initialized", packTrack);
-      return;
+      return 0;
     }
     multiWrong = false;
 
     Util::RelAccX &tPages = aMeta.pages(packTrack);
+    const DTSC::PageSchema &P = aMeta.pageFields(packTrack);
     uint32_t pageIdx = 0;
     uint32_t currPagNum = atoi(page.name.data() + page.name.rfind('_') + 1);
-    Util::RelAccXFieldData firstkey = tPages.getFieldData("firstkey");
-    for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      if (tPages.getInt(firstkey, i) == currPagNum){
-        pageIdx = i;
+    // The page being written is nearly always the last one, so search backwards
+    for (uint64_t i = tPages.getEndPos(); i > tPages.getDeleted(); i--){
+      if (tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i - 1) == currPagNum){
+        pageIdx = i - 1;
         break;
       }
     }
     // Save the current write position
-    uint64_t pageOffset = tPages.getInt("avail", pageIdx);
-    uint64_t pageSize = tPages.getInt("size", pageIdx);
+    uint64_t pageOffset = tPages.getInt(P[DTSC::PAGE_AVAIL], pageIdx);
+    uint64_t pageSize = tPages.getInt(P[DTSC::PAGE_SIZE], pageIdx);
     INSANE_MSG("Current packet %" PRIu64 " on track %" PRIu32 " has an offset on page %s of %" PRIu64, packTime, packTrack, page.name.c_str(), pageOffset);
     // Resize the page when there is not enough free space to add the packet.
     if (pageSize - pageOffset < packDataLen){
@@ -251,20 +269,18 @@ namespace Mist{
       // calculate the exact amount of bytes that are needed to add this packet
       size_t requiredSize = packDataLen - (pageSize - pageOffset);
       char pageId[NAME_BUFFER_SIZE];
-      uint32_t pageNumber = tPages.getInt("firstkey", pageIdx);
+      uint32_t pageNumber = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], pageIdx);
       snprintf(pageId, NAME_BUFFER_SIZE, SHM_TRACK_DATA, streamName.c_str(), pageIdx, pageNumber);
       std::string pageName(pageId);
       INFO_MSG("Resizing page %s with old size %d and new size %d", pageName.c_str(), pageSize, pageSize+requiredSize);
       page.init(pageName, pageSize+requiredSize+128, true);
-      size_t oldAvail = tPages.getInt("avail", pageIdx);
-      size_t oldSize = tPages.getInt("size", pageIdx);
       // set new size and offset fields and move ahead
-      tPages.setInt("size", pageSize+requiredSize+128, pageIdx);
+      tPages.setInt(P[DTSC::PAGE_SIZE], pageSize+requiredSize+128, pageIdx);
     }
 
-    // First generate only the payload on the correct destination
+    // Generate the container headers up to the payload
     // Leaves the 20 bytes inbetween empty to ensure the data is not accidentally read before it is
-    // complete
+    // complete; those are written by bufferCommit
     char *data = page.mapped + pageOffset;
 
     data[20] = 0xE0; // start container object
@@ -284,23 +300,60 @@ namespace Mist{
       offset += 19;
     }
     memcpy(data + offset, "\000\004data\002", 7);
-    Bit::htobl(data + offset + 7, packDataSize);
-    memcpy(data + offset + 11, packData ? packData : 0, packDataSize);
+
+    pending.page = &page;
+    pending.meta = &aMeta;
+    pending.track = packTrack;
+    pending.time = packTime;
+    pending.offset = packOffset;
+    pending.bpos = packBytePos;
+    pending.keyframe = isKeyframe;
+    pending.live = false;
+    pending.pageIdx = pageIdx;
+    pending.pageOffset = pageOffset;
+    pending.headerLen = offset + 11;
+    pending.reserved = packDataSize;
+    return data + pending.headerLen;
+  }
+
+  /// Finishes the packet reserved by bufferReserve or bufferLiveReserve, with packDataSize bytes of
+  /// payload (at most the reserved amount), and makes it available to readers.
+  /// For live packets, also updates the track metadata.
+  void InOutBase::bufferCommit(size_t packDataSize){
+    if (!pending.page){
+      WARN_MSG("Trying to commit a packet, but none was reserved");
+      return;
+    }
+    if (packDataSize > pending.reserved){
+      WARN_MSG("Packet of %zub on track %" PRIu32 " exceeds its reservation of %zub - truncating", packDataSize, pending.track, pending.reserved);
+      packDataSize = pending.reserved;
+    }
+    IPC::sharedPage &page = *pending.page;
+    DTSC::Meta &aMeta = *pending.meta;
+    pending.page = 0;
+    size_t packDataLen = pending.headerLen + packDataSize + 3;
+    char *data = page.mapped + pending.pageOffset;
+
+    Bit::htobl(data + pending.headerLen - 4, packDataSize);
     // finish container with 0x0000EE
-    memcpy(data + offset + 11 + packDataSize, "\000\000\356", 3);
+    memcpy(data + pending.headerLen + packDataSize, "\000\000\356", 3);
 
     // Copy the remaining values in reverse order:
     // 8 byte timestamp
-    Bit::htobll(page.mapped + pageOffset + 12, packTime);
+    Bit::htobll(data + 12, pending.time);
     // The mapped track id
-    Bit::htobl(page.mapped + pageOffset + 8, packTrack);
+    Bit::htobl(data + 8, pending.track);
     // Write the size
-    Bit::htobl(page.mapped + pageOffset + 4, packDataLen - 8);
+    Bit::htobl(data + 4, packDataLen - 8);
     // write the 'DTP2' bytes to conclude the packet and allow for reading it
-    memcpy(page.mapped + pageOffset, "DTP2", 4);
+    memcpy(data, "DTP2", 4);
+
+    DONTEVEN_MSG("Setting page %" PRIu64 " available to %" PRIu64, pending.pageIdx, pending.pageOffset + packDataLen);
+    aMeta.pages(pending.track).setInt(aMeta.pageFields(pending.track)[DTSC::PAGE_AVAIL], pending.pageOffset + packDataLen, pending.pageIdx);
 
-    DONTEVEN_MSG("Setting page %" PRIu32 " available to %" PRIu64, pageIdx, pageOffset + packDataLen);
-    tPages.setInt("avail", pageOffset + packDataLen, pageIdx);
+    if (!pending.live){return;}
+    if (pending.keyframe){updateTrackFromKeyframe(pending.track, data + pending.headerLen, packDataSize, aMeta);}
+    aMeta.update(pending.time, pending.offset, pending.track, packDataSize, pending.bpos, pending.keyframe);
   }
 
   /// Wraps up the buffering of a shared memory data page
@@ -363,27 +416,40 @@ namespace Mist{
   }
   
   ///Buffers the given packet data into the given metadata structure.
-  ///Uses class member variables livePage and curPageNum internally for bookkeeping.
-  ///These member variables are not (and should not, in the future) be accessed anywhere else.
   void InOutBase::bufferLivePacket(uint64_t packTime, int64_t packOffset, uint32_t packTrack, const char *packData,
                                    size_t packDataSize, uint64_t packBytePos, bool isKeyframe, DTSC::Meta &aMeta){
+    char *dest = bufferLiveReserve(packTime, packOffset, packTrack, packDataSize, packBytePos, isKeyframe, aMeta);
+    if (!dest){return;}
+    if (packDataSize){memcpy(dest, packData, packDataSize);}
+    bufferCommit(packDataSize);
+  }
+
+  ///Reserves room on the live page for a packet with up to packDataSize bytes of payload, opening
+  ///a new page first if needed. Returns where the payload is to be written, or null if the packet
+  ///is to be dropped. Parsers can write the payload there directly instead of into an intermediate
+  ///buffer; the packet is added to the metadata once bufferCommit is called.
+  ///Uses class member variables livePage and curPageNum internally for bookkeeping.
+  ///These member variables are not (and should not, in the future) be accessed anywhere else.
+  char *InOutBase::bufferLiveReserve(uint64_t packTime, int64_t packOffset, uint32_t packTrack, size_t packDataSize,
+                                     uint64_t packBytePos, bool isKeyframe, DTSC::Meta &aMeta){
     aMeta.reloadReplacedPagesIfNeeded();
     aMeta.setLive(true);
 
     // Store the trackid for easier access
     // Do nothing if the trackid is invalid
-    if (packTrack == INVALID_TRACK_ID){return;}
+    if (packTrack == INVALID_TRACK_ID){return 0;}
 
     // Store the trackid for easier access
     Util::RelAccX &tPages = aMeta.pages(packTrack);
+    const DTSC::PageSchema &P = aMeta.pageFields(packTrack);
 
-    if (aMeta.getType(packTrack) != "video"){
+    if (aMeta.getTypeId(packTrack) != DTSC::TYPE_VIDEO){
       isKeyframe = false;
       if (!tPages.getEndPos() || !livePage[packTrack]){
         // Assume this is the first packet on the track
         isKeyframe = true;
       }else{
-        if (packTime - tPages.getInt("lastkeytime", tPages.getEndPos() - 1) >= AUDIO_KEY_INTERVAL){
+        if (packTime - tPages.getInt(P[DTSC::PAGE_LASTKEYTIME], tPages.getEndPos() - 1) >= AUDIO_KEY_INTERVAL){
           isKeyframe = true;
         }
       }
@@ -395,7 +461,7 @@ namespace Mist{
       if (packTime < aMeta.getLastms(packTrack)){
         HIGH_MSG("Wrong order on track %" PRIu32 " ignored: %" PRIu64 " < %" PRIu64, packTrack,
                  packTime, aMeta.getLastms(packTrack));
-        return;
+        return 0;
       }
       if (packTime > aMeta.getLastms(packTrack) + 30000 && aMeta.getLastms(packTrack)){
         WARN_MSG("Sudden jump in timestamp from %" PRIu64 " to %" PRIu64, aMeta.getLastms(packTrack), packTime);
@@ -404,14 +470,12 @@ namespace Mist{
     
     // Determine if we need to open the next page
     if (isKeyframe){
-      updateTrackFromKeyframe(packTrack, packData, packDataSize, aMeta);
       uint64_t endPage = tPages.getEndPos();
       size_t curPage = 0;
       size_t currPagNum = atoi(livePage[packTrack].name.data() + livePage[packTrack].name.rfind('_') + 1);
-      Util::RelAccXFieldData firstkey = tPages.getFieldData("firstkey");
-      for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-        if (tPages.getInt(firstkey, i) == currPagNum){
-          curPage = i;
+      for (uint64_t i = tPages.getEndPos(); i > tPages.getDeleted(); i--){
+        if (tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i - 1) == currPagNum){
+          curPage = i - 1;
           break;
         }
       }
@@ -430,54 +494,54 @@ namespace Mist{
         }
 
         curPage = endPage;
-        tPages.setInt("firstkey", curPageNum[packTrack], endPage);
-        tPages.setInt("firsttime", packTime, endPage);
-        tPages.setInt("size", DEFAULT_DATA_PAGE_SIZE, endPage);
-        tPages.setInt("keycount", 0, endPage);
-        tPages.setInt("avail", 0, endPage);
+        tPages.setInt(P[DTSC::PAGE_FIRSTKEY], curPageNum[packTrack], endPage);
+        tPages.setInt(P[DTSC::PAGE_FIRSTTIME], packTime, endPage);
+        tPages.setInt(P[DTSC::PAGE_SIZE], DEFAULT_DATA_PAGE_SIZE, endPage);
+        tPages.setInt(P[DTSC::PAGE_KEYCOUNT], 0, endPage);
+        tPages.setInt(P[DTSC::PAGE_AVAIL], 0, endPage);
         tPages.addRecords(1);
         DONTEVEN_MSG("Opening new page #%zu to track %" PRIu32, curPageNum[packTrack], packTrack);
         if (!bufferStart(packTrack, curPageNum[packTrack], livePage[packTrack], aMeta)){
           // if this fails, return instantly without actually buffering the packet
           WARN_MSG("Dropping packet %s:%" PRIu32 "@%" PRIu64, streamName.c_str(), packTrack, packTime);
-          return;
+          return 0;
         }
       }else{
-        uint64_t prevPageTime = tPages.getInt("firsttime", curPage);
+        uint64_t prevPageTime = tPages.getInt(P[DTSC::PAGE_FIRSTTIME], curPage);
         // Compare on 8 mb boundary and target duration
-        if (tPages.getInt("avail", curPage) > FLIP_DATA_PAGE_SIZE || packTime - prevPageTime > FLIP_TARGET_DURATION){
+        if (tPages.getInt(P[DTSC::PAGE_AVAIL], curPage) > FLIP_DATA_PAGE_SIZE || packTime - prevPageTime > FLIP_TARGET_DURATION){
           // Create the book keeping data for the new page
-          curPageNum[packTrack] = tPages.getInt("firstkey", curPage) + tPages.getInt("keycount", curPage);
+          curPageNum[packTrack] = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], curPage) + tPages.getInt(P[DTSC::PAGE_KEYCOUNT], curPage);
           DONTEVEN_MSG("Live page transition from %" PRIu32 ":%" PRIu64 " to %" PRIu32 ":%zu", packTrack,
-                  tPages.getInt("firstkey", curPage), packTrack, curPageNum[packTrack]);
+                  tPages.getInt(P[DTSC::PAGE_FIRSTKEY], curPage), packTrack, curPageNum[packTrack]);
 
           if ((tPages.getEndPos() - tPages.getDeleted()) >= tPages.getRCount()){
             aMeta.resizeTrack(packTrack, aMeta.fragments(packTrack).getRCount(), aMeta.keys(packTrack).getRCount(), aMeta.parts(packTrack).getRCount(), tPages.getRCount() * 2, "not enough pages");
           }
 
           curPage = endPage;
-          tPages.setInt("firstkey", curPageNum[packTrack], endPage);
-          tPages.setInt("firsttime", packTime, endPage);
-          tPages.setInt("size", DEFAULT_DATA_PAGE_SIZE, endPage);
-          tPages.setInt("keycount", 0, endPage);
-          tPages.setInt("avail", 0, endPage);
+          tPages.setInt(P[DTSC::PAGE_FIRSTKEY], curPageNum[packTrack], endPage);
+          tPages.setInt(P[DTSC::PAGE_FIRSTTIME], packTime, endPage);
+          tPages.setInt(P[DTSC::PAGE_SIZE], DEFAULT_DATA_PAGE_SIZE, endPage);
+          tPages.setInt(P[DTSC::PAGE_KEYCOUNT], 0, endPage);
+          tPages.setInt(P[DTSC::PAGE_AVAIL], 0, endPage);
           tPages.addRecords(1);
           if (livePage[packTrack]){bufferFinalize(packTrack, livePage[packTrack]);}
           DONTEVEN_MSG("Opening new page #%zu to track %" PRIu32, curPageNum[packTrack], packTrack);
           if (!bufferStart(packTrack, curPageNum[packTrack], livePage[packTrack], aMeta)){
             // if this fails, return instantly without actually buffering the packet
             WARN_MSG("Dropping packet %s:%" PRIu32 "@%" PRIu64, streamName.c_str(), packTrack, packTime);
-            return;
+            return 0;
           }
         }
       }
-      DONTEVEN_MSG("Setting page %" PRIu64 " lastkeyTime to %" PRIu64 " and keycount to %" PRIu64, tPages.getInt("firstkey", curPage), packTime, tPages.getInt("keycount", curPage) + 1);
-      tPages.setInt("lastkeytime", packTime, curPage);
-      tPages.setInt("keycount", tPages.getInt("keycount", curPage) + 1, curPage);
+      DONTEVEN_MSG("Setting page %" PRIu64 " lastkeyTime to %" PRIu64 " and keycount to %" PRIu64, tPages.getInt(P[DTSC::PAGE_FIRSTKEY], curPage), packTime, tPages.getInt(P[DTSC::PAGE_KEYCOUNT], curPage) + 1);
+      tPages.setInt(P[DTSC::PAGE_LASTKEYTIME], packTime, curPage);
+      tPages.setInt(P[DTSC::PAGE_KEYCOUNT], tPages.getInt(P[DTSC::PAGE_KEYCOUNT], curPage) + 1, curPage);
     }
     if (!livePage[packTrack]) {
       INFO_MSG("Track %" PRIu32 " page %zu not starting with a keyframe!", packTrack, curPageNum[packTrack]);
-      return;
+      return 0;
     }
 
     if (!livePage[packTrack].exists()){
@@ -485,13 +549,14 @@ namespace Mist{
       Util::logExitReason(ER_SHM_LOST, "data page was deleted, forcing shutdown to prevent unstable state");
       bufferFinalize(packTrack, livePage[packTrack]);
       kill(getpid(), SIGINT);
-      return;
+      return 0;
     }
 
-    // Buffer the packet
+    // Reserve room for the packet
     DONTEVEN_MSG("Buffering live packet (%zuB) @%" PRIu64 " ms on track %" PRIu32 " with offset %" PRIu64, packDataSize, packTime, packTrack, packOffset);
-    bufferNext(packTime, packOffset, packTrack, packData, packDataSize, packBytePos, isKeyframe, livePage[packTrack], aMeta);
-    aMeta.update(packTime, packOffset, packTrack, packDataSize, packBytePos, isKeyframe);
+    char *dest = bufferReserve(packTime, packOffset, packTrack, packDataSize, packBytePos, isKeyframe, livePage[packTrack], aMeta);
+    if (dest){pending.live = true;}
+    return dest;
   }
 
   ///Handles updating track metadata from a new keyframe, if applicable
@@ -34,6 +34,11 @@ namespace Mist{
                           size_t packDataSize, uint64_t packBytePos, bool isKeyframe);
     void bufferLivePacket(uint64_t packTime, int64_t packOffset, uint32_t packTrack, const char *packData,
                           size_t packDataSize, uint64_t packBytePos, bool isKeyframe, DTSC::Meta & aMeta);
+    char *bufferReserve(uint64_t packTime, int64_t packOffset, uint32_t packTrack, size_t packDataSize,
+                        uint64_t packBytePos, bool isKeyframe, IPC::sharedPage & page, DTSC::Meta & aMeta);
+    char *bufferLiveReserve(uint64_t packTime, int64_t packOffset, uint32_t packTrack, size_t packDataSize,
+                            uint64_t packBytePos, bool isKeyframe, DTSC::Meta & aMeta);
+    void bufferCommit(size_t packDataSize);
     const std::string & getStreamName() const{return streamName;}
 
   protected:
@@ -54,5 +59,20 @@ namespace Mist{
   private:
     std::map<uint32_t, IPC::sharedPage> livePage;
     std::map<uint32_t, size_t> curPageNum;
+    /// Packet that has room reserved on a data page, waiting for bufferCommit
+    struct{
+      IPC::sharedPage *page; ///< Page the room is reserved on, null if nothing is reserved
+      DTSC::Meta *meta;
+      uint32_t track;
+      uint64_t time;
+      int64_t offset;
+      uint64_t bpos;
+      bool keyframe;
+      bool live; ///< If true, the track metadata is updated on commit
+      uint64_t pageIdx;
+      uint64_t pageOffset; ///< Start of the packet on the page
+      size_t headerLen; ///< Bytes before the payload
+      size_t reserved; ///< Payload bytes reserved
+    } pending;
   };
 }// namespace Mist
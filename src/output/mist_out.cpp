@@ -17,6 +17,34 @@ int spawnForked(Socket::Connection &S){
   return tmp.run();
 }
 
+/// Wraps an output instance for the event loop of a worker process
+class workerClient : public Util::WorkerClient{
+public:
+  workerClient(Socket::Connection &S) : conn(S), out(conn){}
+  ~workerClient(){out.closeClient();}
+  int getSocket(){return conn.getSocket();}
+  bool onReady(){return out.serveRequests();}
+  uint64_t wakeTime(){return out.getWakeTime();}
+  int wakeFd(){return out.getWakeFd();}
+  size_t queued(){return conn.queuedBytes();}
+  void flush(){conn.flushQueue();}
+
+private:
+  Socket::Connection conn;
+  mistOut out;
+};
+
+Util::WorkerClient *spawnWorker(Socket::Connection &S){
+  {
+    struct sigaction new_action;
+    new_action.sa_handler = SIG_IGN;
+    sigemptyset(&new_action.sa_mask);
+    new_action.sa_flags = 0;
+    sigaction(SIGUSR1, &new_action, NULL);
+  }
+  return new workerClient(S);
+}
+
 /// Checks in the server configuration if this stream is set to always on or not.
 /// Returns true if it is, or if the stream could not be found in the configuration.
 static bool isAlwaysOn(std::string &streamName){
@@ -63,7 +91,11 @@ int main(int argc, char *argv[]){
     }
     conf.activate();
     if (mistOut::listenMode()){
-      mistOut::listener(conf, spawnForked);
+      if (conf.hasOption("workers") && conf.getInteger("workers") > 0){
+        conf.serveWorkerSocket(conf.getInteger("workers"), spawnWorker);
+      }else{
+        mistOut::listener(conf, spawnForked);
+      }
       if (Socket::checkTrueSocket(0)){
         INFO_MSG("Reloading input while re-using server socket");
         execvp(argv[0], argv);
@@ -97,6 +97,12 @@ namespace Mist{
     sought = false;
     isInitialized = false;
     isBlocking = false;
+    workerMode = false;
+    bufferRetries = 50;
+    wakeTime = 0;
+    updateFd = -1;
+    waitingForData = false;
+    dataWaitStart = 0;
     needsLookAhead = 0;
     lastStats = 0xFFFFFFFFFFFFFFFFull;
     maxSkipAhead = 7500;
@@ -107,7 +113,6 @@ namespace Mist{
     firstData = true;
     newUA = true;
     lastPushUpdate = 0;
-    prevKeyTime = 0xFFFFFFFFFFFFFFFFull;
     lastRecv = Util::bootSecs();
     if (myConn){
       setBlocking(true);
@@ -266,6 +271,28 @@ namespace Mist{
     userSelect.clear();
     isInitialized = false;
     meta.clear();
+    if (updateFd != -1){
+      DTSC::unwatchUpdates(updateFdStream);
+      updateFd = -1;
+      waitingForData = false;
+    }
+  }
+
+  /// In worker mode, has serveRequests return and be called again as soon as a packet is added to
+  /// the stream, or after at most ms milliseconds. All connections to a stream in the same worker
+  /// share one watch on its updates. If the stream cannot be watched, polls every 10ms instead.
+  void Output::wakeOnData(uint64_t ms){
+    if (updateFd != -1 && updateFdStream != streamName){
+      DTSC::unwatchUpdates(updateFdStream);
+      updateFd = -1;
+    }
+    if (updateFd == -1 && streamName.size()){
+      updateFd = DTSC::watchUpdates(streamName);
+      if (updateFd != -1){updateFdStream = streamName;}
+    }
+    if (updateFd == -1){ms = std::min(ms, (uint64_t)10);}
+    waitingForData = (updateFd != -1);
+    wakeIn(ms);
   }
 
   /// Connects or reconnects to the stream.
@@ -501,12 +528,13 @@ namespace Mist{
 
   uint64_t Output::pageNumForKey(size_t trackId, size_t keyNum){
     const Util::RelAccX &tPages = M.pages(trackId);
+    const DTSC::PageSchema &P = M.pageFields(trackId);
     for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      uint64_t pageNum = tPages.getInt("firstkey", i);
+      uint64_t pageNum = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i);
       if (pageNum > keyNum) continue;
-      uint64_t pageKeys = tPages.getInt("keycount", i);
+      uint64_t pageKeys = tPages.getInt(P[DTSC::PAGE_KEYCOUNT], i);
       if (keyNum > pageNum + pageKeys - 1) continue;
-      uint64_t pageAvail = tPages.getInt("avail", i);
+      uint64_t pageAvail = tPages.getInt(P[DTSC::PAGE_AVAIL], i);
       return pageAvail == 0 ? INVALID_KEY_NUM : pageNum;
     }
     return INVALID_KEY_NUM;
@@ -515,9 +543,10 @@ namespace Mist{
   /// Gets the highest page number available for the given trackId.
   uint64_t Output::pageNumMax(size_t trackId){
     const Util::RelAccX &tPages = M.pages(trackId);
+    const DTSC::PageSchema &P = M.pageFields(trackId);
     uint64_t highest = 0;
     for (uint64_t i = tPages.getDeleted(); i < tPages.getEndPos(); i++){
-      uint64_t pageNum = tPages.getInt("firstkey", i);
+      uint64_t pageNum = tPages.getInt(P[DTSC::PAGE_FIRSTKEY], i);
       if (pageNum > highest){highest = pageNum;}
     }
     return highest;
@@ -1180,7 +1209,7 @@ namespace Mist{
         if (Util::bootSecs() - lastRecv > 300){
           WARN_MSG("Disconnecting 5 minute idle connection");
           onFail("Connection idle for 5 minutes");
-        }else{
+        }else if (!workerMode){
           Util::sleep(20);
         }
       }
@@ -1196,6 +1225,20 @@ namespace Mist{
     Util::wait(millis);
   }
 
+  /// Waits at most the given amount of millis for the input to add a packet to the given track,
+  /// where generation is the track's update generation from before we last looked for data.
+  /// Increases the realtime playback related times by the time waited, like playbackSleep.
+  /// Returns the amount of millis waited.
+  uint64_t Output::playbackWait(size_t trackIdx, uint32_t generation, uint64_t millis){
+    uint64_t start = Util::bootMS();
+    M.waitForTrackUpdate(trackIdx, generation, millis);
+    uint64_t waited = Util::bootMS() - start;
+    if (realTime && M.getLive() && buffer.getSyncMode()){
+      firstTime += waited;
+    }
+    return waited;
+  }
+
   /// Called right before sendNext(). Should return true if this is a stopping point.
   bool Output::reachedPlannedStop(){
     // If we're recording to file and reached the target position, stop
@@ -1283,11 +1326,7 @@ namespace Mist{
       }
     }
     // Handle CONN_OPEN trigger, if needed
-    if (Triggers::shouldTrigger("CONN_OPEN", streamName)){
-      std::string payload =
-          streamName + "\n" + getConnectedHost() + "\n" + capa["name"].asStringRef() + "\n" + reqUrl;
-      if (!Triggers::doTrigger("CONN_OPEN", payload, streamName)){return 1;}
-    }
+    if (!connOpenTrigger()){return 1;}
     /*LTS-END*/
     DONTEVEN_MSG("MistOut client handler started");
     while (keepGoing() && (wantRequest || parseData)){
@@ -1423,6 +1462,100 @@ namespace Mist{
       }
       stats();
     }
+    closeClient();
+    return 0;
+  }
+
+  /// Handles the CONN_OPEN trigger, if needed. Returns false if the connection was denied.
+  bool Output::connOpenTrigger(){
+    if (Triggers::shouldTrigger("CONN_OPEN", streamName)){
+      std::string payload =
+          streamName + "\n" + getConnectedHost() + "\n" + capa["name"].asStringRef() + "\n" + reqUrl;
+      if (!Triggers::doTrigger("CONN_OPEN", payload, streamName)){return false;}
+    }
+    return true;
+  }
+
+  /// Worker mode counterpart of run(), called by the worker event loop whenever the connection
+  /// has data waiting, the time requested through wakeIn() has passed, or the stream waited for
+  /// through wakeOnData() was updated. Handles all completely received requests, but never waits:
+  /// output the client can't take yet is queued on the connection for the worker to send, and
+  /// where run() would wait for stream data, it returns so the worker can serve its other
+  /// connections meanwhile. Returns false once the connection is done with; call closeClient()
+  /// afterwards, once the worker has sent whatever is still queued.
+  bool Output::serveRequests(){
+    wakeTime = 0;
+    waitingForData = false;
+    if (!workerMode){
+      workerMode = true;
+      setBlocking(false);
+      myConn.setQueued(true);
+      // The cache lives per process; don't apply the previous connection's session settings
+      Comms::sessionConfigCache(true);
+      if (!connOpenTrigger()){return false;}
+    }
+    // Stop producing output for a slow client until the worker has sent what is queued already
+    while (keepGoing() && (wantRequest || parseData) && myConn.queuedBytes() < WORKER_SEND_QUEUE){
+      Comms::sessionConfigCache();
+      if (!parseData){
+        // Without a complete request, wait for the event loop to report more data
+        bool received = myConn.spool();
+        requestHandler();
+        if (wakeTime || (!parseData && !received)){break;}
+        continue;
+      }
+      if (wantRequest){
+        requestHandler();
+        if (wakeTime){break;}
+      }
+      if (!isInitialized){
+        initialize();
+        if (!isInitialized){
+          onFail("Stream initialization failed");
+          break;
+        }
+      }
+      if (!sentHeader && keepGoing()){sendHeader();}
+      if (!wantRequest && !parseData){continue;}
+      if (!sought){initialSeek();}
+      if (prepareNext()){
+        if (thisPacket){
+          lastPacketTime = thisTime;
+          if (firstPacketTime == 0xFFFFFFFFFFFFFFFFull){firstPacketTime = lastPacketTime;}
+          sendNext();
+        }else if (wakeTime){
+          // The buffer is played out; try again once it may have refilled
+          break;
+        }else{
+          parseData = false;
+          /*LTS-START*/
+          if (Triggers::shouldTrigger("CONN_STOP", streamName)){
+            std::string payload =
+                streamName + "\n" + getConnectedHost() + "\n" + capa["name"].asStringRef() + "\n";
+            Triggers::doTrigger("CONN_STOP", payload, streamName);
+          }
+          /*LTS-END*/
+          if (!onFinish()){
+            Util::logExitReason(ER_CLEAN_EOF, "end of stream");
+            return false;
+          }
+        }
+      }else if (wakeTime){
+        // Waiting for live data to arrive
+        break;
+      }
+      if (!meta){
+        Util::logExitReason(ER_SHM_LOST, "lost internal connection to stream data");
+        return false;
+      }
+    }
+    stats();
+    return keepGoing() && (wantRequest || parseData);
+  }
+
+  /// Cleans up after the client is done with: logs the exit reason, fires the closing triggers,
+  /// disconnects from the stream and closes the connection.
+  void Output::closeClient(){
     if (!config->is_active){Util::logExitReason(ER_UNKNOWN, "set inactive");}
     if (!myConn){Util::logExitReason(ER_CLEAN_REMOTE_CLOSE, "connection closed");}
     if (strncmp(Util::exitReason, "connection closed", 17) == 0){
@@ -1463,7 +1596,6 @@ namespace Mist{
     disconnect();
     stats(true);
     myConn.close();
-    return 0;
   }
 
   void Output::dropTrack(size_t trackId, const std::string &reason, bool probablyBad){
@@ -1561,12 +1693,15 @@ namespace Mist{
   /// \returns false if we could not reliably determine the next packet yet.
   bool Output::prepareNext(){
     // Only allow a few times to do this
-    static uint8_t bufferRetries = 50;
     if (!buffer.size() && --bufferRetries){
       thisPacket.null();
       if (bufferRetries){
         HIGH_MSG("Buffer completely played out, sleeping");
-        Util::sleep(100);
+        if (workerMode){
+          wakeOnData(100);
+        }else{
+          Util::sleep(100);
+        }
       }else{
         FAIL_MSG("Buffer completely played out, exiting");
         Util::logExitReason(ER_CLEAN_EOF, "Buffer completely played out, exiting");
@@ -1590,6 +1725,7 @@ namespace Mist{
 
     uint64_t nextTime;
     size_t trackTries = 0;
+    uint32_t streamGen = M.getUpdateGeneration();
     //In case we're not in sync mode, we might have to retry a few times
     for (; trackTries < buffer.size(); ++trackTries){
 
@@ -1602,6 +1738,8 @@ namespace Mist{
         config->is_active = false;
         return false;
       }
+      // Read before looking for data, so a packet added after we looked will end the wait below
+      uint32_t trackGen = M.getTrackGeneration(nxt.tid);
 
       // if we're going to read past the end of the data page, load the next page
       // this only happens for VoD
@@ -1705,29 +1843,46 @@ namespace Mist{
         continue;
       }
 
+      //Fine! We didn't want a packet, anyway. Wait for the input to add one, then try again.
+      //Outputs that still handle requests keep waiting in short steps, to stay responsive.
+      //In worker mode, don't wait at all: the worker calls us again once the stream was updated.
+      //The wait is counted in the same 10ms steps, from the time it began.
+      size_t prevEmptyCount = emptyCount;
+      if (workerMode){
+        uint64_t now = Util::bootMS();
+        if (!emptyCount){dataWaitStart = now;}
+        emptyCount = (now - dataWaitStart) / 10 + 1;
+        wakeOnData(WORKER_DATA_WAIT_MS);
+      }else{
+        uint64_t waited = playbackWait(nxt.tid, trackGen, wantRequest ? 10 : LIVE_DATA_WAIT_MS);
+        emptyCount += (waited > 10) ? (waited + 9) / 10 : 1;
+      }
+
       // in sync mode, after ~120 seconds, give up and drop the track.
-      if ((++emptyCount >= dataWaitTimeout)){
+      if (emptyCount >= dataWaitTimeout){
         thisPacket.null();
         Util::logExitReason(ER_CLEAN_EOF, "EOP: data wait timeout");
         config->is_active = false;
         return false;
       }
-      //every ~5 second, check if the stream is not offline
-      if (emptyCount % 100 == 0 && M.getLive() && Util::getStreamStatus(streamName) == STRMSTAT_OFF){
+      //every ~second, check if the stream is not offline
+      if (emptyCount / 100 != prevEmptyCount / 100 && M.getLive() && Util::getStreamStatus(streamName) == STRMSTAT_OFF){
         thisPacket.null();
         Util::logExitReason(ER_CLEAN_EOF, "stream went offline");
         config->is_active = false;
         return false;
       }
-
-      //Fine! We didn't want a packet, anyway. Let's try again later.
-      playbackSleep(10);
       return false;
     }
 
     if (trackTries == buffer.size()){
-      //Fine! We didn't want a packet, anyway. Let's try again later.
-      playbackSleep(10);
+      //Fine! We didn't want a packet, anyway. Wait for the input to add one to any track, then try again.
+      //We only get here in non-sync mode, so there are no realtime playback times to correct.
+      if (workerMode){
+        wakeOnData(WORKER_DATA_WAIT_MS);
+      }else{
+        M.waitForUpdate(streamGen, wantRequest ? 10 : LIVE_DATA_WAIT_MS);
+      }
       return false;
     }
 
@@ -1752,14 +1907,8 @@ namespace Mist{
       return false;
     }
 
-    //Update keynum only after every ~5th second in the timestamp
-    //We do this because DTSC::Keys is pretty CPU-heavy
-    // TODO: Experimentally tweak (5000) and check reliability
-    if ((prevKeyTime == 0xFFFFFFFFFFFFFFFFull) || (nxt.time > prevKeyTime + 5000)){
-      prevKeyTime = nxt.time;
-      uint32_t thisKey = M.getKeyNumForTime(nxt.tid, nxt.time);
-      userSelect[nxt.tid].setKeyNum(thisKey);
-    }
+    // Key lookups are a binary search, so the keynum can be kept up to date for every packet
+    userSelect[nxt.tid].setKeyNum(M.getKeyNumForTime(nxt.tid, nxt.time));
 
     // we assume the next packet is the next on this same page
     nxt.offset += thisPacket.getDataLen();
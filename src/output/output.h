@@ -34,6 +34,10 @@ namespace Mist{
     // non-virtual generic functions
     bool abortFileRecording();
     virtual int run();
+    bool serveRequests();
+    void closeClient();
+    uint64_t getWakeTime(){return wakeTime;}
+    int getWakeFd(){return waitingForData ? updateFd : -1;}
     virtual void stats(bool force = false);
     bool seek(uint64_t pos, bool toKey = false);
     bool seek(size_t tid, uint64_t pos, bool getNextKey);
@@ -71,6 +75,7 @@ namespace Mist{
     virtual void requestHandler();
     static Util::Config *config;
     void playbackSleep(uint64_t millis);
+    uint64_t playbackWait(size_t trackIdx, uint32_t generation, uint64_t millis);
 
     void selectAllTracks();
 
@@ -97,12 +102,17 @@ namespace Mist{
                           ///< prepareNext().
     std::string prevHost; ///< Old value for getConnectedBinHost, for caching
     size_t emptyCount;
+    uint8_t bufferRetries; ///< Attempts left to wait for a played out buffer to refill.
+    uint64_t wakeTime;     ///< In worker mode, Util::bootMS() at which serveRequests wants to run again.
+    int updateFd;          ///< In worker mode, eventfd signalled on updates of updateFdStream, or -1.
+    std::string updateFdStream; ///< Stream that updateFd watches.
+    bool waitingForData;   ///< In worker mode, if true serveRequests also wants to run when updateFd fires.
+    uint64_t dataWaitStart; ///< In worker mode, Util::bootMS() at which the current wait for live data began.
     bool recursingSync;
     uint32_t seekCount;
     bool firstData;
     uint64_t lastPushUpdate;
     bool newUA;
-    uint64_t prevKeyTime;
 
   protected:              // these are to be messed with by child classes
     virtual bool inlineRestartCapable() const{
@@ -115,6 +125,10 @@ namespace Mist{
     uint64_t lastRecv;
     uint64_t dataWaitTimeout; ///< How long to wait for new packets before dropping a track, in tens of milliseconds.
     uint64_t firstTime; ///< Time of first packet after last seek. Used for real-time sending.
+    bool connOpenTrigger();
+    /// In worker mode, has serveRequests return and be called again after at most ms milliseconds.
+    void wakeIn(uint64_t ms){wakeTime = Util::bootMS() + ms;}
+    void wakeOnData(uint64_t ms);
     virtual std::string getConnectedHost();
     virtual std::string getConnectedBinHost();
     virtual std::string getStatsName();
@@ -127,6 +141,7 @@ namespace Mist{
 
     Comms::Connections statComm;
     bool isBlocking; ///< If true, indicates that myConn is blocking.
+    bool workerMode; ///< If true, run by the event loop of a worker process through serveRequests().
     std::string tkn;    ///< Random identifier used to split connections into sessions
     uint64_t nextKeyTime();
 
@@ -83,6 +83,7 @@ namespace Mist{
 
     uaDelay = 0;
     realTime = 0;
+    deferUntil = 0;
     if (config->getString("target").size()){
       needsLookAhead = 5000;
 
@@ -203,6 +204,15 @@ namespace Mist{
     capa["optional"]["chunkpath"]["short"] = "e";
     capa["optional"]["chunkpath"]["default"] = "";
 
+    capa["optional"]["workers"]["name"] = "Worker processes";
+    capa["optional"]["workers"]["help"] =
+        "Serve connections from this many event-driven worker processes instead of one process "
+        "per connection. Only applies when listening on a dedicated port. (0 = disabled)";
+    capa["optional"]["workers"]["default"] = 0;
+    capa["optional"]["workers"]["type"] = "uint";
+    capa["optional"]["workers"]["option"] = "--workers";
+    capa["optional"]["workers"]["short"] = "W";
+
     capa["push_urls"].append("cmaf://*");
     capa["push_urls"].append("cmafs://*");
 
@@ -233,15 +243,23 @@ namespace Mist{
         hlsMediaFormat == ".ts",
         getMainSelectedTrack(),
         H.GetHeader("User-Agent"),
-        (Comms::tknMode & 0x04)?tkn:"",
+        (tkn.size() && Comms::tknMode & 0x04) ? HLS::sessionPlaceholder : "",
         systemBoot,
         bootMsOffset,
     };
 
-    std::stringstream result;
-    HLS::addMasterManifest(result, M, userSelect, masterData);
+    std::string manifest;
+    if (!manifestCache.get(streamName, HLS::masterManifestVariant(userSelect, masterData),
+                           HLS::masterManifestVersion(M, masterData), manifest,
+                           workerMode ? 0 : HLS_MANIFEST_WAIT)){
+      std::stringstream result;
+      HLS::addMasterManifest(result, M, userSelect, masterData);
+      manifest = result.str();
+      manifestCache.set(manifest);
+    }
+    if (masterData.sessId.size()){HLS::fillSession(manifest, tkn);}
 
-    H.SetBody(result.str());
+    H.SetBody(manifest);
     H.SendResponse("200", "OK", myConn);
   }
 
@@ -270,7 +288,7 @@ namespace Mist{
         noLLHLS,
         hlsMediaFormat,
         M.getEncryption(requestTid),
-        (Comms::tknMode & 0x04)?tkn:"",
+        (tkn.size() && Comms::tknMode & 0x04) ? HLS::sessionPlaceholder : "",
         timingTid,
         requestTid,
         M.biggestFragment(timingTid) / 1000,
@@ -285,7 +303,15 @@ namespace Mist{
     DTSC::Fragments fragments(M.fragments(trackData.timingTrackId));
     DTSC::Keys keys(M.keys(trackData.timingTrackId));
 
-    uint32_t bprErrCode = HLS::blockPlaylistReload(M, userSelect, trackData, hlsSpec, fragments, keys);
+    // Worker processes retry the request instead of blocking until the playlist is ready
+    uint32_t bprErrCode = HLS::blockPlaylistReload(M, userSelect, trackData, hlsSpec, fragments,
+                                                   keys, workerMode ? &deferUntil : 0);
+    if (bprErrCode == HLS::bprPending){
+      uint64_t now = Util::bootMS();
+      deferRequest(deferUntil > now ? deferUntil - now : 0);
+      return;
+    }
+    deferUntil = 0;
     if (bprErrCode == 400){
       H.SendResponse("400", "Bad Request: Invalid LLHLS parameter", myConn);
       return;
@@ -297,12 +323,20 @@ namespace Mist{
     HLS::FragmentData fragData;
     HLS::populateFragmentData(M, userSelect, fragData, trackData, fragments, keys);
 
-    std::stringstream result;
-    HLS::addStartingMetaTags(result, fragData, trackData, hlsSpec);
-    HLS::addMediaFragments(result, M, fragData, trackData, fragments, keys);
-    HLS::addEndingTags(result, M, userSelect, fragData, trackData);
+    std::string manifest;
+    if (!manifestCache.get(streamName, HLS::mediaManifestVariant(trackData, hlsSpec),
+                           HLS::mediaManifestVersion(fragData, trackData, fragments, keys), manifest,
+                           workerMode ? 0 : HLS_MANIFEST_WAIT)){
+      std::stringstream result;
+      HLS::addStartingMetaTags(result, fragData, trackData, hlsSpec);
+      HLS::addMediaFragments(result, M, fragData, trackData, fragments, keys);
+      HLS::addEndingTags(result, M, userSelect, fragData, trackData);
+      manifest = result.str();
+      manifestCache.set(manifest);
+    }
+    if (trackData.sessionId.size()){HLS::fillSession(manifest, tkn);}
 
-    H.SetBody(result.str());
+    H.SetBody(manifest);
     H.SendResponse("200", "OK", myConn);
   }// namespace Mist
 
@@ -419,7 +453,14 @@ namespace Mist{
     // set targetTime
     if (sscanf(url.c_str(), "%*d/chunk_%" PRIu64 ".%" PRIu32 ".*", &startTime, &part) == 2){
       // Logic: calculate targetTime for partial segments
-      targetTime = HLS::getPartTargetTime(M, idx, mTrack, startTime, msn, part);
+      // Worker processes retry the request until the part is ready instead of blocking
+      if (workerMode && !HLS::partReady(M, idx, mTrack, startTime, part, deferUntil)){
+        uint64_t now = Util::bootMS();
+        deferRequest(deferUntil > now ? deferUntil - now : 0);
+        return;
+      }
+      deferUntil = 0;
+      targetTime = HLS::getPartTargetTime(M, idx, mTrack, startTime, msn, part, !workerMode);
       if (!targetTime){
         H.SendResponse("404", "Partial fragment does not exist", myConn);
         return;
@@ -1,5 +1,6 @@
 #include "output_http.h"
 #include <mist/downloader.h>
+#include <mist/hls_support.h>
 #include <mist/http_parser.h>
 // #include <mist/mp4_generic.h>
 
@@ -54,6 +55,7 @@ namespace Mist{
     void sendHlsManifest(const std::string url);
     void sendHlsMasterManifest();
     void sendHlsMediaManifest(const size_t requestTid);
+    HLS::ManifestCache manifestCache; ///< Playlists shared with the other viewers of the stream
 
     void sendSmoothManifest();
     std::string smoothManifest(bool checkAlignment = true);
@@ -64,6 +66,7 @@ namespace Mist{
     bool tracksAligned(const std::set<size_t> &trackList);
     std::string buildNalUnit(size_t len, const char *data);
     uint64_t targetTime;
+    uint64_t deferUntil; ///< Deadline for the LL-HLS wait of a deferred request, 0 if none.
 
     std::string h264init(const std::string &initData);
     std::string h265init(const std::string &initData);
@@ -201,7 +201,7 @@ namespace Mist{
     }
 
     DTSC::Packet p(thisPacket, thisIdx + 1);
-    EBML::sendSimpleBlock(myConn, p, currentClusterTime, M.getType(thisIdx) != "video");
+    EBML::sendSimpleBlock(myConn, p, currentClusterTime, M.getTypeId(thisIdx) != DTSC::TYPE_VIDEO);
   }
 
   std::string OutEBML::trackCodecID(size_t idx){
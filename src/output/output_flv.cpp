@@ -75,7 +75,7 @@ namespace Mist{
       }
     }
     tag.DTSCLoader(thisPacket, M, thisIdx);
-    if (M.getCodec(thisIdx) == "PCM" && M.getSize(thisIdx) == 16){
+    if (M.getCodecId(thisIdx) == DTSC::CODEC_PCM && M.getSize(thisIdx) == 16){
       char *ptr = tag.getData();
       uint32_t ptrSize = tag.getDataLen();
       for (uint32_t i = 0; i < ptrSize; i += 2){
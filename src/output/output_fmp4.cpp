@@ -353,7 +353,7 @@ namespace Mist{
     myConn.SendNow(mdatHeader, 8);
   }
 
-  void OutfMP4::bufferData(const std::string &trackType){
+  void OutfMP4::bufferData(DTSC::trackType trackType){
     // Obtain a pointer to the data of this packet and store it's length
     char *dataPointer = 0;
     thisPacket.getString("data", dataPointer, thisPktSize);
@@ -361,7 +361,7 @@ namespace Mist{
     // We keep buffering the video data until:
     // - split seconds were reached, and
     // - a video keyframe was found
-    if (trackType == "video"){
+    if (trackType == DTSC::TYPE_VIDEO){
       // Now append the incoming data
       videoMdatBuffer.append(dataPointer, thisPktSize);
       videoMdatBufferSize += thisPktSize;
@@ -371,7 +371,7 @@ namespace Mist{
 
     // Keep buffering the audio data until:
     // - video split point was reached
-    if (trackType == "audio"){
+    if (trackType == DTSC::TYPE_AUDIO){
       if (!startAudioPktTime){
         startAudioPktTime = thisPacket.getTime();
       }
@@ -631,12 +631,12 @@ namespace Mist{
     thisPktTime = thisPacket.getTime();
 
     // Store this packet's track type
-    std::string trackType = M.getType(thisIdx);
+    DTSC::trackType trackType = M.getTypeId(thisIdx);
 
-    if (trackType == "video"){
+    if (trackType == DTSC::TYPE_VIDEO){
       prevVGetTime = Util::bootMS();
     }
-    if (trackType == "audio"){
+    if (trackType == DTSC::TYPE_AUDIO){
       prevAGetTime = Util::bootMS();
     }
     uint64_t trackDiffAV = (prevVGetTime > prevAGetTime)
@@ -652,7 +652,7 @@ namespace Mist{
       }
     }
 
-    if (!firstKeyPktTime && trackType == "video"){
+    if (!firstKeyPktTime && trackType == DTSC::TYPE_VIDEO){
       // First key time will be the first packet's time (after seek)
       firstKeyPktTime = thisPktTime;
     }
@@ -664,7 +664,7 @@ namespace Mist{
     }
 
     uint64_t pktInterval = thisPktTime - firstKeyPktTime;
-    if ((pktInterval > splitTime) && (trackType == "video") && (thisPacket.getFlag("keyframe"))){
+    if ((pktInterval > splitTime) && (trackType == DTSC::TYPE_VIDEO) && (thisPacket.getFlag("keyframe"))){
       performPublish(currentFileTime, pktInterval-thisPktTime);
       if (!config->is_active){
         return;
@@ -673,11 +673,11 @@ namespace Mist{
     }
 
     // Store the previous audio packet's time
-    if (trackType == "video"){
+    if (trackType == DTSC::TYPE_VIDEO){
       prevVideoPktTime = thisPktTime;
     }
     // Store the previous audio packet's time
-    if (trackType == "audio"){
+    if (trackType == DTSC::TYPE_AUDIO){
       prevAudioPktTime = thisPktTime;
     }
   }
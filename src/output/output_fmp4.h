@@ -76,7 +76,7 @@ namespace Mist{
       uint32_t removeOldFmp4(std::vector<std::string> &playlist);
       void sendFirst();
       void sendInit();
-      void bufferData(const std::string &trackType);
+      void bufferData(DTSC::trackType trackType);
       void flushVideo();
       void flushAudio();
       void performPublish(uint64_t currentFileTime, uint64_t pktInterval);
@@ -390,7 +390,7 @@ namespace Mist{
       }
 
       // Handle nice move-over to new track ID
-      if (prevVidTrack != INVALID_TRACK_ID && thisIdx != prevVidTrack && M.getType(thisIdx) == "video"){
+      if (prevVidTrack != INVALID_TRACK_ID && thisIdx != prevVidTrack && M.getTypeId(thisIdx) == DTSC::TYPE_VIDEO){
         if (!thisPacket.getFlag("keyframe")){
           // Ignore the packet if not a keyframe
           return;
@@ -415,7 +415,7 @@ namespace Mist{
       }
 
       size_t lenSize = 4;
-      if (M.getCodec(thisIdx) == "H264"){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
+      if (M.getCodecId(thisIdx) == DTSC::CODEC_H264){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
       unsigned int i = 0;
       uint32_t ThisNaluSize;
       while (i + 4 < len){
@@ -439,7 +439,7 @@ namespace Mist{
     }
 
     size_t lenSize = 4;
-    if (M.getCodec(thisIdx) == "H264"){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
+    if (M.getCodecId(thisIdx) == DTSC::CODEC_H264){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
     unsigned int i = 0;
     uint32_t ThisNaluSize;
     while (i + 4 < len){
@@ -17,6 +17,19 @@ namespace Mist{
   
   bool OutHLS::listenMode(){return !(config->getString("ip").size());}
 
+  /// Returns true if the given fragment may be served from / stored in the shared segment cache.
+  /// Only complete fragments of live streams qualify, for which all selected tracks have data.
+  bool OutHLS::segmentCacheable(size_t fragIdx){
+    if (!M.getLive()){return false;}
+    DTSC::Fragments fragments(M.fragments(vidTrack));
+    if (fragIdx < fragments.getFirstValid() || fragIdx >= fragments.getEndValid()){return false;}
+    if (!fragments.getDuration(fragIdx)){return false;}
+    for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); ++it){
+      if (M.getLastms(it->first) < until){return false;}
+    }
+    return true;
+  }
+
   ///\brief Builds an index file for HTTP Live streaming.
   ///\return The index file for HTTP Live Streaming.
   std::string OutHLS::liveIndex(){
@@ -31,7 +44,7 @@ namespace Mist{
       if (!hasSubs && M.getCodec(it->first) == "subtitle"){hasSubs = true;}
     }
     std::string tknStr;
-    if (tkn.size() && Comms::tknMode & 0x04){tknStr = "?tkn=" + tkn;}
+    if (tkn.size() && Comms::tknMode & 0x04){tknStr = "?tkn=" + HLS::sessionPlaceholder;}
     for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); ++it){
       if (M.getType(it->first) == "video"){
         ++vidTracks;
@@ -164,7 +177,9 @@ namespace Mist{
     realTime = 0;
     until = 0xFFFFFFFFFFFFFFFFull;
     // If this connection is a socket and not already connected to stdio, connect it to stdio.
-    if (myConn.getPureSocket() != -1 && myConn.getSocket() != STDIN_FILENO && myConn.getSocket() != STDOUT_FILENO){
+    // Worker processes serve many connections at once, so there each keeps its own socket.
+    if (!Util::Config::is_worker && myConn.getPureSocket() != -1 &&
+        myConn.getSocket() != STDIN_FILENO && myConn.getSocket() != STDOUT_FILENO){
       std::string host = getConnectedHost();
       dup2(myConn.getSocket(), STDIN_FILENO);
       dup2(myConn.getSocket(), STDOUT_FILENO);
@@ -239,6 +254,15 @@ namespace Mist{
     capa["optional"]["chunkpath"]["option"] = "--chunkpath";
     capa["optional"]["chunkpath"]["short"] = "e";
     capa["optional"]["chunkpath"]["default"] = "";
+
+    capa["optional"]["workers"]["name"] = "Worker processes";
+    capa["optional"]["workers"]["help"] =
+        "Serve connections from this many event-driven worker processes instead of one process "
+        "per connection. Only applies when listening on a dedicated port. (0 = disabled)";
+    capa["optional"]["workers"]["default"] = 0;
+    capa["optional"]["workers"]["type"] = "uint";
+    capa["optional"]["workers"]["option"] = "--workers";
+    capa["optional"]["workers"]["short"] = "W";
     cfg->addConnectorOptions(8081, capa);
   }
 
@@ -374,6 +398,23 @@ namespace Mist{
       contPAT = fragIndice; // PAT continuity counter
       contPMT = fragIndice; // PMT continuity counter
       contSDT = fragIndice; // SDT continuity counter
+
+      // Segments are muxed deterministically, so viewers of the same fragment can share the result
+      if (segmentCacheable(fragIndice)){
+        std::set<size_t> segTracks;
+        for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); ++it){
+          segTracks.insert(it->first);
+        }
+        // Worker processes don't wait for other writers; they mux the segment themselves instead
+        if (segCache.open(streamName, segTracks, fragIndice, from, until, M.getBootMsOffset(),
+                          workerMode ? 0 : HLS_SEGMENT_WAIT) == HLS::SegmentCache::HIT){
+          H.Chunkify(segCache.data(), segCache.size(), myConn);
+          H.Chunkify("", 0, myConn);
+          H.Clean();
+          segCache.close();
+          return;
+        }
+      }
       packCounter = 0;
       parseData = true;
       wantRequest = false;
@@ -393,22 +434,52 @@ namespace Mist{
         return;
       }
       std::string manifest;
+      bool withTkn = tkn.size() && Comms::tknMode & 0x04;
+      // Playlists only change when fragments are added or removed, so they're shared between
+      // viewers with the session token filled in afterwards
+      HLS::ManifestVersion version ={0, 0, 0, 0, M.getBootMsOffset()};
+      std::stringstream variant;
+      variant << "hls" << (withTkn ? ":tkn" : "");
       if (request.find("/") == std::string::npos){
-        manifest = liveIndex();
+        selectDefaultTracks();
+        size_t mainTrack = M.mainTrack();
+        if (mainTrack != INVALID_TRACK_ID){version.lastFrag = DTSC::Fragments(M.fragments(mainTrack)).getEndValid();}
+        for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); ++it){
+          variant << ":" << it->first;
+        }
+        if (!manifestCache.get(streamName, variant.str(), version, manifest, workerMode ? 0 : HLS_MANIFEST_WAIT)){
+          manifest = liveIndex();
+          manifestCache.set(manifest);
+        }
       }else{
         size_t idx = atoi(request.substr(0, request.find("/")).c_str());
         if (!M.getValidTracks().count(idx)){
           H.SendResponse("404", "No corresponding track found", myConn);
           return;
         }
+        size_t timingTid = idx;
+        if (M.getType(timingTid) != "video"){timingTid = M.mainTrack();}
+        if (timingTid == INVALID_TRACK_ID){timingTid = idx;}
+        DTSC::Fragments fragments(M.fragments(timingTid));
+        version.firstFrag = fragments.getFirstValid();
+        version.lastFrag = fragments.getEndValid();
+        version.targetDuration = M.biggestFragment(timingTid);
+        std::string urlPrefix;
         if (config->getString("chunkpath").size()){
-          manifest = liveIndex(idx, "", HTTP::URL(config->getString("chunkpath")).link(reqUrl).link("./").getUrl());
-        }else{
-          std::string tknStr;
-          if (tkn.size() && Comms::tknMode & 0x04){tknStr = "?tkn=" + tkn;}
-          manifest = liveIndex(idx, tknStr);
+          urlPrefix = HTTP::URL(config->getString("chunkpath")).link(reqUrl).link("./").getUrl();
+        }
+        variant << ":" << idx << ":" << (M.getLive() ? "live" : "vod") << ":"
+                << config->getInteger("listlimit") << ":" << urlPrefix;
+        if (!manifestCache.get(streamName, variant.str(), version, manifest, workerMode ? 0 : HLS_MANIFEST_WAIT)){
+          if (urlPrefix.size()){
+            manifest = liveIndex(idx, "", urlPrefix);
+          }else{
+            manifest = liveIndex(idx, withTkn ? "?tkn=" + HLS::sessionPlaceholder : "");
+          }
+          manifestCache.set(manifest);
         }
       }
+      if (withTkn){HLS::fillSession(manifest, tkn);}
       H.SetBody(manifest);
       H.SendResponse("200", "OK", myConn);
     }
@@ -435,6 +506,13 @@ namespace Mist{
         }
       }
 
+      flushTS();
+      if (segCache.isWriting()){
+        DTSC::Fragments fragments(M.fragments(vidTrack));
+        segCache.finish(fragments);
+      }
+      segCache.close();
+
       // Signal end of data
       H.Chunkify("", 0, myConn);
       H.Clean();
@@ -444,9 +522,21 @@ namespace Mist{
     TSOutput::sendNext();
   }
 
-  void OutHLS::sendTS(const char *tsData, size_t len){H.Chunkify(tsData, len, myConn);}
+  void OutHLS::sendTS(const char *tsData, size_t len){
+    segCache.write(tsData, len);
+    tsBatch.append(tsData, len);
+    if (tsBatch.size() >= TS_SEND_BATCH){flushTS();}
+  }
+
+  /// Sends all collected TS packets as a single HTTP chunk
+  void OutHLS::flushTS(){
+    if (!tsBatch.size()){return;}
+    H.Chunkify(tsBatch, tsBatch.size(), myConn);
+    tsBatch.truncate(0);
+  }
 
   void OutHLS::onFail(const std::string &msg, bool critical){
+    segCache.close();
     if (HTTP::URL(H.url).getExt().substr(0, 3) != "m3u"){
       HTTPOutput::onFail(msg, critical);
       return;
@@ -1,5 +1,6 @@
 #include "output_http.h"
 #include "output_ts_base.h"
+#include <mist/hls_support.h>
 
 namespace Mist{
   class OutHLS : public TSOutput{
@@ -8,6 +9,7 @@ namespace Mist{
     ~OutHLS();
     static void init(Util::Config *cfg);
     void sendTS(const char *tsData, size_t len = 188);
+    void flushTS();
     void sendNext();
     void onHTTP();
     bool isReadyForPlay();
@@ -19,10 +21,13 @@ namespace Mist{
     std::string h265init(const std::string &initData);
     std::string liveIndex();
     std::string liveIndex(size_t tid, const std::string &sessId, const std::string &urlPrefix = "");
+    bool segmentCacheable(size_t fragIdx);
 
     size_t vidTrack;
     size_t audTrack;
     uint64_t until;
+    HLS::SegmentCache segCache; ///< Shared pre-muxed copy of the segment being sent
+    HLS::ManifestCache manifestCache; ///< Playlists shared with the other viewers of the stream
   };
 }// namespace Mist
 
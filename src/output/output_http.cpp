@@ -13,6 +13,7 @@ namespace Mist{
     webSock = 0;
     idleInterval = 0;
     idleLast = 0;
+    requestDeferred = false;
     if (config->getString("ip").size()){
       trueHost = myConn.getHost();
       myConn.setHost(config->getString("ip"));
@@ -20,7 +21,9 @@ namespace Mist{
     if (config->getString("prequest").size()){
       myConn.Received().prepend(config->getString("prequest"));
     }
-    config->activate();
+    // Worker processes were activated before forking; doing it again per connection would
+    // drop permissions and reinstall the signal handlers for every client.
+    if (!Util::Config::is_worker){config->activate();}
   }
 
   HTTPOutput::~HTTPOutput(){
@@ -195,10 +198,22 @@ namespace Mist{
         idleLast = Util::bootMS();
         return;
       }
-      if (!isBlocking && !parseData){Util::sleep(100);}
+      if (!isBlocking && !parseData && !workerMode){Util::sleep(100);}
       return;
     }
 
+    // Retry a request that was deferred while waiting for data
+    if (requestDeferred){
+      requestDeferred = false;
+      responded = false;
+      onHTTP();
+      if (requestDeferred){return;}
+      stats(true);
+      idleLast = Util::bootMS();
+      if (!wantRequest){return;}
+      H.Clean();
+    }
+
     //Attempt to read a HTTP request, regardless of data being available
     bool sawRequest = false;
     while (H.Read(myConn)){
@@ -332,6 +347,7 @@ namespace Mist{
       preHTTP();
       if (!myConn){return;}
       onHTTP();
+      if (requestDeferred){return;}
       stats(true);
       idleLast = Util::bootMS();
       // Prevent the clean as well as the loop when we're in the middle of handling a request now
@@ -339,7 +355,8 @@ namespace Mist{
       H.Clean();
     }
     // If we can't read anything more and we're non-blocking, sleep some.
-    if (!sawRequest && !myConn.spool() && !isBlocking && !parseData){Util::sleep(100);}
+    // In worker mode, the event loop does the waiting instead.
+    if (!sawRequest && !workerMode && !myConn.spool() && !isBlocking && !parseData){Util::sleep(100);}
   }
 
   /// Default HTTP handler.
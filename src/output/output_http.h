@@ -33,6 +33,14 @@ namespace Mist{
     HTTP::Websocket *webSock;
     uint32_t idleInterval;
     uint64_t idleLast;
+    bool requestDeferred; ///< If true, the current request in H is handled again on the next call.
+    /// In worker mode, ends onHTTP without responding and calls it again for the same request
+    /// once the stream was updated, or after at most ms milliseconds, instead of waiting for data
+    /// inside onHTTP.
+    void deferRequest(uint64_t ms){
+      requestDeferred = true;
+      wakeOnData(ms);
+    }
     std::string getConnectedHost();             // LTS
     std::string getConnectedBinHost();          // LTS
     bool isTrustedProxy(const std::string &ip); // LTS
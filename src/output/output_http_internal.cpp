@@ -9,8 +9,7 @@
 #include <mist/websocket.h>
 #include <sys/stat.h>
 #include <mist/ptvtmp.h>
-#include <mist/sql.h>
-#include <sqlite3.h>
+#include <mist/traffic.h>
 
 struct Interval {double high; double low;};
 std::string geohash(double lat, double lng, int precision = 3){
@@ -474,10 +473,14 @@ namespace Mist{
     try {trafficConsumption = (std::string(getenv("TRAFFIC_CONSUMPTION")) == "ON") ? true : false;}
     catch (const std::exception &ex) {trafficConsumption = false;}
     if (trafficConsumption) {
-      sqlite3 *db = nullptr;
-      Database::loadDatabase(db);
-      JSON::Value columnData = Database::getColumn2(db, streamName);
-      json_resp["traffic"] = columnData;
+      // Published by the controller; kept mapped for the lifetime of this process
+      static Traffic::Snapshot trafficSnapshot;
+      std::string trafficData;
+      if (trafficSnapshot.get(streamName, trafficData)){
+        json_resp["traffic"] = JSON::fromString(trafficData);
+      }else{
+        json_resp["traffic"].null();
+      }
     }
 
     // Make note of any defaultStream-based redirection
@@ -40,7 +40,7 @@ namespace Mist{
       }
     }
     JSON::Value jPack;
-    if (M.getCodec(thisIdx) == "JSON"){
+    if (M.getCodecId(thisIdx) == DTSC::CODEC_JSON){
       char *dPtr;
       size_t dLen;
       thisPacket.getString("data", dPtr, dLen);
@@ -1298,7 +1298,7 @@ namespace Mist{
       }
 
       // Handle nice move-over to new track ID
-      if (prevVidTrack != INVALID_TRACK_ID && thisIdx != prevVidTrack && M.getType(thisIdx) == "video"){
+      if (prevVidTrack != INVALID_TRACK_ID && thisIdx != prevVidTrack && M.getTypeId(thisIdx) == DTSC::TYPE_VIDEO){
         if (!thisPacket.getFlag("keyframe")){
           // Ignore the packet if not a keyframe
           return;
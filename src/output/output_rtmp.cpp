@@ -628,13 +628,13 @@ namespace Mist{
     size_t data_len = 0; // length of processed media data
     thisPacket.getString("data", tmpData, data_len);
 
-    std::string type = M.getType(thisIdx);
-    std::string codec = M.getCodec(thisIdx);
+    DTSC::trackType type = M.getTypeId(thisIdx);
+    DTSC::codecType codec = M.getCodecId(thisIdx);
 
     // set msg_type_id
-    if (type == "video"){
+    if (type == DTSC::TYPE_VIDEO){
       rtmpheader[7] = 0x09;
-      if (codec == "H264"){
+      if (codec == DTSC::CODEC_H264){
         dheader_len += 4;
         dataheader[0] = 7;
         dataheader[1] = 1;
@@ -645,25 +645,25 @@ namespace Mist{
           dataheader[4] = offset & 0xFF;
         }
       }
-      if (codec == "H263"){dataheader[0] = 2;}
+      if (codec == DTSC::CODEC_H263){dataheader[0] = 2;}
       dataheader[0] |= (thisPacket.getFlag("keyframe") ? 0x10 : 0x20);
       if (thisPacket.getFlag("disposableframe")){dataheader[0] |= 0x30;}
     }
 
-    if (type == "audio" && M.trackLoaded(thisIdx)){ // Added track loaded check. But for now, audio is disabled (not setuped for testing purposes)
+    if (type == DTSC::TYPE_AUDIO && M.trackLoaded(thisIdx)){ // Added track loaded check. But for now, audio is disabled (not setuped for testing purposes)
       uint32_t rate = M.getRate(thisIdx);
       rtmpheader[7] = 0x08;
-      if (codec == "AAC"){
+      if (codec == DTSC::CODEC_AAC){
         dataheader[0] += 0xA0;
         dheader_len += 1;
         dataheader[1] = 1; // raw AAC data, not sequence header
       }
-      if (codec == "MP3"){
+      if (codec == DTSC::CODEC_MP3){
         dataheader[0] += 0x20;
         dataheader[0] |= (rate == 8000 ? 0xE0 : 0x20);
       }
-      if (codec == "ADPCM"){dataheader[0] |= 0x10;}
-      if (codec == "PCM"){
+      if (codec == DTSC::CODEC_ADPCM){dataheader[0] |= 0x10;}
+      if (codec == DTSC::CODEC_PCM){
         if (M.getSize(thisIdx) == 16 && swappy.allocate(data_len)){
           for (uint32_t i = 0; i < data_len; i += 2){
             swappy[i] = tmpData[i + 1];
@@ -673,12 +673,12 @@ namespace Mist{
         }
         dataheader[0] |= 0x30;
       }
-      if (codec == "Nellymoser"){
+      if (codec == DTSC::CODEC_NELLYMOSER){
         dataheader[0] |= (rate == 8000 ? 0x50 : (rate == 16000 ? 0x40 : 0x60));
       }
-      if (codec == "ALAW"){dataheader[0] |= 0x70;}
-      if (codec == "ULAW"){dataheader[0] |= 0x80;}
-      if (codec == "Speex"){dataheader[0] |= 0xB0;}
+      if (codec == DTSC::CODEC_ALAW){dataheader[0] |= 0x70;}
+      if (codec == DTSC::CODEC_ULAW){dataheader[0] |= 0x80;}
+      if (codec == DTSC::CODEC_SPEEX){dataheader[0] |= 0xB0;}
 
       if (rate >= 44100){
         dataheader[0] |= 0x0C;
@@ -1808,18 +1808,24 @@ namespace Mist{
           if (idx != INVALID_TRACK_ID && !userSelect.count(idx)){
             userSelect[idx].reload(streamName, idx, COMM_STATUS_ACTIVE | COMM_STATUS_SOURCE);
           }
-          if (M.getCodec(idx) == "PCM" && M.getSize(idx) == 16){
-            char *ptr = F.getData();
-            uint32_t ptrSize = F.getDataLen();
-            for (uint32_t i = 0; i < ptrSize; i += 2){
-              char tmpchar = ptr[i];
-              ptr[i] = ptr[i + 1];
-              ptr[i + 1] = tmpchar;
+          ltt = tagTime;
+          // Reserve the payload on the live page and write the tag data straight into it.
+          // 16-bit PCM is big-endian in FLV, so it gets byte-swapped on the way.
+          const char *src = F.getData();
+          uint32_t srcLen = F.getDataLen();
+          char *dest = bufferLiveReserve(tagTime, F.offset(), idx, srcLen, 0, F.isKeyframe, meta);
+          if (dest){
+            if (M.getCodecId(idx) == DTSC::CODEC_PCM && M.getSize(idx) == 16){
+              for (uint32_t i = 0; i + 1 < srcLen; i += 2){
+                dest[i] = src[i + 1];
+                dest[i + 1] = src[i];
+              }
+              if (srcLen & 1){dest[srcLen - 1] = src[srcLen - 1];}
+            }else{
+              memcpy(dest, src, srcLen);
             }
+            bufferCommit(srcLen);
           }
-          ltt = tagTime;
-          //            bufferLivePacket(thisPacket);
-          bufferLivePacket(tagTime, F.offset(), idx, F.getData(), F.getDataLen(), 0, F.isKeyframe);
           if (!meta){config->is_active = false;}
         }
         break;
@@ -73,6 +73,12 @@ namespace Mist{
     if (mainConn){mainConn->addUp(len);}
   }
 
+  /// Same as sendUDP, but only queues the packet; the queue is sent at once by sendQueued.
+  void queueUDP(void *socket, const char *data, size_t len, uint8_t){
+    ((Socket::UDPConnection *)socket)->queueSend(data, len);
+    if (mainConn){mainConn->addUp(len);}
+  }
+
   /// Function used to send RTP packets over TCP
   ///\param socket A TCP Connection pointer, sent as a void*, to keep portability.
   ///\param data The RTP Packet that needs to be sent
@@ -132,14 +138,14 @@ namespace Mist{
   }
 
   void OutRTSP::sendNext(){
-    std::string trackType = M.getType(thisIdx);
-    if (trackType == "audio" && !(targetParams["audio"] == "1" || targetParams["audio"] == "true")){
+    DTSC::trackType trackType = M.getTypeId(thisIdx);
+    if (trackType == DTSC::TYPE_AUDIO && !(targetParams["audio"] == "1" || targetParams["audio"] == "true")){
       return;
     }
-    if (trackType == "video"){
+    if (trackType == DTSC::TYPE_VIDEO){
       prevVGetTime = Util::bootMS();
     }
-    if (trackType == "audio"){
+    if (trackType == DTSC::TYPE_AUDIO){
       prevAGetTime = Util::bootMS();
     }
     uint64_t trackDiffAV = (prevVGetTime > prevAGetTime)
@@ -169,14 +175,14 @@ namespace Mist{
       return;
     }
     uint64_t msTime = thisPacket.getTime();
-    if (0 == videoFirstRtpMs && trackType == "video"){
+    if (0 == videoFirstRtpMs && trackType == DTSC::TYPE_VIDEO){
       setSyncMs("video");
     }
-    if (0 == audioFirstRtpMs && trackType == "audio"){
+    if (0 == audioFirstRtpMs && trackType == DTSC::TYPE_AUDIO){
       setSyncMs("audio");
     }
     uint64_t rtpTimestamp;
-    if (trackType == "video"){
+    if (trackType == DTSC::TYPE_VIDEO){
       if (msTime < videoMilliSyncMs){
         // impossible scenario - exit
         FAIL_MSG("Invalid output RTP msTime (%u) on track (%s) with offset (%u) in output RTSP", M.getCodec(thisIdx).c_str(), msTime, videoMilliSyncMs);
@@ -185,7 +191,7 @@ namespace Mist{
       }
       rtpTimestamp = (uint64_t)((msTime - videoMilliSyncMs) * multiplier + videoFirstRtpMs);
     }
-    if (trackType == "audio"){
+    if (trackType == DTSC::TYPE_AUDIO){
       if (msTime < audioMilliSyncMs){
         // impossible scenario - exit
         FAIL_MSG("Invalid output RTP msTime (%u) on track (%s) with offset (%u) in output RTSP", M.getCodec(thisIdx).c_str(), msTime, audioMilliSyncMs);
@@ -206,7 +212,7 @@ namespace Mist{
 
     if (sdpState.tracks[thisIdx].channel == -1){// UDP connection
       socket = &sdpState.tracks[thisIdx].data;
-      callBack = sendUDP;
+      callBack = queueUDP;
     }else{
       socket = &myConn;
       callBack = sendTCP;
@@ -214,7 +220,8 @@ namespace Mist{
 
     sdpState.tracks[thisIdx].pack.setTimestamp(rtpTimestamp);
     sdpState.tracks[thisIdx].pack.sendData(socket, callBack, dataPointer, dataLen,
-                                           sdpState.tracks[thisIdx].channel, meta.getCodec(thisIdx));
+                                           sdpState.tracks[thisIdx].channel, meta.getCodecId(thisIdx));
+    if (callBack == queueUDP){sdpState.tracks[thisIdx].data.sendQueued();}
   }
 
   /// This request handler also checks for UDP packets
@@ -23,6 +23,12 @@ namespace Mist{
     if (mainConn){mainConn->addUp(len);}
   }
 
+  /// Same as sendUDP, but only queues the packet; the queue is sent at once by sendQueued.
+  void queueUDP(void *socket, const char *data, size_t len, uint8_t){
+    ((Socket::UDPConnection *)socket)->queueSend(data, len);
+    if (mainConn){mainConn->addUp(len);}
+  }
+
   /// \brief Initializes the SDP state
   /// \param  port: Each track will have a data and RTCP port.
   ///                    These are consecutive and start at startPort
@@ -165,7 +171,7 @@ namespace Mist{
     // Get data socket and send RTCP
     if (sdpState.tracks[thisIdx].channel == -1){
       socket = &sdpState.tracks[thisIdx].data;
-      callBack = sendUDP;
+      callBack = queueUDP;
       if (Util::bootSecs() != sdpState.tracks[thisIdx].rtcpSent){
         sdpState.tracks[thisIdx].pack.setTimestamp(timestamp * SDP::getMultiplier(&M, thisIdx));
         sdpState.tracks[thisIdx].rtcpSent = Util::bootSecs();
@@ -178,8 +184,9 @@ namespace Mist{
     uint64_t offset = thisPacket.getInt("offset");
     sdpState.tracks[thisIdx].pack.setTimestamp((timestamp + offset) * SDP::getMultiplier(&M, thisIdx));
     sdpState.tracks[thisIdx].pack.sendData(socket, callBack, dataPointer, dataLen,
-                                           sdpState.tracks[thisIdx].channel, meta.getCodec(thisIdx));
-    
+                                           sdpState.tracks[thisIdx].channel, meta.getCodecId(thisIdx));
+    sdpState.tracks[thisIdx].data.sendQueued();
+
     // Update last RTCP received variable
     if (exitOnNoRTCP){
       checkForRTCP(thisIdx);
@@ -219,11 +219,12 @@ namespace Mist{
           if (sendFEC){
             // Send FEC packet if available
             uint64_t bytesSent = 0;
-            tsOut.parseFEC(&fecColumnSock, &fecRowSock, bytesSent, packetBuffer.c_str(), packetBuffer.size());
+            // The media packets are only queued; let parseFEC send them before any FEC packet
+            tsOut.parseFEC(&fecColumnSock, &fecRowSock, bytesSent, packetBuffer.c_str(), packetBuffer.size(), &pushSock);
             myConn.addUp(bytesSent);
           }
         }else{
-          pushSock.SendNow(packetBuffer);
+          pushSock.queueSend(packetBuffer.data(), packetBuffer.size());
           myConn.addUp(packetBuffer.size());
         }
         packetBuffer.clear();
@@ -233,11 +234,24 @@ namespace Mist{
       packetBuffer.append(tsData, len);
       curFilled++;
     }else{
-      myConn.SendNow(tsData, len);
-      if (!myConn){
-        Util::logExitReason(ER_CLEAN_REMOTE_CLOSE, "connection closed by peer");
-        config->is_active = false;
-      }
+      tsBatch.append(tsData, len);
+      if (tsBatch.size() >= TS_SEND_BATCH){flushTS();}
+    }
+  }
+
+  /// Writes all TS packets collected by sendTS to the TCP connection at once.
+  /// When pushing over UDP, sends all datagrams queued on the push socket instead.
+  void OutTS::flushTS(){
+    if (pushOut){
+      pushSock.sendQueued();
+      return;
+    }
+    if (!tsBatch.size()){return;}
+    myConn.SendNow(tsBatch, tsBatch.size());
+    tsBatch.truncate(0);
+    if (!myConn){
+      Util::logExitReason(ER_CLEAN_REMOTE_CLOSE, "connection closed by peer");
+      config->is_active = false;
     }
   }
 
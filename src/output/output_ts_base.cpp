@@ -8,6 +8,46 @@ namespace Mist{
     setBlocking(true);
     sendRepeatingHeaders = 0;
     lastHeaderTime = 0;
+    psiBoot = 0;
+    psiTables[0] = 0; // No valid sync byte: tables not built yet
+    tsBatch.allocate(TS_SEND_BATCH);
+  }
+
+  /// Sends the PAT, PMT and SDT packets.
+  /// The tables are only rebuilt when the track selection, stream name or stream boot changes;
+  /// otherwise the stored copies are reused with just their continuity counters updated.
+  void TSOutput::sendPSI(){
+    bool rebuild = (psiTables[0] != 0x47 || psiBoot != M.getBootMsOffset() ||
+                    psiTracks.size() != userSelect.size() || psiStream != streamName);
+    if (!rebuild){
+      std::set<size_t>::iterator pIt = psiTracks.begin();
+      for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); ++it, ++pIt){
+        if (*pIt != it->first){
+          rebuild = true;
+          break;
+        }
+      }
+    }
+    if (rebuild){
+      psiTracks.clear();
+      for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); it++){
+        psiTracks.insert(it->first);
+      }
+      psiBoot = M.getBootMsOffset();
+      psiStream = streamName;
+      memcpy(psiTables, TS::PAT, 188);
+      memcpy(psiTables + 188, TS::createPMT(psiTracks, M), 188);
+      memcpy(psiTables + 376, TS::createSDT(streamName), 188);
+      HIGH_MSG("Rebuilt PAT/PMT/SDT for %zu track(s)", psiTracks.size());
+    }
+    // The continuity counter is in the TS header, outside of the CRC-protected section
+    char *psi = psiTables;
+    psi[3] = (psi[3] & 0xF0) | (++contPAT & 0x0F);
+    psi[188 + 3] = (psi[188 + 3] & 0xF0) | (++contPMT & 0x0F);
+    psi[376 + 3] = (psi[376 + 3] & 0xF0) | (++contSDT & 0x0F);
+    sendTS(psi);
+    sendTS(psi + 188);
+    sendTS(psi + 376);
   }
 
   void TSOutput::fillPacket(char const *data, size_t dataLen, bool &firstPack, bool video,
@@ -15,19 +55,8 @@ namespace Mist{
     do{
       if (!packData.getBytesFree()){
         if ((sendRepeatingHeaders && thisPacket.getTime() - lastHeaderTime > sendRepeatingHeaders) || !packCounter){
-
-          std::set<size_t> selectedTracks;
-          for (std::map<size_t, Comms::Users>::iterator it = userSelect.begin(); it != userSelect.end(); it++){
-            selectedTracks.insert(it->first);
-          }
-
           lastHeaderTime = thisPacket.getTime();
-          TS::Packet tmpPack;
-          tmpPack.FromPointer(TS::PAT);
-          tmpPack.setContinuityCounter(++contPAT);
-          sendTS(tmpPack.checkAndGetBuffer());
-          sendTS(TS::createPMT(selectedTracks, M, ++contPMT));
-          sendTS(TS::createSDT(streamName, ++contSDT));
+          sendPSI();
           packCounter += 3;
         }
         sendTS(packData.checkAndGetBuffer());
@@ -71,9 +100,9 @@ namespace Mist{
       }
     }
     // Get ready some data to speed up accesses
-    std::string type = M.getType(thisIdx);
-    std::string codec = M.getCodec(thisIdx);
-    bool video = (type == "video");
+    DTSC::trackType type = M.getTypeId(thisIdx);
+    DTSC::codecType codec = M.getCodecId(thisIdx);
+    bool video = (type == DTSC::TYPE_VIDEO);
     size_t pkgPid = TS::getUniqTrackID(M, thisIdx);
     bool &firstPack = first[thisIdx];
     uint16_t &contPkg = contCounters[pkgPid];
@@ -84,8 +113,9 @@ namespace Mist{
     size_t dataLen = 0;
     thisPacket.getString("data", dataPointer, dataLen); // data
 
-    if (codec == "rawts"){
+    if (codec == DTSC::CODEC_RAWTS){
       for (size_t i = 0; i+188 <= dataLen; i+=188){sendTS(dataPointer+i, 188);}
+      flushTS();
       return;
     }
 
@@ -95,10 +125,10 @@ namespace Mist{
     if (video){
       bool addInit = keyframe;
       bool addEndNal = true;
-      if (codec == "H264" || codec == "HEVC"){
+      if (codec == DTSC::CODEC_H264 || codec == DTSC::CODEC_HEVC){
         uint32_t extraSize = 0;
         //Check if we need to skip sending some things
-        if (codec == "H264"){
+        if (codec == DTSC::CODEC_H264){
           size_t ctr = 0;
           char * ptr = dataPointer;
           while (ptr+4 < dataPointer+dataLen && ++ctr <= 5){
@@ -116,15 +146,15 @@ namespace Mist{
           }
         }
 
-        if (addEndNal && codec == "H264"){extraSize += 6;}
+        if (addEndNal && codec == DTSC::CODEC_H264){extraSize += 6;}
         if (addInit){
-          if (codec == "H264"){
+          if (codec == DTSC::CODEC_H264){
             MP4::AVCC avccbox;
             avccbox.setPayload(M.getInit(thisIdx));
             bs = avccbox.asAnnexB();
             extraSize += bs.size();
           }
-          if (codec == "HEVC"){
+          if (codec == DTSC::CODEC_HEVC){
             MP4::HVCC hvccbox;
             hvccbox.setPayload(M.getInit(thisIdx));
             bs = hvccbox.asAnnexB();
@@ -144,19 +174,19 @@ namespace Mist{
         fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
 
         // End of previous nal unit, if not already present
-        if (addEndNal && codec == "H264"){
+        if (addEndNal && codec == DTSC::CODEC_H264){
           fillPacket("\000\000\000\001\011\360", 6, firstPack, video, keyframe, pkgPid, contPkg);
         }
         // Init data, if keyframe and not already present
         if (addInit){
-          if (codec == "H264"){
+          if (codec == DTSC::CODEC_H264){
             MP4::AVCC avccbox;
             avccbox.setPayload(M.getInit(thisIdx));
             bs = avccbox.asAnnexB();
             fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
           }
           /*LTS-START*/
-          if (codec == "HEVC"){
+          if (codec == DTSC::CODEC_HEVC){
             MP4::HVCC hvccbox;
             hvccbox.setPayload(M.getInit(thisIdx));
             bs = hvccbox.asAnnexB();
@@ -165,7 +195,7 @@ namespace Mist{
           /*LTS-END*/
         }
         size_t lenSize = 4;
-        if (codec == "H264"){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
+        if (codec == DTSC::CODEC_H264){lenSize = (M.getInit(thisIdx)[4] & 3) + 1;}
         while (i + lenSize < (unsigned int)dataLen){
           if (lenSize == 4){
             ThisNaluSize = Bit::btohl(dataPointer + i);
@@ -191,9 +221,9 @@ namespace Mist{
 
         fillPacket(dataPointer, dataLen, firstPack, video, keyframe, pkgPid, contPkg);
       }
-    }else if (type == "audio"){
+    }else if (type == DTSC::TYPE_AUDIO){
       size_t tempLen = dataLen;
-      if (codec == "AAC"){
+      if (codec == DTSC::CODEC_AAC){
         tempLen += 7;
         // Make sure TS timestamp is sample-aligned, if possible
         uint32_t freq = M.getRate(thisIdx);
@@ -206,7 +236,7 @@ namespace Mist{
           packTime = aacSamples * 90000 / freq;
         }
       }
-      if (codec == "opus"){
+      if (codec == DTSC::CODEC_OPUS){
         tempLen += 3 + (dataLen/255);
         bs = TS::Packet::getPESPS1LeadIn(tempLen, packTime, M.getBps(thisIdx));
         fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
@@ -218,13 +248,13 @@ namespace Mist{
         bs.clear();
         TS::Packet::getPESAudioLeadIn(bs, tempLen, packTime, M.getBps(thisIdx));
         fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
-        if (codec == "AAC"){
+        if (codec == DTSC::CODEC_AAC){
           bs = TS::getAudioHeader(dataLen, M.getInit(thisIdx));
           fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
         }
       }
       fillPacket(dataPointer, dataLen, firstPack, video, keyframe, pkgPid, contPkg);
-    }else if (type == "meta"){
+    }else if (type == DTSC::TYPE_META){
       long unsigned int tempLen = dataLen;
       bs = TS::Packet::getPESMetaLeadIn(tempLen, packTime, M.getBps(thisIdx));
       fillPacket(bs.data(), bs.size(), firstPack, video, keyframe, pkgPid, contPkg);
@@ -234,5 +264,7 @@ namespace Mist{
       packData.addStuffing();
       fillPacket(0, 0, firstPack, video, keyframe, pkgPid, contPkg);
     }
+    // Write out the whole PES run at once
+    flushTS();
   }
 }// namespace Mist
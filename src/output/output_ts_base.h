@@ -8,6 +8,9 @@
 #define TS_BASECLASS Output
 #endif
 
+/// Amount of TS data collected before it is written out, if not flushed earlier
+#define TS_SEND_BATCH 188 * 700
+
 namespace Mist{
 
   class TSOutput : public TS_BASECLASS{
@@ -16,6 +19,8 @@ namespace Mist{
     virtual ~TSOutput(){};
     virtual void sendNext();
     virtual void sendTS(const char *tsData, size_t len = 188){};
+    virtual void flushTS(){};
+    void sendPSI();
     void fillPacket(char const *data, size_t dataLen, bool &firstPack, bool video, bool keyframe,
                     size_t pkgPid, uint16_t &contPkg);
     virtual void sendHeader(){
@@ -35,5 +40,10 @@ namespace Mist{
     uint64_t sendRepeatingHeaders; ///< Amount of ms between PAT/PMT. Zero means do not repeat.
     uint64_t lastHeaderTime;       ///< Timestamp last PAT/PMT were sent.
     uint64_t ts_from;              ///< Starting time to subtract from timestamps
+    Util::ResizeablePointer tsBatch; ///< TS packets collected by sendTS, written out by flushTS
+    char psiTables[188 * 3];      ///< PAT, PMT and SDT packets, as last built by sendPSI
+    std::set<size_t> psiTracks;   ///< Track selection psiTables was built for
+    std::string psiStream;        ///< Stream name psiTables was built for
+    int64_t psiBoot;              ///< Stream boot offset psiTables was built for
   };
 }// namespace Mist
@@ -1248,12 +1248,12 @@ namespace Mist{
 
       //Send NACKs for packets that we still need
       while (rtcTrack.sorter.wantedSeqs.size()){
-        uint16_t sNum = *(rtcTrack.sorter.wantedSeqs.begin());
+        uint16_t sNum = rtcTrack.sorter.wantedSeqs.front();
         if (packetLog.is_open()){packetLog << "[" << Util::bootMS() << "]" << "Sending NACK for sequence #" << sNum << std::endl;}
         stats_nacknum++;
         totalRetrans++;
         sendRTCPFeedbackNACK(rtcTrack, sNum);
-        rtcTrack.sorter.wantedSeqs.erase(sNum);
+        rtcTrack.sorter.wantedSeqs.pop_front();
       }
 
     }else{
@@ -1642,7 +1642,7 @@ namespace Mist{
     }
 
     rtcTrack.rtpPacketizer.sendData(&udp, onRTPPacketizerHasDataCallback, dataPointer, dataLen,
-                                    rtcTrack.payloadType, M.getCodec(thisIdx));
+                                    rtcTrack.payloadType, M.getCodecId(thisIdx));
 
     //Trigger a re-send of the Sender Report for every track every ~250ms
     if (lastSR+250 < Util::bootMS()){
@@ -1947,7 +1947,7 @@ namespace Mist{
       std::copy(avcc.getSPS(i), avcc.getSPS(i) + avcc.getSPSLen(i), std::back_inserter(buf));
 
       rtcTrack.rtpPacketizer.sendData(&udp, onRTPPacketizerHasDataCallback, &buf[0], buf.size(),
-                                      rtcTrack.payloadType, M.getCodec(dtscIdx));
+                                      rtcTrack.payloadType, M.getCodecId(dtscIdx));
     }
 
     /* PPS */
@@ -1965,7 +1965,7 @@ namespace Mist{
       std::copy(avcc.getPPS(i), avcc.getPPS(i) + avcc.getPPSLen(i), std::back_inserter(buf));
 
       rtcTrack.rtpPacketizer.sendData(&udp, onRTPPacketizerHasDataCallback, &buf[0], buf.size(),
-                                      rtcTrack.payloadType, M.getCodec(dtscIdx));
+                                      rtcTrack.payloadType, M.getCodecId(dtscIdx));
     }
   }
 
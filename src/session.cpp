@@ -8,6 +8,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <mist/shared_memory.h>
+#include <mist/traffic.h>
 #include "controller/controller_statistics.h"
 #include "controller/controller_storage.h"
 #include "../lib/sql.h"
@@ -26,14 +27,8 @@ uint64_t globalUp = 0;
 uint64_t globalPktcount = 0;
 uint64_t globalPktloss = 0;
 uint64_t globalPktretrans = 0;
-// Define variables to track HLS data consumption
-float totalDataConsumed = 0.0;
-float prevDataConsumed = 0.0;
-std::string previousData = "0.0";
-std::string pageName;
-std::string organization = "staqu";
-// User list for bandwidth statistics 
-std::set<std::string> usersList;
+// Bytes transferred by HLS/WS connections since the last push to the traffic counters
+uint64_t trafficBytes = 0;
 // Stores last values of each connection
 std::map<size_t, uint64_t> connTime;
 std::map<size_t, uint64_t> connDown;
@@ -58,11 +53,6 @@ void handleSignal(int signum){
 
 const char nullAddress[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-float bytesToMB(uint64_t bytes) {
-    const float bytesInMB = 1024.0f * 1024.0f;
-    return static_cast<float>(bytes) / bytesInMB;
-}
-
 /** @deprecated use for only two users exist @param staqu, client */
 std::string getUserId1(std::string reqUrl){
   size_t startIndex = reqUrl.find("monitor=");
@@ -78,63 +68,6 @@ std::string getUserId1(std::string reqUrl){
     return userId;
 }
 
-std::set<std::string> getUserPageFields(std::string pageName, std::string userName){
-  IPC::sharedPage sharedPage;
-  IPC::semaphore writeLock;
-  std::set<std::string> prevList;
-  writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-  if (!writeLock){
-    FAIL_MSG("[Statistics], Could not open semaphore to add track!");
-  }
-  sharedPage.init(pageName, USER_INITSIZE, false, false);
-  if (!sharedPage || !sharedPage.mapped){
-    sharedPage.init(pageName, USER_INITSIZE, true, false);
-  }
-  if (!sharedPage.mapped){
-    FAIL_MSG("Could not open memory page for traffic stats");
-    return prevList;
-  }
-  if (sharedPage.mapped){
-    Util::RelAccX A(sharedPage.mapped, false);
-    prevList = A.getAllFields();
-    if(A.getPointer(userName)){return prevList;}
-    else{
-      prevList.insert(userName);
-      if(writeLock){
-        writeLock.wait();
-        A.setReload();
-        sharedPage.master = true;
-        sharedPage.close();
-        sharedPage.init(pageName, USER_INITSIZE, true, false);
-        writeLock.post();
-      }
-      Util::RelAccX userAccX(sharedPage.mapped, false);
-      if (!userAccX.isReady()){
-        for(auto it:prevList){
-          userAccX.addField(it, RAX_STRING);
-        }
-        userAccX.setRCount(1);
-        userAccX.setEndPos(1);
-        userAccX.setReady();
-      }
-    sharedPage.master = false;
-    }
-  }
-  return prevList;
-}
-
-std::set<std::string> getStreamPageFields(){
-  IPC::sharedPage streamSharedPage;
-  IPC::semaphore writeLock;
-  std::set<std::string> streamsList;
-  streamSharedPage.init(STREAM_LIST, USER_INITSIZE, false, false);
-  if (streamSharedPage.mapped){
-    Util::RelAccX A(streamSharedPage.mapped, false);
-    streamsList = A.getAllFields();
-  }
-  return streamsList;
-}
-
 std::string getUserId2(std::string reqUrl){
   size_t startIndex = reqUrl.find("user_id=");
   std::string userId = "nullUser";
@@ -149,184 +82,42 @@ std::string getUserId2(std::string reqUrl){
     return userId;
 }
 
-void addUserInStreamCol(std::string userName, std::string streamName, std::set<std::string> &usersList){
-  IPC::sharedPage trafficSharedPage;
-  IPC::semaphore writeLock;
-  std::set<std::string> streams = getStreamPageFields();
-  writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-  if (!writeLock){
-    FAIL_MSG("[Statistics], Could not open semaphore to add track!");
-  }
-  trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, false, false);
-  if (!trafficSharedPage || !trafficSharedPage.mapped){
-    trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-  }
-  if (!trafficSharedPage.mapped){
-    FAIL_MSG("Could not open memory page for traffic stats");
+/// Adds bytes to the traffic counters of the given user, stream and protocol in shared memory
+void bandwidthToSHM(const std::string &userName, uint64_t bytes, const std::string &streamName, Traffic::Protocol proto){
+  Traffic::Counters counters;
+  if (!counters){
+    FAIL_MSG("[bandwidthToSHM] Could not open traffic counters page to add traffic!");
     return;
   }
-  if (trafficSharedPage.mapped){
-    Util::RelAccX tempTrafficAccX(trafficSharedPage.mapped, false);
-    /* Gather the SHM data in-memory RAM {Local vars} */
-    std::map<std::string, std::vector<std::pair<std::string, std::vector<std::string>>>> temporaryData;
-    for(auto jit : streams) {
-      if (tempTrafficAccX.getFieldAccX(jit) && tempTrafficAccX.getPointer(jit)){
-        Util::RelAccX trafficStreamRow = Util::RelAccX(tempTrafficAccX.getPointer(jit), false);
-        for(auto& user : usersList){
-          std::vector<std::string> consumedData;
-          if(trafficStreamRow.getFieldAccX(user) && trafficStreamRow.getPointer(user.c_str())){
-            JSON::Value userStreamRow = JSON::fromString(trafficStreamRow.getPointer(user.c_str()));
-            std::string hls = userStreamRow["hls"];
-            std::string ws = userStreamRow["ws"];
-            std::string ndvr = userStreamRow["ndvr"];
-            consumedData.push_back(hls);
-            consumedData.push_back(ws);
-            consumedData.push_back(ndvr);
-            temporaryData[jit].push_back({user, consumedData});
-          }
-          else if(streamName == jit and user == userName){
-            std::string hls = "0.0";
-            std::string ws = "0.0";
-            std::string ndvr = "0.0";
-            consumedData.push_back(hls);
-            consumedData.push_back(ws);
-            consumedData.push_back(ndvr);
-            temporaryData[jit].push_back({user, consumedData});
-          }
-        }
-      }
-    }
-    if(writeLock){
-      writeLock.wait();
-      tempTrafficAccX.setReload();
-      trafficSharedPage.master = true;
-      trafficSharedPage.close();
-      trafficSharedPage.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, true, false);
-      writeLock.post();
-    }
-    Util::RelAccX trafficAccX(trafficSharedPage.mapped, false);
-    if(!trafficAccX.isReady()){
-      for(auto jit : streams){
-        trafficAccX.addField(jit, RAX_NESTED, DEFAULT_ROW_CAPACITY);
-      }
-      trafficAccX.setRCount(1);
-      trafficAccX.setEndPos(1);
-      trafficAccX.setReady();
-    }
-    for(auto jit : streams){
-      std::vector<std::pair<std::string, std::vector<std::string>>> usersData = temporaryData[jit];
-      Util::RelAccX streamAccX = Util::RelAccX(trafficAccX.getPointer(jit), false);
-      for (auto userRow:usersData){
-        streamAccX.addField(userRow.first, RAX_STRING, 512);
-      }
-      streamAccX.setRCount(1);
-      streamAccX.setEndPos(1);
-      streamAccX.setReady();
-      for (auto userRow:usersData){
-        JSON::Value userData;
-        userData["hls"] = userRow.second[0];
-        userData["ws"] = userRow.second[1];
-        userData["ndvr"] = userRow.second[2];
-        streamAccX.setString((userRow.first), userData.toString());
-      }
-    }
-  trafficSharedPage.master = false;
-  }
-
-  /** @todo  this user in database as well */
-}
-
-void bandwidthToSHM(std::string userName, float totalDataConsumed, std::string streamName, std::string consumptionType, int counter){
-  if (counter > RECURSION_TRY){return;}
-  IPC::sharedPage trafficPageWriteMode;
-  IPC::semaphore writeLock;
-  bool newEntry = false;
-  writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-  if (!writeLock){
-    FAIL_MSG("[bandwidthToSHM], Could not open writelock to add traffic in SHM!");
+  if (!counters.add(streamName, userName, proto, bytes)){
+    FAIL_MSG("[TRAFFIC] No free traffic counter slot for stream %s, user %s", streamName.c_str(), userName.c_str());
   }
-  trafficPageWriteMode.init(TRAFFIC_STATISTICS, TRAFFIC_STATISTICS_INITSIZE, false, false);
-  if (trafficPageWriteMode.mapped){
-    Util::RelAccX trafficAccXWrite(trafficPageWriteMode.mapped, false);
-      Util::RelAccX trafficStreamRow = Util::RelAccX(trafficAccXWrite.getPointer(streamName), false);
-      if(trafficAccXWrite.getFieldAccX(streamName) && trafficAccXWrite.getPointer(streamName)) {
-        if(trafficStreamRow.getFieldAccX(userName) && trafficStreamRow.getPointer(userName)){
-          JSON::Value trafficUserRow = JSON::fromString(trafficStreamRow.getPointer(userName));
-          trafficUserRow[consumptionType] = std::to_string(std::stof(trafficUserRow[consumptionType]) + totalDataConsumed);
-          std::string data = trafficUserRow.toString();
-          if(writeLock){
-            writeLock.wait();
-            trafficStreamRow.setString(userName, trafficUserRow.toString());
-            writeLock.post();
-          }
-        }
-        else {
-          usersList = getUserPageFields(USER_LIST, userName);
-          addUserInStreamCol(userName, streamName, usersList);
-          bandwidthToSHM(userName, totalDataConsumed, streamName, consumptionType, counter);
-        }
-      }
-      else {
-        FAIL_MSG("[TRAFFIC] Stream is not exist in traffic-SHM : ", streamName.c_str());
-      }
-  }
-  counter++;
 }
 
 void pushToSHM2(const std::string &thisStreamName, const std::string &thisProtocol, const std::string &thisReqUrl) {
-  // Keep the bandwidth in shared memory {Shared page - "MstTrafficStats"} with respect to protocol
-  Controller::trafficProtocol trafficProtocol;
+  // Keep the bandwidth in shared memory {Shared page - "MstTrafficCnt"} with respect to protocol
   if (thisProtocol == HLS_PROTOCOL_IDENTIFIER || thisProtocol == WS_PROTOCOL_IDENTIFIER) {
     std::string userId = getUserId2(thisReqUrl);
     if (thisProtocol == HLS_PROTOCOL_IDENTIFIER){
-      bandwidthToSHM(userId, totalDataConsumed, Util::refactorStream(thisStreamName), "hls", 1);
+      bandwidthToSHM(userId, trafficBytes, Util::refactorStream(thisStreamName), Traffic::HLS);
     }
     if (thisProtocol == WS_PROTOCOL_IDENTIFIER){
-      bandwidthToSHM(userId, totalDataConsumed, Util::refactorStream(thisStreamName), "ws", 1);
+      bandwidthToSHM(userId, trafficBytes, Util::refactorStream(thisStreamName), Traffic::WS);
     }
   }
 }
 
 /** @deprecated use for only two users exist @param staqu, client */
 void pushToSHM1(const std::string &thisStreamName, const std::string &thisProtocol, const std::string &thisReqUrl) {
-  // Keep the bandwidth in shared memory {Shared page - "MstTrafficStats"} with respect to protocol
-  Controller::trafficProtocol trafficProtocol;
+  // Keep the bandwidth in shared memory {Shared page - "MstTrafficCnt"} with respect to protocol,
+  // counting the organization as the user
   if (thisProtocol == HLS_PROTOCOL_IDENTIFIER || thisProtocol == WS_PROTOCOL_IDENTIFIER) {
-    std::string userId = getUserId1(thisReqUrl);
-    if (userId == "false") pageName = TRAFFIC_ORG_STAQU;
-    else pageName = TRAFFIC_ORG_CLIENT;
-    IPC::sharedPage trafficPageWriteMode;
-    IPC::semaphore writeLock;
-    writeLock.open(SEMAPHORE_LOCK_WRITE_MODE, O_CREAT | O_RDWR, ACCESSPERMS, 1);
-    if (!writeLock){
-      FAIL_MSG("[RTMPServer] Could not open semaphore to add consumed traffic!");
+    std::string organization = (getUserId1(thisReqUrl) == "false") ? "staqu" : "client";
+    if (thisProtocol == HLS_PROTOCOL_IDENTIFIER){
+      bandwidthToSHM(organization, trafficBytes, thisStreamName, Traffic::HLS);
     }
-    trafficPageWriteMode.init(pageName, TRAFFIC_STATISTICS_INITSIZE, false, false);
-    if (trafficPageWriteMode.mapped){
-      Util::RelAccX trafficAccXWrite(trafficPageWriteMode.mapped, false);
-      Util::RelAccX traficGroupWrite = Util::RelAccX(trafficAccXWrite.getPointer(thisStreamName), false);
-      if (thisProtocol == HLS_PROTOCOL_IDENTIFIER){
-        if(traficGroupWrite.getFieldAccX(trafficProtocol.hls) && traficGroupWrite.getPointer(trafficProtocol.hls)){
-          previousData = std::string(traficGroupWrite.getPointer(trafficProtocol.hls));
-        }
-        if(writeLock){
-          writeLock.wait();
-          traficGroupWrite.setString("hls", std::to_string(totalDataConsumed + std::stof(previousData)));
-          traficGroupWrite.setInt(IS_UPDATED, 1);
-          writeLock.post();
-        }
-      }
-      if (thisProtocol == WS_PROTOCOL_IDENTIFIER){
-        if(traficGroupWrite.getFieldAccX(trafficProtocol.ws) && traficGroupWrite.getPointer(trafficProtocol.ws)){
-          previousData = std::string(traficGroupWrite.getPointer(trafficProtocol.ws));
-        }
-        if(writeLock){
-          writeLock.wait();
-          traficGroupWrite.setString("ws", std::to_string(totalDataConsumed + std::stof(previousData)));
-          traficGroupWrite.setInt(IS_UPDATED, 1);
-          writeLock.post();
-        }
-      }
+    if (thisProtocol == WS_PROTOCOL_IDENTIFIER){
+      bandwidthToSHM(organization, trafficBytes, thisStreamName, Traffic::WS);
     }
   }
 }
@@ -374,6 +165,8 @@ void userOnActive(Comms::Connections &connections, size_t idx, const std::string
     WARN_MSG("Connection packets retransmitted should be a counter, but has decreased in value");
     connPktretrans[idx] = connections.getPacketRetransmitCount(idx);
   }
+  // Bytes transferred by this connection since the last check
+  uint64_t connDelta = (connections.getDown(idx) - connDown[idx]) + (connections.getUp(idx) - connUp[idx]);
   // Add increase in stats to global stats
   globalDown += connections.getDown(idx) - connDown[idx];
   globalUp += connections.getUp(idx) - connUp[idx];
@@ -395,16 +188,12 @@ void userOnActive(Comms::Connections &connections, size_t idx, const std::string
   catch (const std::exception &ex) {trafficConsumption = false;}
   if (trafficConsumption) {
     if (thisProtocol == HLS_PROTOCOL_IDENTIFIER || thisProtocol == WS_PROTOCOL_IDENTIFIER) {
-      uint64_t dataConsumed = connections.getDown(idx) + connections.getUp(idx);
-      float dataConsumedKB = bytesToMB(dataConsumed);
-      if (thisProtocol == WS_PROTOCOL_IDENTIFIER) {totalDataConsumed += (dataConsumedKB - prevDataConsumed);}
-      if (thisProtocol == HLS_PROTOCOL_IDENTIFIER) {totalDataConsumed += dataConsumedKB;}
-      prevDataConsumed = dataConsumedKB;
+      trafficBytes += connDelta;
       // If time reached from given time band then 
       if (Util::epoch() - perSessionBootTime >= SESSION_TO_SHM_TIMEOUT) {
         pushToSHM2(thisStreamName, thisProtocol, thisReqUrl);
         // std::async(std::launch::async, pushToSHM2, thisStreamName, thisProtocol, thisReqUrl);
-        totalDataConsumed = 0.0;
+        trafficBytes = 0;
         perSessionBootTime = Util::epoch();
       }
     }
@@ -738,7 +527,7 @@ int main(int argc, char **argv){
     }
   }
 
-  // Keep the bandwidth in shared memory {Shared page - "MstTrafficStats"} with respect to protocol
+  // Keep the bandwidth in shared memory {Shared page - "MstTrafficCnt"} with respect to protocol
   bool trafficConsumption = false;
   try {trafficConsumption = (std::string(getenv("TRAFFIC_CONSUMPTION")) == "ON") ? true : false;}
   catch (const std::exception &ex) {trafficConsumption = false;}
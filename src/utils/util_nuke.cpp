@@ -5,6 +5,7 @@
 #include <mist/procs.h>
 #include <mist/comms.h>
 #include <mist/config.h>
+#include <mist/hls_support.h>
 
 const char * getStateString(uint8_t state){
   switch (state){
@@ -164,4 +165,7 @@ int main(int argc, char **argv){
   nukeSem(SEM_INPUT);
   nukeSem("/MstPull_%s");
   nukeSem(SEM_TRACKLIST);
+  HLS::SegmentCache::wipe(Util::streamName);
+  nukeSem(SEM_HLS_SEGMENT);
+  nukePage(SHM_HLS_MANIFEST);
 }